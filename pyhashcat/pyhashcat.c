@@ -7,6 +7,21 @@
 #include <Python.h>
 #include <assert.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <dirent.h>
+#include <pwd.h>
+#include <poll.h>
+#include <limits.h>
+#include <zlib.h>
 
 #include "structmember.h"
 #include "common.h"
@@ -14,6 +29,8 @@
 #include "memory.h"
 #include "status.h"
 #include "user_options.h"
+#include "interface.h"
+#include "dictstat.h"
 #include "hashcat.h"
 
 #ifndef MAXH
@@ -31,725 +48,13610 @@ DETAILS:\n\
 Signals are used to bind callbacks to hashcat events.\n\
 Ex: hc.event_connect(callback=cracked_callback, signal=\"EVENT_CRACKER_HASH_CRACKED\")\n\n");
 
-/* hashcat object */
-typedef struct
-{
+/* Per-job arena. Owns copies of every string handed to libhashcat for one job so
+   nothing borrows from python objects that can be reassigned while the session runs */
 
-  PyObject_HEAD hashcat_ctx_t * hashcat_ctx;
-  user_options_t *user_options;
-  hashcat_status_t *hashcat_status;
-  int rc_init;
+#define HC_ARENA_BLOCK_SIZE 4096
 
-  PyObject *hash;
-  PyObject *mask;
-  PyObject *dict1;
-  PyObject *dict2;
-  PyObject *rp_files;
-  PyObject *event_types;
-  int hc_argc;
-  char *hc_argv[];
+typedef struct hc_arena_block
+{
 
-} hashcatObject;
+  struct hc_arena_block *next;
+  size_t size;
+  size_t used;
+  char data[];
 
-typedef struct event_handlers_t
+} hc_arena_block_t;
+
+typedef struct hc_arena
 {
-  
-  int id;
-  hashcatObject *hc_self;
-  PyObject *callback;
-  char *esignal;
 
-} event_handlers_t;
+  hc_arena_block_t *head;
+  int failed;
 
-const char *event_strs[] = {
-  
-"EVENT_AUTOTUNE_FINISHED",
-"EVENT_AUTOTUNE_STARTING",
-"EVENT_BITMAP_INIT_POST",
-"EVENT_BITMAP_INIT_PRE",
-"EVENT_CALCULATED_WORDS_BASE",
-"EVENT_CRACKER_FINISHED",
-"EVENT_CRACKER_HASH_CRACKED",
-"EVENT_CRACKER_STARTING",
-"EVENT_HASHLIST_COUNT_LINES_POST",
-"EVENT_HASHLIST_COUNT_LINES_PRE",
-"EVENT_HASHLIST_PARSE_HASH",
-"EVENT_HASHLIST_SORT_HASH_POST",
-"EVENT_HASHLIST_SORT_HASH_PRE",
-"EVENT_HASHLIST_SORT_SALT_POST",
-"EVENT_HASHLIST_SORT_SALT_PRE",
-"EVENT_HASHLIST_UNIQUE_HASH_POST",
-"EVENT_HASHLIST_UNIQUE_HASH_PRE",
-"EVENT_INNERLOOP1_FINISHED",
-"EVENT_INNERLOOP1_STARTING",
-"EVENT_INNERLOOP2_FINISHED",
-"EVENT_INNERLOOP2_STARTING",
-"EVENT_LOG_ERROR",
-"EVENT_LOG_INFO",
-"EVENT_LOG_WARNING",
-"EVENT_LOG_ADVICE",
-"EVENT_MONITOR_RUNTIME_LIMIT",
-"EVENT_MONITOR_STATUS_REFRESH",
-"EVENT_MONITOR_TEMP_ABORT",
-"EVENT_MONITOR_THROTTLE1",
-"EVENT_MONITOR_THROTTLE2",
-"EVENT_MONITOR_THROTTLE3",
-"EVENT_MONITOR_PERFORMANCE_HINT",
-"EVENT_OPENCL_SESSION_POST",
-"EVENT_OPENCL_SESSION_PRE",
-"EVENT_OUTERLOOP_FINISHED",
-"EVENT_OUTERLOOP_MAINSCREEN",
-"EVENT_OUTERLOOP_STARTING",
-"EVENT_POTFILE_ALL_CRACKED",
-"EVENT_POTFILE_HASH_LEFT",
-"EVENT_POTFILE_HASH_SHOW",
-"EVENT_POTFILE_NUM_CRACKED",
-"EVENT_POTFILE_REMOVE_PARSE_POST",
-"EVENT_POTFILE_REMOVE_PARSE_PRE",
-"EVENT_SELFTEST_FINISHED",
-"EVENT_SELFTEST_STARTING",
-"EVENT_SET_KERNEL_POWER_FINAL",
-"EVENT_WORDLIST_CACHE_GENERATE",
-"EVENT_WORDLIST_CACHE_HIT",  
+} hc_arena_t;
 
-};        
+static void *hc_arena_alloc (hc_arena_t * arena, size_t len)
+{
 
-#define n_events_types (sizeof (event_strs) / sizeof (const char *))
+  // Keep every allocation pointer aligned
+  len = (len + sizeof (void *) - 1) & ~(sizeof (void *) - 1);
 
-const Py_ssize_t N_EVENTS_TYPES = n_events_types;
-static event_handlers_t handlers[MAXH];
-static int n_handlers = 0;
-static int handler_id = 1000;
-static PyTypeObject hashcat_Type;
+  hc_arena_block_t *block = arena->head;
 
-#define hashcatObject_Check(v)      (Py_TYPE(v) == &hashcat_Type)
+  if ((block == NULL) || (block->size - block->used < len))
+  {
 
-PyDoc_STRVAR(event_connect__doc__,
-"event_connect(callback, signal)\n\n\
-Register callback with dispatcher. Callback will trigger on signal specified\n\n");
+    size_t size = (len > HC_ARENA_BLOCK_SIZE) ? len : HC_ARENA_BLOCK_SIZE;
 
-static PyObject *hashcat_event_connect (hashcatObject * self, PyObject * args, PyObject *kwargs)
-{
+    block = (hc_arena_block_t *) malloc (sizeof (hc_arena_block_t) + size);
 
-  // register the callbacks
-  char *esignal = NULL;
-  int _hid = NULL;
-  PyObject *callback;
-  static char *kwlist[] = {"callback", "signal", NULL};
+    if (block == NULL)
+    {
+      arena->failed = 1;
+      return NULL;
+    }
 
-  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Os", kwlist, &callback, &esignal)) 
-  {
-    return NULL;
+    block->next = arena->head;
+    block->size = size;
+    block->used = 0;
+    arena->head = block;
   }
 
-  if (!PyCallable_Check(callback)) 
-  {
-     PyErr_SetString(PyExc_TypeError, "parameter must be callable");
-     return NULL;
-  }
+  void *ptr = block->data + block->used;
 
+  block->used += len;
 
-  Py_XINCREF(callback);                              /* Add a reference to new callback */
-  Py_XINCREF(self);
-  _hid = ++handler_id;
-  handlers[n_handlers].id = _hid;                    /* id for disconnect function (todo) */
-  handlers[n_handlers].hc_self = self;
-  handlers[n_handlers].callback = callback;          /* Remember new callback */
-  handlers[n_handlers].esignal = esignal;
-  n_handlers++;
+  return ptr;
 
-  return Py_BuildValue ("i", _hid); 
-  
 }
 
-static void event_dispatch(char *esignal, hashcat_ctx_t * hashcat_ctx, const void *buf, const size_t len)
+static char *hc_arena_strdup (hc_arena_t * arena, const char *str)
 {
-    
-    PyObject *result = NULL;
-    PyObject *args;
-
-    for(int ref = 0; ref < n_handlers; ref++)
-    {
-      if (handlers[ref].esignal != NULL)
-      {
-        if((strcmp(esignal, handlers[ref].esignal) == 0) || (strcmp("ANY", handlers[ref].esignal) == 0))
-        {
-
-          PyGILState_STATE state = PyGILState_Ensure();
 
-            if(!PyCallable_Check(handlers[ref].callback))
-            {
-              fprintf(stderr, "event_dispatch: expected a callable\n");
-
-            }
-            else
-            {
+  if (str == NULL)
+    return NULL;
 
-              args = Py_BuildValue("(O)", handlers[ref].hc_self);
-              result = PyObject_Call(handlers[ref].callback, args, NULL);
+  const size_t len = strlen (str) + 1;
 
-              if(PyErr_Occurred())
-              {
-                PyErr_Print();
+  char *dup = (char *) hc_arena_alloc (arena, len);
 
-              }
-            }
+  if (dup != NULL)
+    memcpy (dup, str, len);
 
-          Py_XDECREF(result);
-          PyGILState_Release(state);
-        }
-      }
-    }
+  return dup;
 
 }
 
-static void event (const u32 id, hashcat_ctx_t * hashcat_ctx, const void *buf, const size_t len)
+static void hc_arena_free (hc_arena_t * arena)
 {
 
-  char *esignal;
-  int size = -1;
+  hc_arena_block_t *block = arena->head;
 
-  switch (id)
+  while (block != NULL)
   {
-    case EVENT_AUTOTUNE_FINISHED:               size = asprintf(&esignal, "%s", "EVENT_AUTOTUNE_FINISHED"); break;
-    case EVENT_AUTOTUNE_STARTING:               size = asprintf(&esignal, "%s", "EVENT_AUTOTUNE_STARTING"); break;
-    case EVENT_BITMAP_INIT_POST:                size = asprintf(&esignal, "%s", "EVENT_BITMAP_INIT_POST"); break;
-    case EVENT_BITMAP_INIT_PRE:                 size = asprintf(&esignal, "%s", "EVENT_BITMAP_INIT_PRE"); break;
-    case EVENT_CALCULATED_WORDS_BASE:           size = asprintf(&esignal, "%s", "EVENT_CALCULATED_WORDS_BASE"); break;
-    case EVENT_CRACKER_FINISHED:                size = asprintf(&esignal, "%s", "EVENT_CRACKER_FINISHED"); break;
-    case EVENT_CRACKER_HASH_CRACKED:            size = asprintf(&esignal, "%s", "EVENT_CRACKER_HASH_CRACKED"); break;
-    case EVENT_CRACKER_STARTING:                size = asprintf(&esignal, "%s", "EVENT_CRACKER_STARTING"); break;
-    case EVENT_HASHLIST_COUNT_LINES_POST:       size = asprintf(&esignal, "%s", "EVENT_HASHLIST_COUNT_LINES_POST"); break;
-    case EVENT_HASHLIST_COUNT_LINES_PRE:        size = asprintf(&esignal, "%s", "EVENT_HASHLIST_COUNT_LINES_PRE"); break;
-    case EVENT_HASHLIST_PARSE_HASH:             size = asprintf(&esignal, "%s", "EVENT_HASHLIST_PARSE_HASH"); break;
-    case EVENT_HASHLIST_SORT_HASH_POST:         size = asprintf(&esignal, "%s", "EVENT_HASHLIST_SORT_HASH_POST"); break;
-    case EVENT_HASHLIST_SORT_HASH_PRE:          size = asprintf(&esignal, "%s", "EVENT_HASHLIST_SORT_HASH_PRE"); break;
-    case EVENT_HASHLIST_SORT_SALT_POST:         size = asprintf(&esignal, "%s", "EVENT_HASHLIST_SORT_SALT_POST"); break;
-    case EVENT_HASHLIST_SORT_SALT_PRE:          size = asprintf(&esignal, "%s", "EVENT_HASHLIST_SORT_SALT_PRE"); break;
-    case EVENT_HASHLIST_UNIQUE_HASH_POST:       size = asprintf(&esignal, "%s", "EVENT_HASHLIST_UNIQUE_HASH_POST"); break;
-    case EVENT_HASHLIST_UNIQUE_HASH_PRE:        size = asprintf(&esignal, "%s", "EVENT_HASHLIST_UNIQUE_HASH_PRE"); break;
-    case EVENT_INNERLOOP1_FINISHED:             size = asprintf(&esignal, "%s", "EVENT_INNERLOOP1_FINISHED"); break;
-    case EVENT_INNERLOOP1_STARTING:             size = asprintf(&esignal, "%s", "EVENT_INNERLOOP1_STARTING"); break;
-    case EVENT_INNERLOOP2_FINISHED:             size = asprintf(&esignal, "%s", "EVENT_INNERLOOP2_FINISHED"); break;
-    case EVENT_INNERLOOP2_STARTING:             size = asprintf(&esignal, "%s", "EVENT_INNERLOOP2_STARTING"); break;
-    case EVENT_LOG_ERROR:                       size = asprintf(&esignal, "%s", "EVENT_LOG_ERROR"); break;
-    case EVENT_LOG_INFO:                        size = asprintf(&esignal, "%s", "EVENT_LOG_INFO"); break;
-    case EVENT_LOG_WARNING:                     size = asprintf(&esignal, "%s", "EVENT_LOG_WARNING"); break;
-    case EVENT_LOG_ADVICE:                      size = asprintf(&esignal, "%s", "EVENT_LOG_ADVICE"); break;
-    case EVENT_MONITOR_RUNTIME_LIMIT:           size = asprintf(&esignal, "%s", "EVENT_MONITOR_RUNTIME_LIMIT"); break;
-    case EVENT_MONITOR_STATUS_REFRESH:          size = asprintf(&esignal, "%s", "EVENT_MONITOR_STATUS_REFRESH"); break;
-    case EVENT_MONITOR_TEMP_ABORT:              size = asprintf(&esignal, "%s", "EVENT_MONITOR_TEMP_ABORT"); break;
-    case EVENT_MONITOR_THROTTLE1:               size = asprintf(&esignal, "%s", "EVENT_MONITOR_THROTTLE1"); break;
-    case EVENT_MONITOR_THROTTLE2:               size = asprintf(&esignal, "%s", "EVENT_MONITOR_THROTTLE2"); break;
-    case EVENT_MONITOR_THROTTLE3:               size = asprintf(&esignal, "%s", "EVENT_MONITOR_THROTTLE3"); break;
-    case EVENT_MONITOR_PERFORMANCE_HINT:        size = asprintf(&esignal, "%s", "EVENT_MONITOR_PERFORMANCE_HINT"); break;
-    case EVENT_OPENCL_SESSION_POST:             size = asprintf(&esignal, "%s", "EVENT_OPENCL_SESSION_POST"); break;
-    case EVENT_OPENCL_SESSION_PRE:              size = asprintf(&esignal, "%s", "EVENT_OPENCL_SESSION_PRE"); break;
-    case EVENT_OUTERLOOP_FINISHED:              size = asprintf(&esignal, "%s", "EVENT_OUTERLOOP_FINISHED"); break;
-    case EVENT_OUTERLOOP_MAINSCREEN:            size = asprintf(&esignal, "%s", "EVENT_OUTERLOOP_MAINSCREEN"); break;
-    case EVENT_OUTERLOOP_STARTING:              size = asprintf(&esignal, "%s", "EVENT_OUTERLOOP_STARTING"); break;
-    case EVENT_POTFILE_ALL_CRACKED:             size = asprintf(&esignal, "%s", "EVENT_POTFILE_ALL_CRACKED"); break;
-    case EVENT_POTFILE_HASH_LEFT:               size = asprintf(&esignal, "%s", "EVENT_POTFILE_HASH_LEFT"); break;
-    case EVENT_POTFILE_HASH_SHOW:               size = asprintf(&esignal, "%s", "EVENT_POTFILE_HASH_SHOW"); break;
-    case EVENT_POTFILE_NUM_CRACKED:             size = asprintf(&esignal, "%s", "EVENT_POTFILE_NUM_CRACKED"); break;
-    case EVENT_POTFILE_REMOVE_PARSE_POST:       size = asprintf(&esignal, "%s", "EVENT_POTFILE_REMOVE_PARSE_POST"); break;
-    case EVENT_POTFILE_REMOVE_PARSE_PRE:        size = asprintf(&esignal, "%s", "EVENT_POTFILE_REMOVE_PARSE_PRE"); break;
-    case EVENT_SELFTEST_FINISHED:               size = asprintf(&esignal, "%s", "EVENT_SELFTEST_FINISHED"); break;
-    case EVENT_SELFTEST_STARTING:               size = asprintf(&esignal, "%s", "EVENT_SELFTEST_STARTING"); break;
-    case EVENT_SET_KERNEL_POWER_FINAL:          size = asprintf(&esignal, "%s", "EVENT_SET_KERNEL_POWER_FINAL"); break;
-    case EVENT_WORDLIST_CACHE_GENERATE:         size = asprintf(&esignal, "%s", "EVENT_WORDLIST_CACHE_GENERATE"); break;
-    case EVENT_WORDLIST_CACHE_HIT:              size = asprintf(&esignal, "%s", "EVENT_WORDLIST_CACHE_HIT"); break;
+    hc_arena_block_t *next = block->next;
+
+    free (block);
 
+    block = next;
   }
 
-  // Signal unassigned do nothing
-  if (size == -1)
-    return;
+  arena->head = NULL;
+  arena->failed = 0;
 
-  event_dispatch(esignal, hashcat_ctx, buf, len);
-  free(esignal);
 }
 
-PyDoc_STRVAR(reset__doc__,
-"hashcat_reset\n\n\
-Completely reset hashcat session to defaults.\n\n");
-
-/*
-  NOTE: A reset function may not be needed. It may be better to delete the hashcat object and reinstantiate a new one.
-        However, deleting the hashcat object does not ensure that dealloc is called because it's up to the interpreter
-        to schedule garbage collection. This may cause memory problems if new objects are created but the memory isn't
-        deallocated even when ref counts are zero. More testing is needed. We may be able to remove this function in 
-        future releases and just use "del object" instead 
-
-*/
-static PyObject *hashcat_reset (hashcatObject * self, PyObject * args, PyObject *kwargs)
+/* hashcat object */
+typedef struct
 {
 
-  
-
-  Py_XDECREF (self->hash);
-  self->hash = Py_BuildValue("s", "");
+  PyObject_HEAD hashcat_ctx_t * hashcat_ctx;
+  user_options_t *user_options;
+  hashcat_status_t *hashcat_status;
+  int rc_init;
 
-  Py_XDECREF (self->dict1);
-  self->dict1 = Py_BuildValue("s", "");
+  PyObject *hash;
+  PyObject *mask;
+  PyObject *dict1;
+  PyObject *dict2;
+  PyObject *wordlists;
+  PyObject *rp_files;
+  PyObject *event_types;
+  PyObject *session_cpus;
+  PyObject *session_numa_nodes;
+  int hash_fd;
+  int dict1_fd;
+  int dict2_fd;
+  int dict1_slice_fd;
+  int dict_gz_fd[2];
+  int wordlist_prefetch;
+  struct hc_gz *dict1_gz;
+  struct hc_prefetch *prefetch;
+  u64 slice_skip;
+  u64 slice_limit;
+  struct hc_pot_sink *pot_sink;
+  int potfile_disable_saved;
+  // The user options as set when the last job started, sessions preprocess the live ones
+  user_options_t options_job;
+  int options_job_saved;
+  struct hc_user_map *user_map;
+  struct hc_stream *stream;
+  hc_arena_t arena;
+  pthread_t hThread;
+  int thread_started;
+  // Deallocated from a callback on the session thread, the thread finishes it once the session returns
+  int dealloc_pending;
+  int session_rc;
+  int closed;
+  volatile double cancel_request_time;
+  volatile double cancel_stop_time;
+  volatile double session_exit_time;
+  int hc_argc;
+  char *hc_argv[];
 
-  Py_XDECREF (self->dict2);
-  self->dict2 = Py_BuildValue("s", "");
-  
-  Py_XDECREF (self->mask);
-  self->mask = Py_BuildValue("s", "");
+} hashcatObject;
 
-  // Initate hashcat clean-up
-  hashcat_session_destroy (self->hashcat_ctx);
+/* hashcat_ctx_t is allocated with a back pointer to its python object so events can find their owner.
+   hashcat_init/hashcat_destroy only touch the leading hashcat_ctx_t, free() on the context releases both */
 
-  hashcat_destroy (self->hashcat_ctx);
+typedef struct hashcat_ctx_owner
+{
 
-  Py_XDECREF (self->hashcat_ctx);
+  hashcat_ctx_t hashcat_ctx;
+  hashcatObject *owner;
 
-  free (self->hashcat_ctx);
-  
-  // Create hashcat main context
-  self->hashcat_ctx = (hashcat_ctx_t *) malloc (sizeof (hashcat_ctx_t));
+} hashcat_ctx_owner_t;
 
-  if (self->hashcat_ctx == NULL)
-    return NULL;
+static hashcat_ctx_t *hashcat_ctx_alloc (hashcatObject * owner)
+{
 
-  // Initialize hashcat context
-  const int rc_hashcat_init = hashcat_init (self->hashcat_ctx, event);
+  hashcat_ctx_owner_t *ctx_owner = (hashcat_ctx_owner_t *) malloc (sizeof (hashcat_ctx_owner_t));
 
-  if (rc_hashcat_init == -1)
+  if (ctx_owner == NULL)
     return NULL;
 
-  // Initialize the user options
-  const int rc_options_init = user_options_init (self->hashcat_ctx);
+  ctx_owner->owner = owner;
 
-  if (rc_options_init == -1)
-    return NULL;
+  return &ctx_owner->hashcat_ctx;
 
-  self->user_options = self->hashcat_ctx->user_options;
+}
 
-  self->hc_argc = 0;
-  PyList_SetSlice(self->rp_files, 0, PyList_Size(self->rp_files), NULL);
+static hashcatObject *hashcat_ctx_owner (hashcat_ctx_t * hashcat_ctx)
+{
 
-  Py_INCREF(Py_None);
-  return Py_None;
+  return ((hashcat_ctx_owner_t *) hashcat_ctx)->owner;
 
 }
 
-/* Helper function to to create a new hashcat object. Called from hashcat_new() */
+/* Monotonic clock in seconds, used for stop latency measurements */
 
-static hashcatObject *newhashcatObject (PyObject * arg)
+static double hc_time_now (void)
 {
 
-  hashcatObject *self;
+  struct timespec ts;
 
-  self = PyObject_New (hashcatObject, &hashcat_Type);
-
-  if (self == NULL)
-    return NULL;
-
-  // Create hashcat main context
-  self->hashcat_ctx = (hashcat_ctx_t *) malloc (sizeof (hashcat_ctx_t));
-
-  if (self->hashcat_ctx == NULL)
-    return NULL;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
 
-  // Initialize hashcat context
-  const int rc_hashcat_init = hashcat_init (self->hashcat_ctx, event);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
 
-  if (rc_hashcat_init == -1)
-    return NULL;
+}
 
-  // Initialize the user options
-  const int rc_options_init = user_options_init (self->hashcat_ctx);
+/* Anonymous in-memory files. Data is handed to libhashcat as /proc/self/fd/N so the
+   regular file code paths keep working while nothing touches the disk */
 
-  if (rc_options_init == -1)
-    return NULL;
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC       0x0001U
+#endif
 
-  self->user_options = self->hashcat_ctx->user_options;
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
 
-  for(int i = 0; i < n_handlers; i++)
-  {
+#define HC_MEMFD_STAGE_SIZE (64 * 1024)
 
-    handlers[i].esignal = NULL;
+static int hc_memfd_create (const char *name)
+{
 
-  }
+#if defined (__NR_memfd_create)
 
-  self->hash = NULL;
-  self->hc_argc = 0;
-  self->mask = NULL;
-  self->dict1 = NULL;
-  self->dict2 = NULL;
-  self->rp_files = PyList_New (0);
-  self->event_types = PyTuple_New(N_EVENTS_TYPES);
-  
-  if (self->event_types == NULL)
-    return NULL;
+  return (int) syscall (__NR_memfd_create, name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
 
-  for(int i = 0; i < N_EVENTS_TYPES; i++)
-  {
+#else
 
-    PyTuple_SET_ITEM(self->event_types, i, Py_BuildValue ("s", event_strs[i]));
+  errno = ENOSYS;
+  return -1;
 
-  }
-  return self;
+#endif
 
 }
 
-/* Function of no arguments returning a new hashcat object Exposed as __new__() method */
+/* Freeze size and content once written. Best effort, older kernels lack sealing */
 
-static PyObject *hashcat_new (PyTypeObject * self, PyObject * noargs, PyObject * nokwds)
+static void hc_memfd_seal (int fd)
 {
-  hashcatObject *new_pyo;
 
-  if (!PyArg_ParseTuple (noargs, ":new"))
-    return NULL;
+#if defined (F_ADD_SEALS)
 
-  new_pyo = newhashcatObject (noargs);
+  fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
 
-  if (new_pyo == NULL)
-    return NULL;
+#endif
 
-  return (PyObject *) new_pyo;
 }
 
+static int hc_write_all (int fd, const char *buf, size_t len)
+{
 
-/* methods */
+  while (len > 0)
+  {
 
-static void hashcat_dealloc (hashcatObject * self)
-{
+    const ssize_t nwritten = write (fd, buf, len);
 
-  Py_XDECREF (self->hash);
-  Py_XDECREF (self->dict1);
-  Py_XDECREF (self->dict2);
-  Py_XDECREF (self->mask);
+    if (nwritten == -1)
+    {
+      if (errno == EINTR)
+        continue;
 
-  // Initate hashcat clean-up
-  hashcat_session_destroy (self->hashcat_ctx);
+      return -1;
+    }
 
-  hashcat_destroy (self->hashcat_ctx);
+    buf += nwritten;
+    len -= nwritten;
+  }
 
-  Py_XDECREF (self->hashcat_ctx);
+  return 0;
 
-  free (self->hashcat_ctx);
+}
 
-  PyObject_Del (self);
+static void hc_memfd_path (int fd, char *buf, size_t len)
+{
+
+  snprintf (buf, len, "/proc/self/fd/%d", fd);
 
 }
 
-static void *hc_session_exe_thread(void *params)
+static void hc_fd_close (int *fd)
 {
- 
- hashcatObject *self = (hashcatObject *) params;
 
- int rtn;
- rtn = hashcat_session_execute(self->hashcat_ctx);
- 
- if(rtn)
-  rtn = rtn;
+  if (*fd == -1)
+    return;
 
- return NULL;
+  close (*fd);
+
+  *fd = -1;
 
 }
 
-PyDoc_STRVAR(hashcat_session_execute__doc__,
-"hashcat_session_execute -> int\n\n\
-Start hashcat cracking session in background thread.\n\n\
-Return 0 on successful thread creation, pthread error number otherwise");
+/* Write a sequence of strings as newline separated lines. Caller holds the GIL */
 
-static PyObject *hashcat_hashcat_session_execute (hashcatObject * self, PyObject * args, PyObject * kwargs)
+static int hc_memfd_write_lines (int fd, PyObject * seq)
 {
 
-  char *py_path = "/usr/bin";
-  char *hc_path = "/usr/local/share/hashcat";
-  static char *kwlist[] = {"py_path", "hc_path", NULL};
+  PyObject *fast = PySequence_Fast (seq, "expected a sequence");
 
-  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ss", kwlist, &py_path, &hc_path)) 
+  if (fast == NULL)
+    return -1;
+
+  char *stage = (char *) malloc (HC_MEMFD_STAGE_SIZE);
+
+  if (stage == NULL)
   {
-    return NULL;
+    Py_DECREF (fast);
+    PyErr_NoMemory ();
+    return -1;
   }
 
-  // Build argv
-  size_t hc_argv_size = 1;
-  char **hc_argv = (char **) calloc (hc_argv_size, sizeof (char *));
+  size_t staged = 0;
+  int rc = 0;
 
-  // Benchmark is a special case
-  if (self->user_options->benchmark){
+  const Py_ssize_t cnt = PySequence_Fast_GET_SIZE (fast);
 
-    self->hc_argc = 1;
-    hc_argv_size = self->hc_argc + 1;
-    hc_argv = (char **) realloc (hc_argv, sizeof (char *) * (hc_argv_size));
-    hc_argv[0] = NULL;
-    self->user_options->hc_argc = self->hc_argc;
-    self->user_options->hc_argv = hc_argv;
+  for (Py_ssize_t i = 0; i < cnt; i++)
+  {
 
-  // Every other case need a hash source set otherwise fail
-  } else if (self->hash == NULL) {
+    PyObject *item = PySequence_Fast_GET_ITEM (fast, i);
 
-    PyErr_SetString (PyExc_RuntimeError, "Hash source not set");
-    Py_INCREF (Py_None);
-    return Py_None;
+    if (!PyString_Check (item))
+    {
+      PyErr_SetString (PyExc_TypeError, "Sequence items must be strings");
+      rc = -1;
+      break;
+    }
 
-  } else {
+    const char *line = PyString_AS_STRING (item);
+    const size_t line_len = PyString_GET_SIZE (item);
 
-    switch (self->user_options->attack_mode)
+    // Flush when the line and its newline no longer fit, oversized lines go straight through
+    if (staged + line_len + 1 > HC_MEMFD_STAGE_SIZE)
     {
-  
-  
-    // 0 | Straight
-    case 0:
-  
-      if (self->dict1 == NULL)
-      {
-  
-        PyErr_SetString (PyExc_RuntimeError, "Undefined dictionary");
-        Py_INCREF (Py_None);
-        return Py_None;
-      }
-  
-      self->hc_argc = 2;
-      hc_argv_size = self->hc_argc + 1;
-      hc_argv = (char **) realloc (hc_argv, sizeof (char *) * (hc_argv_size));
-      hc_argv[0] = PyString_AsString (self->hash);
-      hc_argv[1] = PyString_AsString (self->dict1);
-      hc_argv[2] = NULL;
-      self->user_options->hc_argc = self->hc_argc;
-      self->user_options->hc_argv = hc_argv;
-  
-      // Set the rules files (rp_files)
-      for (int i = 0; i < PyList_Size (self->rp_files); i++)
-      {
-  
-        self->user_options->rp_files[i] = PyString_AsString (PyList_GetItem (self->rp_files, i));
-      }
-  
-      break;
-  
-      // 1 | Combination
-    case 1:
-  
-      if ((self->dict1 == NULL) || (self->dict2 == NULL))
-      {
-  
-        PyErr_SetString (PyExc_RuntimeError, "Undefined dictionary");
-        Py_INCREF (Py_None);
-        return Py_None;
-      }
-  
-      self->hc_argc = 3;
-      hc_argv_size = self->hc_argc + 1;
-      hc_argv = (char **) realloc (hc_argv, sizeof (char *) * (hc_argv_size));
-      hc_argv[0] = PyString_AsString (self->hash);
-      hc_argv[1] = PyString_AsString (self->dict1);
-      hc_argv[2] = PyString_AsString (self->dict2);
-      hc_argv[3] = NULL;
-      self->user_options->hc_argc = self->hc_argc;
-      self->user_options->hc_argv = hc_argv;
-  
-      break;
-  
-      // 3 | Bruteforce (mask)
-    case 3:
-  
-      if (self->mask == NULL)
-      {
-  
-        PyErr_SetString (PyExc_RuntimeError, "Undefined mask");
-        Py_INCREF (Py_None);
-        return Py_None;
-      }
-  
-      self->hc_argc = 2;
-      hc_argv_size = self->hc_argc + 1;
-      hc_argv = (char **) realloc (hc_argv, sizeof (char *) * (hc_argv_size));
-      hc_argv[0] = PyString_AsString (self->hash);
-      hc_argv[1] = PyString_AsString (self->mask);
-      hc_argv[2] = NULL;
-      self->user_options->hc_argc = self->hc_argc;
-      self->user_options->hc_argv = hc_argv;
-  
-      break;
-  
-      // 6 | Hybrid dict mask
-    case 6:
-  
-      if (self->dict1 == NULL)
-      {
-  
-        PyErr_SetString (PyExc_RuntimeError, "Undefined dictionary");
-        Py_INCREF (Py_None);
-        return Py_None;
-      }
-  
-      if (self->mask == NULL)
-      {
-  
-        PyErr_SetString (PyExc_RuntimeError, "Undefined mask");
-        Py_INCREF (Py_None);
-        return Py_None;
-      }
-  
-      self->hc_argc = 3;
-      hc_argv_size = self->hc_argc + 1;
-      hc_argv = (char **) realloc (hc_argv, sizeof (char *) * (hc_argv_size));
-      hc_argv[0] = PyString_AsString (self->hash);
-      hc_argv[1] = PyString_AsString (self->dict1);
-      hc_argv[2] = PyString_AsString (self->mask);
-      hc_argv[3] = NULL;
-      self->user_options->hc_argc = self->hc_argc;
-      self->user_options->hc_argv = hc_argv;
-  
-      break;
-  
-      // 7 | Hybrid mask dict
-    case 7:
-  
-      if (self->dict1 == NULL)
+      if ((hc_write_all (fd, stage, staged) == -1) || ((line_len + 1 > HC_MEMFD_STAGE_SIZE) && (hc_write_all (fd, line, line_len) == -1)))
       {
-  
-        PyErr_SetString (PyExc_RuntimeError, "Undefined dictionary");
-        Py_INCREF (Py_None);
-        return Py_None;
+        PyErr_SetFromErrno (PyExc_OSError);
+        rc = -1;
+        break;
       }
-  
-      if (self->mask == NULL)
+
+      staged = 0;
+
+      if (line_len + 1 > HC_MEMFD_STAGE_SIZE)
       {
-  
-        PyErr_SetString (PyExc_RuntimeError, "Undefined mask");
-        Py_INCREF (Py_None);
-        return Py_None;
+        stage[staged++] = '\n';
+        continue;
       }
-  
-      self->hc_argc = 3;
-      hc_argv_size = self->hc_argc + 1;
-      hc_argv = (char **) realloc (hc_argv, sizeof (char *) * (hc_argv_size));
-      hc_argv[0] = PyString_AsString (self->hash);
-      hc_argv[1] = PyString_AsString (self->mask);
-      hc_argv[2] = PyString_AsString (self->dict1);
-      hc_argv[3] = NULL;
-      self->user_options->hc_argc = self->hc_argc;
-      self->user_options->hc_argv = hc_argv;
-  
-      break;
-  
-    default:
-  
-      PyErr_SetString (PyExc_NotImplementedError, "Invalid Attack Mode");
-      Py_INCREF (Py_None);
-      return Py_None;
-  
-  
     }
 
+    memcpy (stage + staged, line, line_len);
+
+    staged += line_len;
 
+    stage[staged++] = '\n';
   }
 
-  
+  if ((rc == 0) && (hc_write_all (fd, stage, staged) == -1))
+  {
+    PyErr_SetFromErrno (PyExc_OSError);
+    rc = -1;
+  }
 
+  free (stage);
+  Py_DECREF (fast);
 
-  /**  
-   *   !! IMPORTANT !!
-   *   Getting the args to hashcat_session_init correct is critical. 
-   *   The first parameter is where Python is installed and
-   *   the second is where you installed all the hashcat files.
-   * 
-   * */
-  self->rc_init = hashcat_session_init (self->hashcat_ctx, py_path, hc_path, 0, NULL, 0);
+  return rc;
 
-  if (self->rc_init != 0)
-  {
+}
 
-    char *msg = hashcat_get_log (self->hashcat_ctx);
+/* Write the contents of a buffer-protocol object (str, bytearray, memoryview, mmap). Caller holds the GIL */
 
-    PyErr_SetString (PyExc_RuntimeError, msg);
+static int hc_memfd_write_buffer (int fd, PyObject * obj)
+{
 
-    Py_INCREF (Py_None);
-    return Py_None;
+  int rc;
 
-  }
+  if (PyObject_CheckBuffer (obj))
+  {
 
-  int rtn;
-  pthread_t hThread;
-  
-  Py_BEGIN_ALLOW_THREADS
+    Py_buffer view;
 
-  rtn = pthread_create(&hThread, NULL, &hc_session_exe_thread, (void *)self);
+    if (PyObject_GetBuffer (obj, &view, PyBUF_SIMPLE) == -1)
+      return -1;
 
-  Py_END_ALLOW_THREADS
+    Py_BEGIN_ALLOW_THREADS
 
+    rc = hc_write_all (fd, (const char *) view.buf, view.len);
 
-  return Py_BuildValue ("i", rtn);
-}
+    Py_END_ALLOW_THREADS
 
+    PyBuffer_Release (&view);
 
-PyDoc_STRVAR(hashcat_session_pause__doc__,
-"hashcat_session_pause -> int\n\n\
+  }
+  else
+  {
+
+    // Old style buffers (mmap, buffer) on python 2 can not be held, another thread may close an mmap
+    // under us. Pieces are copied with the GIL held and written without it, the buffer is looked up
+    // again for every piece
+    const size_t piece_size = 1024 * 1024;
+
+    char *piece = (char *) malloc (piece_size);
+
+    if (piece == NULL)
+    {
+      PyErr_NoMemory ();
+      return -1;
+    }
+
+    Py_ssize_t off = 0;
+
+    rc = 0;
+
+    while (rc == 0)
+    {
+
+      const void *buf;
+      Py_ssize_t len;
+
+      if (PyObject_AsReadBuffer (obj, &buf, &len) == -1)
+      {
+        free (piece);
+        return -1;
+      }
+
+      if (off >= len)
+        break;
+
+      const size_t n = ((size_t) (len - off) < piece_size) ? (size_t) (len - off) : piece_size;
+
+      memcpy (piece, (const char *) buf + off, n);
+
+      Py_BEGIN_ALLOW_THREADS
+
+      rc = hc_write_all (fd, piece, n);
+
+      Py_END_ALLOW_THREADS
+
+      off += n;
+    }
+
+    free (piece);
+
+  }
+
+  if (rc == -1)
+    PyErr_SetFromErrno (PyExc_OSError);
+
+  return rc;
+
+}
+
+/* Create a sealed memfd holding obj, a sequence of strings or a buffer. Return fd or -1 with a python error set */
+
+static int hc_memfd_from_object (const char *name, PyObject * obj)
+{
+
+  const int fd = hc_memfd_create (name);
+
+  if (fd == -1)
+  {
+    PyErr_SetFromErrno (PyExc_OSError);
+    return -1;
+  }
+
+  int rc;
+
+  if (PyList_Check (obj) || PyTuple_Check (obj))
+    rc = hc_memfd_write_lines (fd, obj);
+  else
+    rc = hc_memfd_write_buffer (fd, obj);
+
+  if (rc == -1)
+  {
+    close (fd);
+    return -1;
+  }
+
+  hc_memfd_seal (fd);
+
+  return fd;
+
+}
+
+/* Potfile sink. Cracks reported through EVENT_CRACKER_HASH_CRACKED are buffered and appended to the
+   potfile in batches of whole records, each batch one O_APPEND write under an exclusive flock on the
+   potfile, the lock compact_potfile swaps under. The potfile is only open during a write, so a sink
+   never holds on to a replaced file. Records arrive on the session thread, flushes from python take
+   the same mutex */
+
+#define HC_SINK_FSYNC_NEVER   0
+#define HC_SINK_FSYNC_BATCH   1
+#define HC_SINK_FSYNC_FINISH  2
+
+typedef struct hc_pot_sink
+{
+
+  pthread_mutex_t lock;
+
+  char *path;
+  int fd;
+  int fsync_policy;
+  u32 batch;
+
+  char *buf;
+  size_t len;
+  size_t size;
+  u32 pending;
+
+  u64 records;
+  u64 writes;
+  u64 bytes;
+
+  // errno of a failed flush on the session thread, reported by the next flush from python
+  int error;
+
+} hc_pot_sink_t;
+
+/* Lock the potfile and open it for appending, following a potfile that was replaced. The lock is taken
+   through a read-only descriptor, compact_potfile refuses to swap a potfile open for writing and the
+   sink only opens it for writing once it holds the lock. Caller holds sink->lock. Return the locked
+   descriptor with sink->fd open for appending, or -1 with errno set */
+
+static int hc_pot_sink_lock_file (hc_pot_sink_t * sink)
+{
+
+  for (int attempt = 0; attempt < 3; attempt++)
+  {
+
+    const int lock_fd = open (sink->path, O_RDONLY | O_CREAT | O_CLOEXEC, 0644);
+
+    if (lock_fd == -1)
+      return -1;
+
+    struct stat fd_st;
+    struct stat path_st;
+
+    int rc = ((flock (lock_fd, LOCK_EX) == -1) || (fstat (lock_fd, &fd_st) == -1)) ? -1 : 0;
+
+    const int replaced = (rc == 0) && ((stat (sink->path, &path_st) == -1) || (fd_st.st_dev != path_st.st_dev) || (fd_st.st_ino != path_st.st_ino));
+
+    // The potfile is only replaced under this lock
+    if ((rc == 0) && (!replaced))
+    {
+      sink->fd = open (sink->path, O_WRONLY | O_APPEND | O_CLOEXEC);
+
+      if (sink->fd != -1)
+        return lock_fd;
+
+      rc = -1;
+    }
+
+    const int saved_errno = errno;
+
+    // Closing drops the lock on the old file
+    close (lock_fd);
+
+    errno = saved_errno;
+
+    if (rc == -1)
+      return -1;
+  }
+
+  errno = EAGAIN;
+
+  return -1;
+
+}
+
+/* Write the buffered records. A batch that fails part way is cut off again, so the potfile never keeps
+   a torn line and the retry of the whole batch does not duplicate records. Caller holds sink->lock */
+
+static int hc_pot_sink_flush_locked (hc_pot_sink_t * sink, const int sync)
+{
+
+  if (sink->len == 0)
+    return 0;
+
+  const int lock_fd = hc_pot_sink_lock_file (sink);
+
+  if (lock_fd == -1)
+  {
+    sink->error = errno;
+    return -1;
+  }
+
+  // Other sinks only append under the lock we hold, the end of file is where this batch starts
+  struct stat st;
+
+  off_t start = -1;
+
+  int rc = fstat (sink->fd, &st);
+
+  if (rc == 0)
+  {
+    start = st.st_size;
+
+    rc = hc_write_all (sink->fd, sink->buf, sink->len);
+  }
+
+  if ((rc == 0) && ((sync) || (sink->fsync_policy == HC_SINK_FSYNC_BATCH)))
+    rc = fdatasync (sink->fd);
+
+  if (rc == -1)
+  {
+    sink->error = errno;
+
+    if (start != -1)
+      ftruncate (sink->fd, start);
+  }
+
+  close (sink->fd);
+
+  sink->fd = -1;
+
+  // Closing drops the lock
+  close (lock_fd);
+
+  if (rc == 0)
+  {
+    sink->writes++;
+    sink->bytes += sink->len;
+
+    sink->len     = 0;
+    sink->pending = 0;
+  }
+
+  return rc;
+
+}
+
+static void hc_pot_sink_add (hc_pot_sink_t * sink, const char *record, const size_t len)
+{
+
+  pthread_mutex_lock (&sink->lock);
+
+  if (sink->len + len + 1 > sink->size)
+  {
+
+    size_t size = (sink->size == 0) ? 65536 : sink->size;
+
+    while (size < sink->len + len + 1)
+      size *= 2;
+
+    char *buf = (char *) realloc (sink->buf, size);
+
+    if (buf == NULL)
+    {
+      sink->error = ENOMEM;
+
+      pthread_mutex_unlock (&sink->lock);
+      return;
+    }
+
+    sink->buf  = buf;
+    sink->size = size;
+  }
+
+  memcpy (sink->buf + sink->len, record, len);
+
+  sink->buf[sink->len + len] = '\n';
+
+  sink->len += len + 1;
+
+  sink->records++;
+  sink->pending++;
+
+  if (sink->pending >= sink->batch)
+    hc_pot_sink_flush_locked (sink, 0);
+
+  pthread_mutex_unlock (&sink->lock);
+
+}
+
+static int hc_pot_sink_flush (hc_pot_sink_t * sink, const int sync)
+{
+
+  pthread_mutex_lock (&sink->lock);
+
+  const int rc = hc_pot_sink_flush_locked (sink, sync);
+
+  pthread_mutex_unlock (&sink->lock);
+
+  return rc;
+
+}
+
+/* Flush and release the sink. Return -1 with errno set if the last records could not be written */
+
+static int hc_pot_sink_free (hc_pot_sink_t * sink)
+{
+
+  int rc = hc_pot_sink_flush (sink, sink->fsync_policy != HC_SINK_FSYNC_NEVER);
+
+  const int saved_errno = sink->error;
+
+  if (sink->fd != -1)
+    close (sink->fd);
+
+  pthread_mutex_destroy (&sink->lock);
+
+  free (sink->path);
+  free (sink->buf);
+  free (sink);
+
+  if ((rc == 0) && (saved_errno != 0))
+    rc = -1;
+
+  errno = saved_errno;
+
+  return rc;
+
+}
+
+// Defined with the username map below, after the parser helpers
+struct hc_user_map;
+
+static void hc_user_map_add_crack (struct hc_user_map * map, const char *line, size_t len, const int username);
+static void hc_user_map_release (struct hc_user_map * map);
+
+/* Registered callbacks. Entries never move: session threads scan them without the GIL, so a released
+   entry is only cleared, and reused by a later event_connect. Entries change with the GIL held */
+
+typedef struct event_handlers_t
+{
+  
+  int id;
+  hashcatObject *hc_self;
+  PyObject *callback;
+  const char *esignal;
+
+} event_handlers_t;
+
+const char *event_strs[] = {
+  
+"EVENT_AUTOTUNE_FINISHED",
+"EVENT_AUTOTUNE_STARTING",
+"EVENT_BITMAP_INIT_POST",
+"EVENT_BITMAP_INIT_PRE",
+"EVENT_CALCULATED_WORDS_BASE",
+"EVENT_CRACKER_FINISHED",
+"EVENT_CRACKER_HASH_CRACKED",
+"EVENT_CRACKER_STARTING",
+"EVENT_HASHLIST_COUNT_LINES_POST",
+"EVENT_HASHLIST_COUNT_LINES_PRE",
+"EVENT_HASHLIST_PARSE_HASH",
+"EVENT_HASHLIST_SORT_HASH_POST",
+"EVENT_HASHLIST_SORT_HASH_PRE",
+"EVENT_HASHLIST_SORT_SALT_POST",
+"EVENT_HASHLIST_SORT_SALT_PRE",
+"EVENT_HASHLIST_UNIQUE_HASH_POST",
+"EVENT_HASHLIST_UNIQUE_HASH_PRE",
+"EVENT_INNERLOOP1_FINISHED",
+"EVENT_INNERLOOP1_STARTING",
+"EVENT_INNERLOOP2_FINISHED",
+"EVENT_INNERLOOP2_STARTING",
+"EVENT_LOG_ERROR",
+"EVENT_LOG_INFO",
+"EVENT_LOG_WARNING",
+"EVENT_LOG_ADVICE",
+"EVENT_MONITOR_RUNTIME_LIMIT",
+"EVENT_MONITOR_STATUS_REFRESH",
+"EVENT_MONITOR_TEMP_ABORT",
+"EVENT_MONITOR_THROTTLE1",
+"EVENT_MONITOR_THROTTLE2",
+"EVENT_MONITOR_THROTTLE3",
+"EVENT_MONITOR_PERFORMANCE_HINT",
+"EVENT_OPENCL_SESSION_POST",
+"EVENT_OPENCL_SESSION_PRE",
+"EVENT_OUTERLOOP_FINISHED",
+"EVENT_OUTERLOOP_MAINSCREEN",
+"EVENT_OUTERLOOP_STARTING",
+"EVENT_POTFILE_ALL_CRACKED",
+"EVENT_POTFILE_HASH_LEFT",
+"EVENT_POTFILE_HASH_SHOW",
+"EVENT_POTFILE_NUM_CRACKED",
+"EVENT_POTFILE_REMOVE_PARSE_POST",
+"EVENT_POTFILE_REMOVE_PARSE_PRE",
+"EVENT_SELFTEST_FINISHED",
+"EVENT_SELFTEST_STARTING",
+"EVENT_SET_KERNEL_POWER_FINAL",
+"EVENT_WORDLIST_CACHE_GENERATE",
+"EVENT_WORDLIST_CACHE_HIT",  
+
+};        
+
+#define n_events_types (sizeof (event_strs) / sizeof (const char *))
+
+const Py_ssize_t N_EVENTS_TYPES = n_events_types;
+static event_handlers_t handlers[MAXH];
+static int n_handlers = 0;
+static int handler_id = 1000;
+static PyTypeObject hashcat_Type;
+
+#define hashcatObject_Check(v)      (Py_TYPE(v) == &hashcat_Type)
+
+PyDoc_STRVAR(event_connect__doc__,
+"event_connect(callback, signal)\n\n\
+Register callback with dispatcher. Callback will trigger on signal specified\n\n");
+
+static PyObject *hashcat_event_connect (hashcatObject * self, PyObject * args, PyObject *kwargs)
+{
+
+  // register the callbacks
+  char *esignal = NULL;
+  int _hid = NULL;
+  PyObject *callback;
+  static char *kwlist[] = {"callback", "signal", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Os", kwlist, &callback, &esignal)) 
+  {
+    return NULL;
+  }
+
+  if (!PyCallable_Check(callback)) 
+  {
+     PyErr_SetString(PyExc_TypeError, "parameter must be callable");
+     return NULL;
+  }
+
+
+  // The signal name is kept as the static string it matches, dispatch compares it without the GIL
+  const char *signal_str = (strcmp (esignal, "ANY") == 0) ? "ANY" : NULL;
+
+  for (Py_ssize_t i = 0; (signal_str == NULL) && (i < N_EVENTS_TYPES); i++)
+  {
+    if (strcmp (esignal, event_strs[i]) == 0)
+      signal_str = event_strs[i];
+  }
+
+  if (signal_str == NULL)
+  {
+    PyErr_Format (PyExc_ValueError, "Unknown signal %s", esignal);
+    return NULL;
+  }
+
+  int ref;
+
+  for (ref = 0; (ref < n_handlers) && (handlers[ref].hc_self != NULL); ref++);
+
+  if (ref == MAXH)
+  {
+    PyErr_SetString (PyExc_RuntimeError, "Too many event handlers");
+    return NULL;
+  }
+
+  Py_XINCREF(callback);                              /* Add a reference to new callback */
+  Py_XINCREF(self);
+  _hid = ++handler_id;
+  handlers[ref].id = _hid;                           /* id for disconnect function (todo) */
+  handlers[ref].hc_self = self;
+  handlers[ref].callback = callback;                 /* Remember new callback */
+
+  // Published last, a session thread takes an entry with a signal as complete
+  __atomic_store_n (&handlers[ref].esignal, signal_str, __ATOMIC_RELEASE);
+
+  if (ref == n_handlers)
+    __atomic_store_n (&n_handlers, n_handlers + 1, __ATOMIC_RELEASE);
+
+  return Py_BuildValue ("i", _hid); 
+  
+}
+
+static void event_dispatch(char *esignal, hashcat_ctx_t * hashcat_ctx, const void *buf, const size_t len)
+{
+    
+    PyObject *result = NULL;
+    PyObject *args;
+
+    const int cnt = __atomic_load_n (&n_handlers, __ATOMIC_ACQUIRE);
+
+    for(int ref = 0; ref < cnt; ref++)
+    {
+
+      const char *hsignal = __atomic_load_n (&handlers[ref].esignal, __ATOMIC_ACQUIRE);
+
+      if (hsignal != NULL)
+      {
+        if((strcmp(esignal, hsignal) == 0) || (strcmp("ANY", hsignal) == 0))
+        {
+
+          PyGILState_STATE state = PyGILState_Ensure();
+
+          // Released or reused while we waited for the GIL
+          if ((handlers[ref].esignal != hsignal) || (handlers[ref].hc_self == NULL))
+          {
+            PyGILState_Release(state);
+            continue;
+          }
+
+          // The callback may release its own entry
+          PyObject *callback = handlers[ref].callback;
+          PyObject *hc_self = (PyObject *) handlers[ref].hc_self;
+
+          Py_INCREF(callback);
+          Py_INCREF(hc_self);
+
+            if(!PyCallable_Check(callback))
+            {
+              fprintf(stderr, "event_dispatch: expected a callable\n");
+
+            }
+            else
+            {
+
+              args = Py_BuildValue("(O)", hc_self);
+              result = PyObject_Call(callback, args, NULL);
+
+              Py_XDECREF(args);
+
+              if(PyErr_Occurred())
+              {
+                PyErr_Print();
+
+              }
+            }
+
+          Py_XDECREF(result);
+          result = NULL;
+
+          Py_DECREF(callback);
+          Py_DECREF(hc_self);
+
+          PyGILState_Release(state);
+        }
+      }
+    }
+
+}
+
+static void event (const u32 id, hashcat_ctx_t * hashcat_ctx, const void *buf, const size_t len)
+{
+
+  char *esignal;
+  int size = -1;
+
+  // Track when a cancelled session actually winds down, the last finish event wins
+  if ((id == EVENT_CRACKER_FINISHED) || (id == EVENT_OUTERLOOP_FINISHED))
+  {
+
+    hashcatObject *owner = hashcat_ctx_owner (hashcat_ctx);
+
+    if (owner->cancel_request_time > 0)
+      owner->cancel_stop_time = hc_time_now ();
+
+    if (owner->pot_sink != NULL)
+      hc_pot_sink_flush (owner->pot_sink, owner->pot_sink->fsync_policy == HC_SINK_FSYNC_FINISH);
+  }
+
+  if ((id == EVENT_CRACKER_HASH_CRACKED) && (len > 0))
+  {
+
+    hashcatObject *owner = hashcat_ctx_owner (hashcat_ctx);
+
+    if (owner->pot_sink != NULL)
+      hc_pot_sink_add (owner->pot_sink, (const char *) buf, len);
+
+    if (owner->user_map != NULL)
+      hc_user_map_add_crack (owner->user_map, (const char *) buf, len, owner->user_options->username);
+  }
+
+  switch (id)
+  {
+    case EVENT_AUTOTUNE_FINISHED:               size = asprintf(&esignal, "%s", "EVENT_AUTOTUNE_FINISHED"); break;
+    case EVENT_AUTOTUNE_STARTING:               size = asprintf(&esignal, "%s", "EVENT_AUTOTUNE_STARTING"); break;
+    case EVENT_BITMAP_INIT_POST:                size = asprintf(&esignal, "%s", "EVENT_BITMAP_INIT_POST"); break;
+    case EVENT_BITMAP_INIT_PRE:                 size = asprintf(&esignal, "%s", "EVENT_BITMAP_INIT_PRE"); break;
+    case EVENT_CALCULATED_WORDS_BASE:           size = asprintf(&esignal, "%s", "EVENT_CALCULATED_WORDS_BASE"); break;
+    case EVENT_CRACKER_FINISHED:                size = asprintf(&esignal, "%s", "EVENT_CRACKER_FINISHED"); break;
+    case EVENT_CRACKER_HASH_CRACKED:            size = asprintf(&esignal, "%s", "EVENT_CRACKER_HASH_CRACKED"); break;
+    case EVENT_CRACKER_STARTING:                size = asprintf(&esignal, "%s", "EVENT_CRACKER_STARTING"); break;
+    case EVENT_HASHLIST_COUNT_LINES_POST:       size = asprintf(&esignal, "%s", "EVENT_HASHLIST_COUNT_LINES_POST"); break;
+    case EVENT_HASHLIST_COUNT_LINES_PRE:        size = asprintf(&esignal, "%s", "EVENT_HASHLIST_COUNT_LINES_PRE"); break;
+    case EVENT_HASHLIST_PARSE_HASH:             size = asprintf(&esignal, "%s", "EVENT_HASHLIST_PARSE_HASH"); break;
+    case EVENT_HASHLIST_SORT_HASH_POST:         size = asprintf(&esignal, "%s", "EVENT_HASHLIST_SORT_HASH_POST"); break;
+    case EVENT_HASHLIST_SORT_HASH_PRE:          size = asprintf(&esignal, "%s", "EVENT_HASHLIST_SORT_HASH_PRE"); break;
+    case EVENT_HASHLIST_SORT_SALT_POST:         size = asprintf(&esignal, "%s", "EVENT_HASHLIST_SORT_SALT_POST"); break;
+    case EVENT_HASHLIST_SORT_SALT_PRE:          size = asprintf(&esignal, "%s", "EVENT_HASHLIST_SORT_SALT_PRE"); break;
+    case EVENT_HASHLIST_UNIQUE_HASH_POST:       size = asprintf(&esignal, "%s", "EVENT_HASHLIST_UNIQUE_HASH_POST"); break;
+    case EVENT_HASHLIST_UNIQUE_HASH_PRE:        size = asprintf(&esignal, "%s", "EVENT_HASHLIST_UNIQUE_HASH_PRE"); break;
+    case EVENT_INNERLOOP1_FINISHED:             size = asprintf(&esignal, "%s", "EVENT_INNERLOOP1_FINISHED"); break;
+    case EVENT_INNERLOOP1_STARTING:             size = asprintf(&esignal, "%s", "EVENT_INNERLOOP1_STARTING"); break;
+    case EVENT_INNERLOOP2_FINISHED:             size = asprintf(&esignal, "%s", "EVENT_INNERLOOP2_FINISHED"); break;
+    case EVENT_INNERLOOP2_STARTING:             size = asprintf(&esignal, "%s", "EVENT_INNERLOOP2_STARTING"); break;
+    case EVENT_LOG_ERROR:                       size = asprintf(&esignal, "%s", "EVENT_LOG_ERROR"); break;
+    case EVENT_LOG_INFO:                        size = asprintf(&esignal, "%s", "EVENT_LOG_INFO"); break;
+    case EVENT_LOG_WARNING:                     size = asprintf(&esignal, "%s", "EVENT_LOG_WARNING"); break;
+    case EVENT_LOG_ADVICE:                      size = asprintf(&esignal, "%s", "EVENT_LOG_ADVICE"); break;
+    case EVENT_MONITOR_RUNTIME_LIMIT:           size = asprintf(&esignal, "%s", "EVENT_MONITOR_RUNTIME_LIMIT"); break;
+    case EVENT_MONITOR_STATUS_REFRESH:          size = asprintf(&esignal, "%s", "EVENT_MONITOR_STATUS_REFRESH"); break;
+    case EVENT_MONITOR_TEMP_ABORT:              size = asprintf(&esignal, "%s", "EVENT_MONITOR_TEMP_ABORT"); break;
+    case EVENT_MONITOR_THROTTLE1:               size = asprintf(&esignal, "%s", "EVENT_MONITOR_THROTTLE1"); break;
+    case EVENT_MONITOR_THROTTLE2:               size = asprintf(&esignal, "%s", "EVENT_MONITOR_THROTTLE2"); break;
+    case EVENT_MONITOR_THROTTLE3:               size = asprintf(&esignal, "%s", "EVENT_MONITOR_THROTTLE3"); break;
+    case EVENT_MONITOR_PERFORMANCE_HINT:        size = asprintf(&esignal, "%s", "EVENT_MONITOR_PERFORMANCE_HINT"); break;
+    case EVENT_OPENCL_SESSION_POST:             size = asprintf(&esignal, "%s", "EVENT_OPENCL_SESSION_POST"); break;
+    case EVENT_OPENCL_SESSION_PRE:              size = asprintf(&esignal, "%s", "EVENT_OPENCL_SESSION_PRE"); break;
+    case EVENT_OUTERLOOP_FINISHED:              size = asprintf(&esignal, "%s", "EVENT_OUTERLOOP_FINISHED"); break;
+    case EVENT_OUTERLOOP_MAINSCREEN:            size = asprintf(&esignal, "%s", "EVENT_OUTERLOOP_MAINSCREEN"); break;
+    case EVENT_OUTERLOOP_STARTING:              size = asprintf(&esignal, "%s", "EVENT_OUTERLOOP_STARTING"); break;
+    case EVENT_POTFILE_ALL_CRACKED:             size = asprintf(&esignal, "%s", "EVENT_POTFILE_ALL_CRACKED"); break;
+    case EVENT_POTFILE_HASH_LEFT:               size = asprintf(&esignal, "%s", "EVENT_POTFILE_HASH_LEFT"); break;
+    case EVENT_POTFILE_HASH_SHOW:               size = asprintf(&esignal, "%s", "EVENT_POTFILE_HASH_SHOW"); break;
+    case EVENT_POTFILE_NUM_CRACKED:             size = asprintf(&esignal, "%s", "EVENT_POTFILE_NUM_CRACKED"); break;
+    case EVENT_POTFILE_REMOVE_PARSE_POST:       size = asprintf(&esignal, "%s", "EVENT_POTFILE_REMOVE_PARSE_POST"); break;
+    case EVENT_POTFILE_REMOVE_PARSE_PRE:        size = asprintf(&esignal, "%s", "EVENT_POTFILE_REMOVE_PARSE_PRE"); break;
+    case EVENT_SELFTEST_FINISHED:               size = asprintf(&esignal, "%s", "EVENT_SELFTEST_FINISHED"); break;
+    case EVENT_SELFTEST_STARTING:               size = asprintf(&esignal, "%s", "EVENT_SELFTEST_STARTING"); break;
+    case EVENT_SET_KERNEL_POWER_FINAL:          size = asprintf(&esignal, "%s", "EVENT_SET_KERNEL_POWER_FINAL"); break;
+    case EVENT_WORDLIST_CACHE_GENERATE:         size = asprintf(&esignal, "%s", "EVENT_WORDLIST_CACHE_GENERATE"); break;
+    case EVENT_WORDLIST_CACHE_HIT:              size = asprintf(&esignal, "%s", "EVENT_WORDLIST_CACHE_HIT"); break;
+
+  }
+
+  // Signal unassigned do nothing
+  if (size == -1)
+    return;
+
+  event_dispatch(esignal, hashcat_ctx, buf, len);
+  free(esignal);
+}
+
+/* Quit a running session and wait for its thread. Caller must hold the GIL */
+
+static int hashcat_session_join (hashcatObject * self)
+{
+
+  if (!self->thread_started)
+    return 0;
+
+  // Joining from inside a callback would wait on ourselves
+  if (pthread_equal (pthread_self (), self->hThread))
+    return -1;
+
+  hashcat_session_quit (self->hashcat_ctx);
+
+  // Callbacks on the session thread need the GIL to finish
+  Py_BEGIN_ALLOW_THREADS
+
+  pthread_join (self->hThread, NULL);
+
+  Py_END_ALLOW_THREADS
+
+  self->thread_started = 0;
+
+  return 0;
+
+}
+
+/* Drop every handler registered for this object along with the references event_connect took. The
+   entries are cleared in place, session threads of other objects may be scanning them */
+
+static void hashcat_handlers_release (hashcatObject * self)
+{
+
+  for (int ref = 0; ref < n_handlers; ref++)
+  {
+    if (handlers[ref].hc_self == self)
+    {
+
+      PyObject *callback = handlers[ref].callback;
+
+      __atomic_store_n (&handlers[ref].esignal, NULL, __ATOMIC_RELEASE);
+
+      handlers[ref].callback = NULL;
+      handlers[ref].hc_self = NULL;
+
+      // Decrefs last, they may run code that connects handlers
+      Py_XDECREF (callback);
+      Py_XDECREF (self);
+
+    }
+  }
+
+}
+
+// Defined with the session thread below
+static void hashcat_job_release (hashcatObject * self);
+
+/* Sessions run with potfile_disable while the potfile sink is open, the value the user set is kept in
+   potfile_disable_saved until the sink is closed or a session runs without it */
+
+static void hashcat_potfile_disable_restore (hashcatObject * self)
+{
+
+  if (self->potfile_disable_saved != -1)
+  {
+    self->user_options->potfile_disable = self->potfile_disable_saved;
+
+    if (self->options_job_saved)
+      self->options_job.potfile_disable = self->potfile_disable_saved;
+
+    self->potfile_disable_saved = -1;
+  }
+
+}
+
+PyDoc_STRVAR(reset__doc__,
+"reset(keep_options=False, keep_backend=True)\n\n\
+Reset hashcat object for a new job.\n\n\
+Job-scoped state (hash, dict1, dict2, wordlists, mask, rules) is always cleared and any\n\
+initialized session is destroyed. A running session is quit and waited for first.\n\n\
+keep_options\tbool\tKeep user options (hash_mode, attack_mode, workload_profile, etc.) as set, not as the session preprocessed them\n\
+keep_backend\tbool\tReuse the hashcat context allocation instead of freeing and re-initializing it\n\n\
+reset(keep_options=False, keep_backend=False) is equivalent to a complete reset to defaults.\n\n");
+
+/*
+  NOTE: A reset function may not be needed. It may be better to delete the hashcat object and reinstantiate a new one.
+        However, deleting the hashcat object does not ensure that dealloc is called because it's up to the interpreter
+        to schedule garbage collection. This may cause memory problems if new objects are created but the memory isn't
+        deallocated even when ref counts are zero. More testing is needed. We may be able to remove this function in 
+        future releases and just use "del object" instead 
+
+*/
+static PyObject *hashcat_reset (hashcatObject * self, PyObject * args, PyObject *kwargs)
+{
+
+  int keep_options = 0;
+  int keep_backend = 1;
+  static char *kwlist[] = {"keep_options", "keep_backend", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ii", kwlist, &keep_options, &keep_backend)) 
+  {
+    return NULL;
+  }
+
+  if (hashcat_session_join (self) == -1)
+  {
+    PyErr_SetString (PyExc_RuntimeError, "Cannot reset from the session thread");
+    return NULL;
+  }
+
+  // The thread is gone, whatever a job that never got that far set up goes here
+  hashcat_job_release (self);
+
+  // The options as the user set them, sets made after the job went into the snapshot. Shallow copy,
+  // string options point into the job arena or python objects we hold a reference to
+  user_options_t saved_options = (self->options_job_saved) ? self->options_job : *self->user_options;
+
+  if (self->potfile_disable_saved != -1)
+    saved_options.potfile_disable = self->potfile_disable_saved;
+
+  self->potfile_disable_saved = -1;
+  self->options_job_saved = 0;
+
+  Py_CLEAR (self->hash);
+  Py_CLEAR (self->dict1);
+  Py_CLEAR (self->dict2);
+  Py_CLEAR (self->wordlists);
+  Py_CLEAR (self->mask);
+
+  hc_fd_close (&self->hash_fd);
+  hc_fd_close (&self->dict1_fd);
+  hc_fd_close (&self->dict2_fd);
+
+  // Initate hashcat clean-up
+  hashcat_session_destroy (self->hashcat_ctx);
+
+  self->rc_init = -1;
+
+  // hashcat_session_destroy destroyed the user options too, keep_backend only reuses the allocation
+  if (!keep_backend)
+  {
+
+    hashcat_destroy (self->hashcat_ctx);
+
+    free (self->hashcat_ctx);
+    
+    // Create hashcat main context
+    self->hashcat_ctx = hashcat_ctx_alloc (self);
+
+    if (self->hashcat_ctx == NULL)
+      return PyErr_NoMemory ();
+
+    // Initialize hashcat context
+    const int rc_hashcat_init = hashcat_init (self->hashcat_ctx, event);
+
+    if (rc_hashcat_init == -1)
+    {
+      PyErr_SetString (PyExc_RuntimeError, "hashcat_init failed");
+      return NULL;
+    }
+
+  }
+
+  // Initialize the user options
+  const int rc_options_init = user_options_init (self->hashcat_ctx);
+
+  if (rc_options_init == -1)
+  {
+    PyErr_SetString (PyExc_RuntimeError, "user_options_init failed");
+    return NULL;
+  }
+
+  self->user_options = self->hashcat_ctx->user_options;
+
+  if (keep_options)
+  {
+
+    // Restore everything except the job-scoped rules and argv
+    char **rp_files = self->user_options->rp_files;
+
+    *self->user_options = saved_options;
+
+    self->user_options->rp_files = rp_files;
+    self->user_options->rp_files_cnt = 0;
+    self->user_options->hc_argc = 0;
+    self->user_options->hc_argv = NULL;
+  }
+  else
+  {
+
+    // Nothing points into the last job's strings anymore
+    hc_arena_free (&self->arena);
+
+    self->wordlist_prefetch = 1;
+  }
+
+  self->hc_argc = 0;
+  PyList_SetSlice(self->rp_files, 0, PyList_Size(self->rp_files), NULL);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+
+}
+
+/* Helper function to to create a new hashcat object. Called from hashcat_new() */
+
+static hashcatObject *newhashcatObject (PyObject * arg)
+{
+
+  hashcatObject *self;
+
+  self = PyObject_New (hashcatObject, &hashcat_Type);
+
+  if (self == NULL)
+    return NULL;
+
+  // Create hashcat main context
+  self->hashcat_ctx = hashcat_ctx_alloc (self);
+
+  if (self->hashcat_ctx == NULL)
+    return NULL;
+
+  // Initialize hashcat context
+  const int rc_hashcat_init = hashcat_init (self->hashcat_ctx, event);
+
+  if (rc_hashcat_init == -1)
+    return NULL;
+
+  // Initialize the user options
+  const int rc_options_init = user_options_init (self->hashcat_ctx);
+
+  if (rc_options_init == -1)
+    return NULL;
+
+  self->user_options = self->hashcat_ctx->user_options;
+
+  for(int i = 0; i < n_handlers; i++)
+  {
+
+    handlers[i].esignal = NULL;
+
+  }
+
+  self->hash = NULL;
+  self->rc_init = -1;
+  self->thread_started = 0;
+  self->dealloc_pending = 0;
+  self->session_rc = 0;
+  self->closed = 0;
+  self->cancel_request_time = 0;
+  self->cancel_stop_time = 0;
+  self->session_exit_time = 0;
+  self->arena.head = NULL;
+  self->arena.failed = 0;
+  self->session_cpus = NULL;
+  self->session_numa_nodes = NULL;
+  self->hash_fd = -1;
+  self->dict1_fd = -1;
+  self->dict2_fd = -1;
+  self->dict1_slice_fd = -1;
+  self->dict_gz_fd[0] = -1;
+  self->dict_gz_fd[1] = -1;
+  self->dict1_gz = NULL;
+  self->wordlist_prefetch = 1;
+  self->prefetch = NULL;
+  self->pot_sink = NULL;
+  self->potfile_disable_saved = -1;
+  self->options_job_saved = 0;
+  self->user_map = NULL;
+  self->stream = NULL;
+  self->hc_argc = 0;
+  self->mask = NULL;
+  self->dict1 = NULL;
+  self->dict2 = NULL;
+  self->wordlists = NULL;
+  self->rp_files = PyList_New (0);
+  self->event_types = PyTuple_New(N_EVENTS_TYPES);
+  
+  if (self->event_types == NULL)
+    return NULL;
+
+  for(int i = 0; i < N_EVENTS_TYPES; i++)
+  {
+
+    PyTuple_SET_ITEM(self->event_types, i, Py_BuildValue ("s", event_strs[i]));
+
+  }
+  return self;
+
+}
+
+/* Function of no arguments returning a new hashcat object Exposed as __new__() method */
+
+static PyObject *hashcat_new (PyTypeObject * self, PyObject * noargs, PyObject * nokwds)
+{
+  hashcatObject *new_pyo;
+
+  if (!PyArg_ParseTuple (noargs, ":new"))
+    return NULL;
+
+  new_pyo = newhashcatObject (noargs);
+
+  if (new_pyo == NULL)
+    return NULL;
+
+  return (PyObject *) new_pyo;
+}
+
+
+/* methods */
+
+static void hashcat_dealloc (hashcatObject * self)
+{
+
+  // The context is in use underneath us, quit the session and leave the rest to its thread
+  if ((!self->closed) && (self->thread_started) && (pthread_equal (pthread_self (), self->hThread)))
+  {
+    self->dealloc_pending = 1;
+
+    hashcat_session_quit (self->hashcat_ctx);
+    return;
+  }
+
+  Py_XDECREF (self->hash);
+  Py_XDECREF (self->dict1);
+  Py_XDECREF (self->dict2);
+  Py_XDECREF (self->wordlists);
+  Py_XDECREF (self->mask);
+  Py_XDECREF (self->session_cpus);
+  Py_XDECREF (self->session_numa_nodes);
+
+  hc_fd_close (&self->hash_fd);
+  hc_fd_close (&self->dict1_fd);
+  hc_fd_close (&self->dict2_fd);
+
+  if (!self->closed)
+  {
+
+    hashcat_session_join (self);
+
+    if (self->pot_sink != NULL)
+      hc_pot_sink_free (self->pot_sink);
+
+    if (self->user_map != NULL)
+      hc_user_map_release (self->user_map);
+
+    // Initate hashcat clean-up
+    hashcat_session_destroy (self->hashcat_ctx);
+
+    hashcat_destroy (self->hashcat_ctx);
+
+    free (self->hashcat_ctx);
+
+    hc_arena_free (&self->arena);
+
+  }
+
+  PyObject_Del (self);
+
+}
+
+PyDoc_STRVAR(close__doc__,
+"close()\n\n\
+Quit any running session, wait for its thread and release the hashcat context\n\
+(device memory and host buffers) immediately.\n\n\
+Callbacks registered with event_connect are disconnected. Any later use of the\n\
+object raises RuntimeError. Calling close() more than once is allowed.\n\n");
+
+static PyObject *hashcat_close (hashcatObject * self, PyObject * noargs)
+{
+
+  if (self->closed)
+  {
+    Py_INCREF (Py_None);
+    return Py_None;
+  }
+
+  if (hashcat_session_join (self) == -1)
+  {
+    PyErr_SetString (PyExc_RuntimeError, "Cannot close from the session thread");
+    return NULL;
+  }
+
+  // Buffered cracks go out even if the object is closed without potfile_sink_close
+  if (self->pot_sink != NULL)
+  {
+    hc_pot_sink_free (self->pot_sink);
+
+    self->pot_sink = NULL;
+  }
+
+  if (self->user_map != NULL)
+  {
+    hc_user_map_release (self->user_map);
+
+    self->user_map = NULL;
+  }
+
+  hashcat_session_destroy (self->hashcat_ctx);
+
+  hashcat_destroy (self->hashcat_ctx);
+
+  free (self->hashcat_ctx);
+
+  hc_arena_free (&self->arena);
+
+  self->hashcat_ctx = NULL;
+  self->user_options = NULL;
+  self->closed = 1;
+
+  Py_CLEAR (self->hash);
+  Py_CLEAR (self->dict1);
+  Py_CLEAR (self->dict2);
+  Py_CLEAR (self->wordlists);
+  Py_CLEAR (self->mask);
+
+  hc_fd_close (&self->hash_fd);
+  hc_fd_close (&self->dict1_fd);
+  hc_fd_close (&self->dict2_fd);
+
+  // Break the self <-> handler reference cycle last, it may hold the final reference besides the caller's
+  hashcat_handlers_release (self);
+
+  Py_INCREF (Py_None);
+  return Py_None;
+
+}
+
+PyDoc_STRVAR(enter__doc__,
+"__enter__() -> Hashcat\n\n\
+Context manager entry, returns the object itself.\n\n");
+
+static PyObject *hashcat_enter (hashcatObject * self, PyObject * noargs)
+{
+
+  Py_INCREF (self);
+  return (PyObject *) self;
+
+}
+
+PyDoc_STRVAR(exit__doc__,
+"__exit__(exc_type, exc_value, traceback) -> bool\n\n\
+Context manager exit, calls close(). Exceptions are not suppressed.\n\n");
+
+static PyObject *hashcat_exit (hashcatObject * self, PyObject * args)
+{
+
+  PyObject *rtn = hashcat_close (self, NULL);
+
+  if (rtn == NULL)
+    return NULL;
+
+  Py_DECREF (rtn);
+
+  Py_INCREF (Py_False);
+  return Py_False;
+
+}
+
+/* Fail fast on a closed object. close, closed and __exit__ stay reachable */
+
+static int hashcat_check_closed (hashcatObject * self, PyObject * name)
+{
+
+  if (!self->closed)
+    return 0;
+
+  if (PyString_Check (name))
+  {
+
+    const char *attr = PyString_AsString (name);
+
+    if ((strcmp (attr, "close") == 0) || (strcmp (attr, "closed") == 0) || (strcmp (attr, "__exit__") == 0) || (strcmp (attr, "__class__") == 0))
+      return 0;
+  }
+
+  PyErr_SetString (PyExc_RuntimeError, "Hashcat object is closed");
+  return -1;
+
+}
+
+static PyObject *hashcat_getattro (hashcatObject * self, PyObject * name)
+{
+
+  if (hashcat_check_closed (self, name) == -1)
+    return NULL;
+
+  return PyObject_GenericGetAttr ((PyObject *) self, name);
+
+}
+
+static int hashcat_setattro (hashcatObject * self, PyObject * name, PyObject * value)
+{
+
+  if (hashcat_check_closed (self, name) == -1)
+    return -1;
+
+  // Once a job is done the live options are the ones it preprocessed, sets go to the snapshot reset restores
+  if ((self->options_job_saved) && ((!self->thread_started) || (self->session_exit_time != 0)))
+  {
+
+    const user_options_t live = *self->user_options;
+
+    *self->user_options = self->options_job;
+
+    const int rc = PyObject_GenericSetAttr ((PyObject *) self, name, value);
+
+    self->options_job = *self->user_options;
+
+    *self->user_options = live;
+
+    return rc;
+  }
+
+  return PyObject_GenericSetAttr ((PyObject *) self, name, value);
+
+}
+
+PyDoc_STRVAR(closed__doc__,
+"closed\tbool\tTrue once close() has been called (read only)\n\n");
+
+static PyObject *hashcat_getclosed (hashcatObject * self)
+{
+
+  return PyBool_FromLong (self->closed);
+
+}
+
+/* Parse a CPU list such as "0-3,8,10-11" into set. Return 0 on success, -1 on malformed input */
+
+static int hc_cpulist_parse (const char *list, cpu_set_t * set)
+{
+
+  const char *p = list;
+
+  while ((*p != 0) && (*p != '\n'))
+  {
+
+    char *end;
+
+    long lo = strtol (p, &end, 10);
+
+    if (end == p)
+      return -1;
+
+    long hi = lo;
+
+    if (*end == '-')
+    {
+      p = end + 1;
+
+      hi = strtol (p, &end, 10);
+
+      if (end == p)
+        return -1;
+    }
+
+    if ((lo < 0) || (hi < lo) || (hi >= CPU_SETSIZE))
+      return -1;
+
+    for (long cpu = lo; cpu <= hi; cpu++)
+      CPU_SET (cpu, set);
+
+    p = end;
+
+    if (*p == ',')
+      p++;
+    else if ((*p != 0) && (*p != '\n'))
+      return -1;
+  }
+
+  return 0;
+
+}
+
+/* Add the CPUs of every NUMA node in a node list ("0", "0-1") to set, as reported by sysfs */
+
+static int hc_numa_nodes_parse (const char *list, cpu_set_t * set)
+{
+
+  cpu_set_t nodes;
+
+  CPU_ZERO (&nodes);
+
+  if (hc_cpulist_parse (list, &nodes) == -1)
+    return -1;
+
+  for (int node = 0; node < CPU_SETSIZE; node++)
+  {
+
+    if (!CPU_ISSET (node, &nodes))
+      continue;
+
+    char path[64];
+
+    snprintf (path, sizeof (path), "/sys/devices/system/node/node%d/cpulist", node);
+
+    FILE *fp = fopen (path, "r");
+
+    if (fp == NULL)
+      return -1;
+
+    char buf[1024];
+
+    char *line = fgets (buf, sizeof (buf), fp);
+
+    fclose (fp);
+
+    if ((line == NULL) || (hc_cpulist_parse (line, set) == -1))
+      return -1;
+  }
+
+  return 0;
+
+}
+
+/* The CPUs of a placement, the union of a CPU list and the CPUs of a NUMA node list. Return 1 with set
+   filled, 0 when both are NULL and threads are left unpinned, -1 with a python error set */
+
+static int hc_placement_cpus (PyObject * cpus, PyObject * numa_nodes, cpu_set_t * set)
+{
+
+  CPU_ZERO (set);
+
+  if ((cpus == NULL) && (numa_nodes == NULL))
+    return 0;
+
+  if ((cpus != NULL) && (hc_cpulist_parse (PyString_AsString (cpus), set) == -1))
+  {
+    PyErr_Format (PyExc_ValueError, "Invalid CPU list: %s", PyString_AsString (cpus));
+    return -1;
+  }
+
+  if ((numa_nodes != NULL) && (hc_numa_nodes_parse (PyString_AsString (numa_nodes), set) == -1))
+  {
+    PyErr_Format (PyExc_ValueError, "Invalid or unknown NUMA node list: %s", PyString_AsString (numa_nodes));
+    return -1;
+  }
+
+  if (CPU_COUNT (set) == 0)
+  {
+    PyErr_SetString (PyExc_ValueError, "Thread placement selects no CPUs");
+    return -1;
+  }
+
+  return 1;
+
+}
+
+/* Create a thread on the CPUs of cpus, unpinned when cpus is NULL. Return 0 or the pthread error */
+
+static int hc_thread_create (pthread_t * thread, const cpu_set_t * cpus, const int detached, void *(*fn) (void *), void *arg)
+{
+
+  pthread_attr_t attr;
+
+  pthread_attr_init (&attr);
+
+  if (detached)
+    pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+
+  int rc = (cpus == NULL) ? 0 : pthread_attr_setaffinity_np (&attr, sizeof (cpu_set_t), cpus);
+
+  if (rc == 0)
+    rc = pthread_create (thread, &attr, fn, arg);
+
+  pthread_attr_destroy (&attr);
+
+  return rc;
+
+}
+
+/* The session placement, which the helper threads of the object (decoders, feeders, prefetch, counting)
+   share with the session thread. Return as hc_placement_cpus */
+
+static int hashcat_placement (hashcatObject * self, cpu_set_t * set)
+{
+
+  return hc_placement_cpus (self->session_cpus, self->session_numa_nodes, set);
+
+}
+
+static int hc_threads_default (int threads)
+{
+
+  if (threads > 0)
+    return threads;
+
+  const long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+
+  return (cpus > 0) ? (int) cpus : 1;
+
+}
+
+/* Run fn on threads pthreads placed on cpus (NULL leaves them unpinned), one params element each.
+   Elements that could not get a thread run on the calling thread. Call without the GIL */
+
+static void hc_run_threads (void *(*fn) (void *), void *params, size_t params_size, int threads, const cpu_set_t * cpus)
+{
+
+  pthread_t *tids = (pthread_t *) calloc (threads, sizeof (pthread_t));
+
+  int started = 0;
+
+  if (tids != NULL)
+  {
+    for (started = 0; started < threads; started++)
+    {
+      if (hc_thread_create (&tids[started], cpus, 0, fn, (char *) params + started * params_size) != 0)
+        break;
+    }
+  }
+
+  for (int i = started; i < threads; i++)
+    fn ((char *) params + i * params_size);
+
+  for (int i = 0; i < started; i++)
+    pthread_join (tids[i], NULL);
+
+  free (tids);
+
+}
+
+/* Wordlist indexes. A sidecar next to the wordlist holds the byte offset of every stride-th word and a
+   content hash of the wordlist. Words are counted the way hashcat counts them for skip and limit: every
+   line shorter than PW_MAX once a trailing CR is dropped, longer lines are not words. A straight attack
+   with skip set hands hashcat an in-memory slice of dict1 starting at the indexed word at or before
+   skip, so hashcat only scans the rest of a stride. hashcat 5 can only open a wordlist from its start */
+
+#define HC_WIDX_MAGIC   "PYHCWIX\001"
+#define HC_WIDX_VERSION 2
+#define HC_WIDX_SUFFIX  ".pyhcwidx"
+
+typedef struct hc_widx_header
+{
+
+  char magic[8];
+  u32 version;
+  u32 stride;
+  u64 file_dev;
+  u64 file_ino;
+  u64 file_size;
+  u64 file_mtime;
+  u64 checksum;
+  u64 words;
+  u64 entries_cnt;
+
+  // largest slice in bytes a session may copy to RAM, 0 never slices
+  u64 slice_max;
+
+} hc_widx_header_t;
+
+typedef struct hc_widx
+{
+
+  void *base;
+  size_t len;
+  const hc_widx_header_t *hdr;
+  const u64 *entries;
+
+} hc_widx_t;
+
+static u64 hc_stat_mtime (const struct stat * st)
+{
+
+  return (u64) st->st_mtim.tv_sec * 1000000000ULL + (u64) st->st_mtim.tv_nsec;
+
+}
+
+static int hc_widx_path (const char *path, char *idx_path, const size_t len)
+{
+
+  if ((size_t) snprintf (idx_path, len, "%s%s", path, HC_WIDX_SUFFIX) >= len)
+  {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  return 0;
+
+}
+
+/* Map the index of the wordlist at path, described by st. Return 1 when it is present and matches the
+   wordlist, 0 when it is missing or stale and -1 on error */
+
+static int hc_widx_open (const char *path, const struct stat * st, hc_widx_t * idx)
+{
+
+  char idx_path[PATH_MAX];
+
+  if (hc_widx_path (path, idx_path, sizeof (idx_path)) == -1)
+    return -1;
+
+  const int fd = open (idx_path, O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+    return (errno == ENOENT) ? 0 : -1;
+
+  struct stat idx_st;
+
+  if (fstat (fd, &idx_st) == -1)
+  {
+    close (fd);
+    return -1;
+  }
+
+  if ((size_t) idx_st.st_size < sizeof (hc_widx_header_t))
+  {
+    close (fd);
+    return 0;
+  }
+
+  void *base = mmap (NULL, idx_st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+  close (fd);
+
+  if (base == MAP_FAILED)
+    return -1;
+
+  const hc_widx_header_t *hdr = (const hc_widx_header_t *) base;
+
+  const int current = (memcmp (hdr->magic, HC_WIDX_MAGIC, 8) == 0)
+                   && (hdr->version == HC_WIDX_VERSION)
+                   && (hdr->stride > 0)
+                   && (hdr->entries_cnt <= ((u64) idx_st.st_size - sizeof (hc_widx_header_t)) / sizeof (u64))
+                   && (hdr->file_dev == (u64) st->st_dev)
+                   && (hdr->file_ino == (u64) st->st_ino)
+                   && (hdr->file_size == (u64) st->st_size)
+                   && (hdr->file_mtime == hc_stat_mtime (st));
+
+  if (!current)
+  {
+    munmap (base, idx_st.st_size);
+    return 0;
+  }
+
+  idx->base    = base;
+  idx->len     = idx_st.st_size;
+  idx->hdr     = hdr;
+  idx->entries = (const u64 *) (hdr + 1);
+
+  return 1;
+
+}
+
+static void hc_widx_close (hc_widx_t * idx)
+{
+
+  munmap (idx->base, idx->len);
+
+}
+
+/* Copy the part of dict1 from the indexed word at or before skip up to the indexed word at or after
+   limit into a sealed memfd and move skip and limit along, the originals come back with
+   hashcat_dict1_unslice. The slice lives in RAM for the whole session and is a new wordlist to the
+   dictstat cache every run, so only shards of at most the index's slice_max bytes are sliced.
+   Return the slice's fd, -1 when there is nothing to gain (no current index, skip within the first
+   stride, no limit, slice too large) so hashcat reads dict1 as before, -2 with a python error set */
+
+#define HC_WIDX_SLICE_MAX (256ULL * 1024 * 1024)
+
+static int hashcat_dict1_slice (hashcatObject * self)
+{
+
+  user_options_t *user_options = self->user_options;
+
+  if ((user_options->attack_mode != 0) || (user_options->skip == 0) || (user_options->limit <= user_options->skip) || (self->dict1 == NULL) || (!PyString_Check (self->dict1)) || (self->dict1_fd != -1))
+    return -1;
+
+  const char *path = PyString_AS_STRING (self->dict1);
+
+  const int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+  // hashcat reports a missing wordlist itself
+  if (fd == -1)
+    return -1;
+
+  struct stat st;
+
+  hc_widx_t idx;
+
+  if ((fstat (fd, &st) == -1) || (!S_ISREG (st.st_mode)) || (hc_widx_open (path, &st, &idx) != 1))
+  {
+    close (fd);
+    return -1;
+  }
+
+  const u64 stride  = idx.hdr->stride;
+  const u64 entries = idx.hdr->entries_cnt;
+  const u64 first   = user_options->skip / stride;
+
+  if ((first == 0) || (first >= entries))
+  {
+    hc_widx_close (&idx);
+    close (fd);
+    return -1;
+  }
+
+  const u64 start     = idx.entries[first];
+  const u64 last      = (user_options->limit + stride - 1) / stride;
+  const u64 end       = (last < entries) ? idx.entries[last] : (u64) st.st_size;
+  const u64 slice_max = idx.hdr->slice_max;
+
+  hc_widx_close (&idx);
+
+  if (end - start > slice_max)
+  {
+    close (fd);
+    return -1;
+  }
+
+  int slice_fd = hc_memfd_create ("pyhashcat-dict1-slice");
+
+  int rc = (slice_fd == -1) ? -1 : 0;
+
+  Py_BEGIN_ALLOW_THREADS
+
+  off_t off = (off_t) start;
+
+  while ((rc == 0) && ((u64) off < end))
+  {
+
+    const size_t chunk = ((end - off) < (1U << 30)) ? (size_t) (end - off) : (1U << 30);
+
+    const ssize_t n = sendfile (slice_fd, fd, &off, chunk);
+
+    if ((n == -1) && (errno == EINTR))
+      continue;
+
+    // The wordlist shrank under us
+    if (n == 0)
+      errno = EIO;
+
+    if (n <= 0)
+      rc = -1;
+  }
+
+  Py_END_ALLOW_THREADS
+
+  close (fd);
+
+  if (rc == -1)
+  {
+    PyErr_SetFromErrnoWithFilename (PyExc_OSError, (char *) path);
+    hc_fd_close (&slice_fd);
+    return -2;
+  }
+
+  hc_memfd_seal (slice_fd);
+
+  self->slice_skip  = user_options->skip;
+  self->slice_limit = user_options->limit;
+
+  user_options->skip -= first * stride;
+
+  user_options->limit -= first * stride;
+
+  self->dict1_slice_fd = slice_fd;
+
+  return slice_fd;
+
+}
+
+static void hashcat_dict1_unslice (hashcatObject * self)
+{
+
+  if (self->dict1_slice_fd == -1)
+    return;
+
+  self->user_options->skip  = self->slice_skip;
+  self->user_options->limit = self->slice_limit;
+
+  hc_fd_close (&self->dict1_slice_fd);
+
+}
+
+/* Compressed wordlists. gzip dictionaries are decompressed by native threads and never land on disk. A
+   BGZF file (bgzip output, every block carries its compressed size) is cut into blocks up front and
+   decoded in parallel batches, any other gzip or zlib data, multi-member included, by one inflate.
+   Decoding runs on its own thread ahead of the reader, through a ring of HC_GZ_RING decoded pieces, so
+   the decode threads overlap whatever consumes the data. Straight attacks stream dict1 into hashcat's
+   stdin through the bounded pipe, the other attacks read their wordlists twice and get a sealed memfd
+   holding the decompressed data, up to HC_GZ_MEMFD_MAX bytes of it */
+
+#define HC_GZ_NONE  0
+#define HC_GZ_GZIP  1
+#define HC_GZ_ZSTD  2
+
+#define HC_GZ_BLOCKS_PER_THREAD 64
+#define HC_GZ_OUT_SIZE          (4 * 1024 * 1024)
+#define HC_GZ_RING              3
+#define HC_GZ_MEMFD_MAX         (1024ULL * 1024 * 1024)
+
+static int hc_gz_detect (const char *path)
+{
+
+  const int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+  // Directories and missing files are left to hashcat
+  if (fd == -1)
+    return HC_GZ_NONE;
+
+  u8 magic[4];
+
+  const ssize_t n = pread (fd, magic, sizeof (magic), 0);
+
+  close (fd);
+
+  if ((n >= 2) && (magic[0] == 0x1f) && (magic[1] == 0x8b))
+    return HC_GZ_GZIP;
+
+  if ((n == 4) && (magic[0] == 0x28) && (magic[1] == 0xb5) && (magic[2] == 0x2f) && (magic[3] == 0xfd))
+    return HC_GZ_ZSTD;
+
+  return HC_GZ_NONE;
+
+}
+
+typedef struct hc_gz_block
+{
+
+  const u8 *in;
+  size_t in_len;
+
+  u8 *out;
+  u32 out_len;
+  u32 crc;
+
+  int failed;
+
+} hc_gz_block_t;
+
+typedef struct hc_gz_job
+{
+
+  hc_gz_block_t *blocks;
+  size_t cnt;
+  size_t *next;
+
+} hc_gz_job_t;
+
+typedef struct hc_gz_piece
+{
+
+  u8 *buf;
+  size_t size;
+  size_t len;
+
+} hc_gz_piece_t;
+
+typedef struct hc_gz
+{
+
+  const u8 *base;
+  size_t len;
+  size_t pos;
+  int threads;
+
+  // cleared at the first member that is not a BGZF block, the rest is one inflate stream
+  int bgzf;
+
+  hc_gz_block_t *blocks;
+  size_t blocks_alloc;
+
+  z_stream zs;
+  int zs_init;
+
+  u8 *out;
+  size_t out_size;
+
+  // placement of the decode threads
+  cpu_set_t cpus;
+  int pinned;
+
+  // Pieces decoded ahead, the reader holds ring[ring_head] until its next call. The decode thread
+  // ends with ring_rc 0 at the end of the data or -1 with ring_errno
+  pthread_mutex_t ring_lock;
+  pthread_cond_t ring_cond;
+  hc_gz_piece_t ring[HC_GZ_RING];
+  u32 ring_head;
+  u32 ring_cnt;
+  int ring_held;
+  int ring_done;
+  int ring_rc;
+  int ring_errno;
+  int ring_stop;
+  int started;
+  pthread_t thread;
+
+} hc_gz_t;
+
+static u32 hc_le32 (const u8 * p)
+{
+
+  return (u32) p[0] | ((u32) p[1] << 8) | ((u32) p[2] << 16) | ((u32) p[3] << 24);
+
+}
+
+/* Size of the BGZF block at p and the length of its header, 0 when the member there is no BGZF block */
+
+static size_t hc_bgzf_block_size (const u8 * p, const size_t avail, size_t * hdr_len)
+{
+
+  // Fixed header with FEXTRA as the only flag, as bgzip writes it
+  if ((avail < 18) || (p[0] != 0x1f) || (p[1] != 0x8b) || (p[2] != 8) || (p[3] != 4))
+    return 0;
+
+  const size_t xlen = (size_t) p[10] | ((size_t) p[11] << 8);
+
+  if (12 + xlen > avail)
+    return 0;
+
+  for (size_t x = 12; x + 4 <= 12 + xlen; )
+  {
+
+    const size_t slen = (size_t) p[x + 2] | ((size_t) p[x + 3] << 8);
+
+    if ((p[x] == 'B') && (p[x + 1] == 'C') && (slen == 2) && (x + 6 <= 12 + xlen))
+    {
+
+      const size_t bsize = ((size_t) p[x + 4] | ((size_t) p[x + 5] << 8)) + 1;
+
+      if ((bsize < 12 + xlen + 8) || (bsize > avail))
+        return 0;
+
+      *hdr_len = 12 + xlen;
+
+      return bsize;
+    }
+
+    x += 4 + slen;
+  }
+
+  return 0;
+
+}
+
+static void *hc_gz_block_thread (void *params)
+{
+
+  hc_gz_job_t *job = (hc_gz_job_t *) params;
+
+  z_stream zs;
+
+  memset (&zs, 0, sizeof (zs));
+
+  const int init = (inflateInit2 (&zs, -MAX_WBITS) == Z_OK);
+
+  for (;;)
+  {
+
+    const size_t i = __sync_fetch_and_add (job->next, 1);
+
+    if (i >= job->cnt)
+      break;
+
+    hc_gz_block_t *block = &job->blocks[i];
+
+    if (!init)
+    {
+      block->failed = 1;
+      continue;
+    }
+
+    inflateReset (&zs);
+
+    zs.next_in   = (Bytef *) block->in;
+    zs.avail_in  = (uInt) block->in_len;
+    zs.next_out  = (Bytef *) block->out;
+    zs.avail_out = block->out_len;
+
+    const int rc = inflate (&zs, Z_FINISH);
+
+    if ((rc != Z_STREAM_END) || (zs.avail_out != 0) || (crc32 (0, block->out, block->out_len) != block->crc))
+      block->failed = 1;
+  }
+
+  if (init)
+    inflateEnd (&zs);
+
+  return NULL;
+
+}
+
+static int hc_gz_open (const char *path, int threads, const cpu_set_t * cpus, hc_gz_t * gz)
+{
+
+  memset (gz, 0, sizeof (hc_gz_t));
+
+  pthread_mutex_init (&gz->ring_lock, NULL);
+  pthread_cond_init (&gz->ring_cond, NULL);
+
+  if (cpus != NULL)
+  {
+    gz->cpus   = *cpus;
+    gz->pinned = 1;
+  }
+
+  const int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+    return -1;
+
+  struct stat st;
+
+  if (fstat (fd, &st) == -1)
+  {
+    close (fd);
+    return -1;
+  }
+
+  gz->len = st.st_size;
+
+  if (gz->len > 0)
+  {
+
+    void *addr = mmap (NULL, gz->len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (addr == MAP_FAILED)
+    {
+      close (fd);
+      return -1;
+    }
+
+    madvise (addr, gz->len, MADV_SEQUENTIAL);
+
+    gz->base = (const u8 *) addr;
+  }
+
+  close (fd);
+
+  size_t hdr_len;
+
+  gz->threads      = threads;
+  gz->bgzf         = (gz->len > 0) && (hc_bgzf_block_size (gz->base, gz->len, &hdr_len) > 0);
+  gz->blocks_alloc = (size_t) threads * HC_GZ_BLOCKS_PER_THREAD;
+  gz->blocks       = (hc_gz_block_t *) calloc (gz->blocks_alloc, sizeof (hc_gz_block_t));
+  gz->out_size     = HC_GZ_OUT_SIZE;
+  gz->out          = (u8 *) malloc (gz->out_size);
+
+  if ((gz->blocks == NULL) || (gz->out == NULL))
+  {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static void hc_gz_close (hc_gz_t * gz)
+{
+
+  if (gz->started)
+  {
+    pthread_mutex_lock (&gz->ring_lock);
+
+    gz->ring_stop = 1;
+
+    pthread_cond_broadcast (&gz->ring_cond);
+    pthread_mutex_unlock (&gz->ring_lock);
+
+    pthread_join (gz->thread, NULL);
+  }
+
+  if (gz->zs_init)
+    inflateEnd (&gz->zs);
+
+  if (gz->base != NULL)
+    munmap ((void *) gz->base, gz->len);
+
+  for (int i = 0; i < HC_GZ_RING; i++)
+    free (gz->ring[i].buf);
+
+  pthread_mutex_destroy (&gz->ring_lock);
+  pthread_cond_destroy (&gz->ring_cond);
+
+  free (gz->blocks);
+  free (gz->out);
+
+}
+
+/* Decode the next batch of BGZF blocks. Return the number of blocks decoded, -1 on corrupt data */
+
+static int hc_gz_next_blocks (hc_gz_t * gz, size_t * out_len)
+{
+
+  size_t cnt = 0;
+  size_t pos = gz->pos;
+
+  *out_len = 0;
+
+  while ((cnt < gz->blocks_alloc) && (pos < gz->len))
+  {
+
+    size_t hdr_len;
+
+    const size_t bsize = hc_bgzf_block_size (gz->base + pos, gz->len - pos, &hdr_len);
+
+    if (bsize == 0)
+      break;
+
+    const u8 *block = gz->base + pos;
+
+    hc_gz_block_t *b = &gz->blocks[cnt++];
+
+    b->in      = block + hdr_len;
+    b->in_len  = bsize - hdr_len - 8;
+    b->crc     = hc_le32 (block + bsize - 8);
+    b->out_len = hc_le32 (block + bsize - 4);
+    b->failed  = 0;
+
+    *out_len += b->out_len;
+
+    pos += bsize;
+  }
+
+  if (cnt == 0)
+    return 0;
+
+  if (*out_len > gz->out_size)
+  {
+
+    u8 *out = (u8 *) realloc (gz->out, *out_len);
+
+    if (out == NULL)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+    gz->out      = out;
+    gz->out_size = *out_len;
+  }
+
+  size_t off = 0;
+
+  for (size_t i = 0; i < cnt; i++)
+  {
+    gz->blocks[i].out = gz->out + off;
+
+    off += gz->blocks[i].out_len;
+  }
+
+  size_t next = 0;
+
+  const int threads = ((size_t) gz->threads < cnt) ? gz->threads : (int) cnt;
+
+  hc_gz_job_t *jobs = (hc_gz_job_t *) calloc (threads, sizeof (hc_gz_job_t));
+
+  if (jobs == NULL)
+  {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (int i = 0; i < threads; i++)
+  {
+    jobs[i].blocks = gz->blocks;
+    jobs[i].cnt    = cnt;
+    jobs[i].next   = &next;
+  }
+
+  hc_run_threads (hc_gz_block_thread, jobs, sizeof (hc_gz_job_t), threads, (gz->pinned) ? &gz->cpus : NULL);
+
+  free (jobs);
+
+  for (size_t i = 0; i < cnt; i++)
+  {
+    if (gz->blocks[i].failed)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  gz->pos = pos;
+
+  return (int) cnt;
+
+}
+
+/* Decode the next piece into gz->out. Return 1 with data set, 0 at the end and -1 with errno set on
+   corrupt or truncated input. Runs on the decode thread */
+
+static int hc_gz_decode (hc_gz_t * gz, const u8 ** data, size_t * len)
+{
+
+  while (gz->bgzf)
+  {
+
+    const int cnt = hc_gz_next_blocks (gz, len);
+
+    if (cnt == -1)
+      return -1;
+
+    if (cnt == 0)
+    {
+      gz->bgzf = 0;
+      break;
+    }
+
+    // Blocks decoding to nothing, the BGZF end marker among them
+    if (*len == 0)
+      continue;
+
+    *data = gz->out;
+
+    return 1;
+  }
+
+  if (gz->pos >= gz->len)
+  {
+
+    // Input used up in the middle of a member
+    if ((gz->zs_init) && (gz->zs.total_in > 0))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    return 0;
+  }
+
+  if (!gz->zs_init)
+  {
+
+    // Automatic gzip or zlib header detection
+    if (inflateInit2 (&gz->zs, MAX_WBITS + 32) != Z_OK)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+    gz->zs_init = 1;
+  }
+
+  z_stream *zs = &gz->zs;
+
+  zs->next_out  = gz->out;
+  zs->avail_out = (uInt) gz->out_size;
+
+  while ((zs->avail_out > 0) && (gz->pos < gz->len))
+  {
+
+    // avail_in is 32 bit, large files go in 1 GiB windows
+    const size_t avail = gz->len - gz->pos;
+
+    zs->next_in  = (Bytef *) (gz->base + gz->pos);
+    zs->avail_in = (uInt) ((avail < (1U << 30)) ? avail : (1U << 30));
+
+    const uInt avail_in = zs->avail_in;
+
+    const int rc = inflate (zs, Z_NO_FLUSH);
+
+    gz->pos += avail_in - zs->avail_in;
+
+    if (rc == Z_STREAM_END)
+    {
+      // Another member may follow
+      inflateReset (zs);
+      continue;
+    }
+
+    if ((rc != Z_OK) && (rc != Z_BUF_ERROR))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    // No progress with input left means the data ends mid-stream
+    if ((rc == Z_BUF_ERROR) && (zs->avail_out > 0))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  *len = gz->out_size - zs->avail_out;
+
+  if (*len == 0)
+  {
+
+    if (zs->total_in > 0)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    return 0;
+  }
+
+  *data = gz->out;
+
+  return 1;
+
+}
+
+static void *hc_gz_decode_thread (void *params)
+{
+
+  hc_gz_t *gz = (hc_gz_t *) params;
+
+  for (;;)
+  {
+
+    // The buffer of the last piece handed over comes from the ring, it is empty at first
+    if (gz->out == NULL)
+    {
+      gz->out      = (u8 *) malloc (HC_GZ_OUT_SIZE);
+      gz->out_size = HC_GZ_OUT_SIZE;
+    }
+
+    const u8 *data;
+    size_t len = 0;
+
+    int rc = (gz->out == NULL) ? -1 : hc_gz_decode (gz, &data, &len);
+
+    const int saved_errno = (gz->out == NULL) ? ENOMEM : errno;
+
+    pthread_mutex_lock (&gz->ring_lock);
+
+    while ((rc == 1) && (gz->ring_cnt == HC_GZ_RING) && (!gz->ring_stop))
+      pthread_cond_wait (&gz->ring_cond, &gz->ring_lock);
+
+    if (gz->ring_stop)
+      rc = 0;
+
+    if (rc == 1)
+    {
+
+      hc_gz_piece_t *piece = &gz->ring[(gz->ring_head + gz->ring_cnt) % HC_GZ_RING];
+
+      // The decoded buffer moves into the ring, the piece's old buffer is decoded into next
+      u8 *buf = piece->buf;
+      const size_t size = piece->size;
+
+      piece->buf  = gz->out;
+      piece->size = gz->out_size;
+      piece->len  = len;
+
+      gz->out      = buf;
+      gz->out_size = size;
+
+      gz->ring_cnt++;
+    }
+    else
+    {
+      gz->ring_done  = 1;
+      gz->ring_rc    = rc;
+      gz->ring_errno = saved_errno;
+    }
+
+    pthread_cond_broadcast (&gz->ring_cond);
+    pthread_mutex_unlock (&gz->ring_lock);
+
+    if (rc != 1)
+      break;
+  }
+
+  return NULL;
+
+}
+
+/* Next piece of decompressed data, valid until the next call. Return 1 with data set, 0 at the end and
+   -1 with errno set on corrupt or truncated input */
+
+static int hc_gz_next (hc_gz_t * gz, const u8 ** data, size_t * len)
+{
+
+  if (!gz->started)
+  {
+
+    const int rc = hc_thread_create (&gz->thread, (gz->pinned) ? &gz->cpus : NULL, 0, hc_gz_decode_thread, gz);
+
+    if (rc != 0)
+    {
+      errno = rc;
+      return -1;
+    }
+
+    gz->started = 1;
+  }
+
+  pthread_mutex_lock (&gz->ring_lock);
+
+  // The caller is done with the piece handed out last
+  if (gz->ring_held)
+  {
+    gz->ring_head = (gz->ring_head + 1) % HC_GZ_RING;
+    gz->ring_cnt--;
+    gz->ring_held = 0;
+
+    pthread_cond_broadcast (&gz->ring_cond);
+  }
+
+  while ((gz->ring_cnt == 0) && (!gz->ring_done))
+    pthread_cond_wait (&gz->ring_cond, &gz->ring_lock);
+
+  int rc = gz->ring_rc;
+  int saved_errno = gz->ring_errno;
+
+  if (gz->ring_cnt > 0)
+  {
+    *data = gz->ring[gz->ring_head].buf;
+    *len  = gz->ring[gz->ring_head].len;
+
+    gz->ring_held = 1;
+
+    rc = 1;
+  }
+
+  pthread_mutex_unlock (&gz->ring_lock);
+
+  if (rc == -1)
+    errno = saved_errno;
+
+  return rc;
+
+}
+
+/* Decompress the wordlist at path into a sealed memfd of at most max bytes. Return the fd or -1 with
+   errno set, EFBIG when the wordlist decompresses to more than max */
+
+static int hc_gz_to_memfd (const char *path, const int threads, const cpu_set_t * cpus, const u64 max)
+{
+
+  hc_gz_t gz;
+
+  if (hc_gz_open (path, threads, cpus, &gz) == -1)
+  {
+    const int saved_errno = errno;
+
+    hc_gz_close (&gz);
+
+    errno = saved_errno;
+    return -1;
+  }
+
+  int fd = hc_memfd_create ("pyhashcat-dict-gz");
+
+  int rc = (fd == -1) ? -1 : 1;
+
+  u64 written = 0;
+
+  while (rc == 1)
+  {
+
+    const u8 *data;
+    size_t len;
+
+    rc = hc_gz_next (&gz, &data, &len);
+
+    if ((rc == 1) && (written + len > max))
+    {
+      errno = EFBIG;
+      rc = -1;
+    }
+
+    if ((rc == 1) && (hc_write_all (fd, (const char *) data, len) == -1))
+      rc = -1;
+
+    written += len;
+  }
+
+  const int saved_errno = errno;
+
+  hc_gz_close (&gz);
+
+  if (rc == -1)
+  {
+    hc_fd_close (&fd);
+
+    errno = saved_errno;
+    return -1;
+  }
+
+  hc_memfd_seal (fd);
+
+  return fd;
+
+}
+
+/* Wordlists for line scans, read in blocks that end at a line end: a plain file is mapped and handed
+   out whole, a gzip one is decoded piece by piece and the line cut at the end of a piece is carried
+   into the next block */
+
+typedef struct hc_lines
+{
+
+  void *map;
+  size_t map_len;
+
+  // The plain wordlist as opened, for cache keys
+  struct stat st;
+
+  hc_gz_t *gz;
+
+  // The carried line, or the carried line and the piece up to its last line end as handed out
+  char *buf;
+  size_t buf_len;
+  size_t buf_size;
+
+  // The rest of the piece handed out last, carried once the caller is done with the block
+  const char *tail;
+  size_t tail_len;
+
+  // Offset of the block handed out last in the decoded wordlist, and the bytes handed out so far
+  u64 offset;
+  u64 read;
+
+  int done;
+
+} hc_lines_t;
+
+/* Read size bytes of the wordlist behind fd as a single block. Return 0 or -1 with errno set */
+
+static int hc_lines_map (hc_lines_t * lines, const int fd, const size_t size)
+{
+
+  memset (lines, 0, sizeof (hc_lines_t));
+
+  if (size == 0)
+    return 0;
+
+  void *addr = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (addr == MAP_FAILED)
+    return -1;
+
+  madvise (addr, size, MADV_SEQUENTIAL);
+
+  lines->map     = addr;
+  lines->map_len = size;
+
+  return 0;
+
+}
+
+/* Read the wordlist at path, decoding gzip with threads. Return 0 or -1 with errno set, close it either way */
+
+static int hc_lines_open (hc_lines_t * lines, const char *path, const int threads, const cpu_set_t * cpus)
+{
+
+  memset (lines, 0, sizeof (hc_lines_t));
+
+  if (hc_gz_detect (path) == HC_GZ_GZIP)
+  {
+
+    lines->gz = (hc_gz_t *) malloc (sizeof (hc_gz_t));
+
+    if (lines->gz == NULL)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+    return hc_gz_open (path, threads, cpus, lines->gz);
+  }
+
+  const int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+  struct stat st;
+
+  if ((fd == -1) || (fstat (fd, &st) == -1))
+  {
+    const int saved_errno = errno;
+
+    if (fd != -1)
+      close (fd);
+
+    errno = saved_errno;
+    return -1;
+  }
+
+  const int rc = hc_lines_map (lines, fd, st.st_size);
+
+  const int saved_errno = errno;
+
+  lines->st = st;
+
+  // The mapping keeps the file alive
+  close (fd);
+
+  errno = saved_errno;
+
+  return rc;
+
+}
+
+static int hc_lines_carry (hc_lines_t * lines, const char *data, const size_t len)
+{
+
+  if (lines->buf_len + len > lines->buf_size)
+  {
+
+    size_t size = (lines->buf_size > 0) ? lines->buf_size : 64 * 1024;
+
+    while (size < lines->buf_len + len)
+      size *= 2;
+
+    char *buf = (char *) realloc (lines->buf, size);
+
+    if (buf == NULL)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+    lines->buf      = buf;
+    lines->buf_size = size;
+  }
+
+  memcpy (lines->buf + lines->buf_len, data, len);
+
+  lines->buf_len += len;
+
+  return 0;
+
+}
+
+/* Next block of whole lines, valid until the next call. Return 1 with block set, 0 at the end and -1
+   with errno set */
+
+static int hc_lines_next (hc_lines_t * lines, const char **block, size_t * len)
+{
+
+  if (lines->done)
+    return 0;
+
+  if (lines->gz == NULL)
+  {
+    lines->done = 1;
+
+    if (lines->map_len == 0)
+      return 0;
+
+    *block = (const char *) lines->map;
+    *len   = lines->map_len;
+
+    lines->read = lines->map_len;
+
+    return 1;
+  }
+
+  // The caller is done with the last block, what it left of the piece is the new carry
+  lines->buf_len = 0;
+
+  if ((lines->tail_len > 0) && (hc_lines_carry (lines, lines->tail, lines->tail_len) == -1))
+    return -1;
+
+  lines->tail_len = 0;
+
+  while (1)
+  {
+
+    const u8 *data;
+    size_t data_len;
+
+    const int rc = hc_gz_next (lines->gz, &data, &data_len);
+
+    if (rc == -1)
+      return -1;
+
+    if (rc == 0)
+    {
+      lines->done = 1;
+
+      if (lines->buf_len == 0)
+        return 0;
+
+      // The last line has no newline
+      *block = lines->buf;
+      *len   = lines->buf_len;
+
+      break;
+    }
+
+    const char *piece = (const char *) data;
+
+    const char *nl = (data_len > 0) ? (const char *) memrchr (piece, '\n', data_len) : NULL;
+
+    // No line ends in the piece, all of it belongs to the carried line
+    if (nl == NULL)
+    {
+      if (hc_lines_carry (lines, piece, data_len) == -1)
+        return -1;
+
+      continue;
+    }
+
+    const size_t whole = (size_t) (nl - piece) + 1;
+
+    lines->tail     = piece + whole;
+    lines->tail_len = data_len - whole;
+
+    if (lines->buf_len == 0)
+    {
+      *block = piece;
+      *len   = whole;
+    }
+    else
+    {
+      if (hc_lines_carry (lines, piece, whole) == -1)
+        return -1;
+
+      *block = lines->buf;
+      *len   = lines->buf_len;
+    }
+
+    break;
+  }
+
+  lines->offset = lines->read;
+  lines->read  += *len;
+
+  return 1;
+
+}
+
+static void hc_lines_close (hc_lines_t * lines)
+{
+
+  if (lines->map != NULL)
+    munmap (lines->map, lines->map_len);
+
+  if (lines->gz != NULL)
+  {
+    hc_gz_close (lines->gz);
+    free (lines->gz);
+  }
+
+  free (lines->buf);
+
+  memset (lines, 0, sizeof (hc_lines_t));
+
+}
+
+/* Open the wordlist at path for a line scan, or with lines NULL only check that it can be read: zstd is
+   refused with a ValueError. Return the HC_GZ_ kind, -1 with a python error set */
+
+static int hashcat_wordlist_open (const char *path, const int threads, const cpu_set_t * cpus, hc_lines_t * lines)
+{
+
+  const int kind = hc_gz_detect (path);
+
+  if (kind == HC_GZ_ZSTD)
+  {
+    PyErr_Format (PyExc_ValueError, "%s is zstd compressed, only gzip wordlists are decompressed", path);
+    return -1;
+  }
+
+  if ((lines != NULL) && (hc_lines_open (lines, path, threads, cpus) == -1))
+  {
+    PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+
+    hc_lines_close (lines);
+    return -1;
+  }
+
+  return kind;
+
+}
+
+/* Release what hashcat_dicts_decompress set up for a job. Runs once the session is done with it */
+
+static void hashcat_dicts_release (hashcatObject * self)
+{
+
+  hc_fd_close (&self->dict_gz_fd[0]);
+  hc_fd_close (&self->dict_gz_fd[1]);
+
+  if (self->dict1_gz != NULL)
+  {
+    hc_gz_close (self->dict1_gz);
+    free (self->dict1_gz);
+
+    self->dict1_gz = NULL;
+  }
+
+}
+
+/* Streamed dict1. A straight attack whose dict1 is an iterable or a file-like object runs in hashcat's
+   stdin mode: fd 0 is swapped for a pipe for the length of the session and a feeder thread fills it.
+   The feeder takes the GIL once per batch of candidates and writes without it, so a slow session
+   blocks the feeder on the pipe rather than python. stdin is process wide, one such session at a time */
+
+#define HC_STREAM_BUF_SIZE  (1024 * 1024)
+#define HC_STREAM_BATCH     4096
+
+static volatile int hc_stream_busy = 0;
+
+typedef struct hc_stream
+{
+
+  // iterator over the candidates, the read method of a file-like or a gzip decoder
+  PyObject *iter;
+  PyObject *read;
+  hc_gz_t *gz;
+
+  int fd;
+  int saved_stdin;
+  pthread_t thread;
+
+  char *buf;
+  size_t size;
+
+} hc_stream_t;
+
+/* Append one candidate and its newline, or raw read() data, to the feeder buffer. Called with the GIL held */
+
+static int hc_stream_append (hc_stream_t * stream, size_t * len, PyObject * item, const int raw)
+{
+
+  PyObject *str = NULL;
+
+  if (PyUnicode_Check (item))
+  {
+    str = PyUnicode_AsUTF8String (item);
+
+    if (str == NULL)
+      return -1;
+
+    item = str;
+  }
+
+  if (!PyString_Check (item))
+  {
+    PyErr_SetString (PyExc_TypeError, "dict1 candidates must be strings");
+    return -1;
+  }
+
+  const char *word = PyString_AS_STRING (item);
+  const size_t word_len = PyString_GET_SIZE (item);
+
+  if (*len + word_len + 1 > stream->size)
+  {
+
+    size_t size = stream->size;
+
+    while (*len + word_len + 1 > size)
+      size *= 2;
+
+    char *buf = (char *) realloc (stream->buf, size);
+
+    if (buf == NULL)
+    {
+      Py_XDECREF (str);
+      PyErr_NoMemory ();
+      return -1;
+    }
+
+    stream->buf  = buf;
+    stream->size = size;
+  }
+
+  memcpy (stream->buf + *len, word, word_len);
+
+  *len += word_len;
+
+  if ((!raw) && ((word_len == 0) || (word[word_len - 1] != '\n')))
+    stream->buf[(*len)++] = '\n';
+
+  Py_XDECREF (str);
+
+  return 0;
+
+}
+
+static void *hc_stream_thread (void *params)
+{
+
+  hc_stream_t *stream = (hc_stream_t *) params;
+
+  // Compressed wordlists never need the GIL
+  if (stream->gz != NULL)
+  {
+
+    const u8 *data;
+    size_t len;
+
+    while ((hc_gz_next (stream->gz, &data, &len) == 1) && (hc_write_all (stream->fd, (const char *) data, len) == 0))
+      continue;
+
+    close (stream->fd);
+
+    stream->fd = -1;
+
+    return NULL;
+  }
+
+  int done = 0;
+
+  while (!done)
+  {
+
+    size_t len = 0;
+
+    PyGILState_STATE state = PyGILState_Ensure ();
+
+    if (stream->read != NULL)
+    {
+
+      PyObject *chunk = PyObject_CallFunction (stream->read, "n", (Py_ssize_t) HC_STREAM_BUF_SIZE);
+
+      if ((chunk != NULL) && (PyString_GET_SIZE (chunk) == 0))
+        done = 1;
+      else if ((chunk == NULL) || (hc_stream_append (stream, &len, chunk, 1) == -1))
+        done = 1;
+
+      Py_XDECREF (chunk);
+    }
+    else
+    {
+
+      for (int i = 0; (i < HC_STREAM_BATCH) && (len < HC_STREAM_BUF_SIZE); i++)
+      {
+
+        PyObject *item = PyIter_Next (stream->iter);
+
+        if (item == NULL)
+        {
+          done = 1;
+          break;
+        }
+
+        const int rc = hc_stream_append (stream, &len, item, 0);
+
+        Py_DECREF (item);
+
+        if (rc == -1)
+        {
+          done = 1;
+          break;
+        }
+      }
+    }
+
+    // There is no caller to raise to, the session just sees the end of the input
+    if (PyErr_Occurred ())
+      PyErr_WriteUnraisable ((stream->read != NULL) ? stream->read : stream->iter);
+
+    PyGILState_Release (state);
+
+    // EPIPE once the session is over, python ignores SIGPIPE
+    if ((len > 0) && (hc_write_all (stream->fd, stream->buf, len) == -1))
+      done = 1;
+  }
+
+  close (stream->fd);
+
+  stream->fd = -1;
+
+  return NULL;
+
+}
+
+/* ranked_merge files are pipes, the first session that streams one consumes it. They are told apart by
+   their close function and marked by their name once streamed, so a later session is refused rather
+   than started on whatever the first one left in the pipe */
+
+#define HC_RANK_NAME        "<ranked merge>"
+#define HC_RANK_NAME_SPENT  "<ranked merge, consumed>"
+
+static int hc_rank_fclose (FILE * fp)
+{
+
+  return fclose (fp);
+
+}
+
+static int hc_rank_spent (PyObject * obj)
+{
+
+  if ((obj == NULL) || (!PyFile_Check (obj)) || (((PyFileObject *) obj)->f_close != hc_rank_fclose))
+    return 0;
+
+  PyObject *name = ((PyFileObject *) obj)->f_name;
+
+  return (PyString_Check (name)) && (strcmp (PyString_AS_STRING (name), HC_RANK_NAME_SPENT) == 0);
+
+}
+
+static void hc_rank_spend (PyObject * obj)
+{
+
+  if ((!PyFile_Check (obj)) || (((PyFileObject *) obj)->f_close != hc_rank_fclose))
+    return;
+
+  PyObject *name = PyString_FromString (HC_RANK_NAME_SPENT);
+
+  if (name == NULL)
+  {
+    PyErr_Clear ();
+    return;
+  }
+
+  PyObject *old = ((PyFileObject *) obj)->f_name;
+
+  ((PyFileObject *) obj)->f_name = name;
+
+  Py_XDECREF (old);
+
+}
+
+static int hc_stream_start (hashcatObject * self, const cpu_set_t * cpus)
+{
+
+  if (!__sync_bool_compare_and_swap (&hc_stream_busy, 0, 1))
+  {
+    PyErr_SetString (PyExc_RuntimeError, "Another session is already streaming its dict1");
+    return -1;
+  }
+
+  hc_stream_t *stream = (hc_stream_t *) calloc (1, sizeof (hc_stream_t));
+
+  if (stream == NULL)
+  {
+    hc_stream_busy = 0;
+
+    PyErr_NoMemory ();
+    return -1;
+  }
+
+  stream->fd = -1;
+  stream->saved_stdin = -1;
+  stream->size = HC_STREAM_BUF_SIZE + 1;
+  stream->buf = (char *) malloc (stream->size);
+
+  if (self->dict1_gz != NULL)
+  {
+    stream->gz = self->dict1_gz;
+
+    self->dict1_gz = NULL;
+  }
+  else if (PyObject_HasAttrString (self->dict1, "read"))
+  {
+    stream->read = PyObject_GetAttrString (self->dict1, "read");
+
+    hc_rank_spend (self->dict1);
+  }
+  else
+  {
+    stream->iter = PyObject_GetIter (self->dict1);
+  }
+
+  int fds[2] = { -1, -1 };
+
+  int failed = (stream->buf == NULL) || ((stream->read == NULL) && (stream->iter == NULL) && (stream->gz == NULL));
+
+  if ((!failed) && (pipe2 (fds, O_CLOEXEC) == -1))
+  {
+    PyErr_SetFromErrno (PyExc_OSError);
+
+    failed = 1;
+  }
+
+  if (!failed)
+  {
+
+    // fd 0 may be closed already, then it is closed again afterwards
+    stream->saved_stdin = fcntl (STDIN_FILENO, F_DUPFD_CLOEXEC, 3);
+
+    dup2 (fds[0], STDIN_FILENO);
+    close (fds[0]);
+
+    clearerr (stdin);
+
+    stream->fd = fds[1];
+
+    const int rc = hc_thread_create (&stream->thread, cpus, 0, hc_stream_thread, stream);
+
+    if (rc != 0)
+    {
+      errno = rc;
+      PyErr_SetFromErrno (PyExc_OSError);
+
+      close (stream->fd);
+
+      if (stream->saved_stdin != -1)
+      {
+        dup2 (stream->saved_stdin, STDIN_FILENO);
+        close (stream->saved_stdin);
+      }
+      else
+      {
+        close (STDIN_FILENO);
+      }
+
+      failed = 1;
+    }
+  }
+
+  if (failed)
+  {
+    if ((stream->buf == NULL) && (!PyErr_Occurred ()))
+      PyErr_NoMemory ();
+
+    // The decoder goes back so hashcat_dicts_release finds it
+    self->dict1_gz = stream->gz;
+
+    Py_XDECREF (stream->iter);
+    Py_XDECREF (stream->read);
+    free (stream->buf);
+    free (stream);
+
+    hc_stream_busy = 0;
+
+    return -1;
+  }
+
+  self->stream = stream;
+
+  return 0;
+
+}
+
+/* End the stream once the session is done with stdin. Runs on the session thread without the GIL */
+
+static void hc_stream_stop (hashcatObject * self)
+{
+
+  hc_stream_t *stream = self->stream;
+
+  if (stream == NULL)
+    return;
+
+  // Dropping the read end releases a feeder waiting on a full pipe
+  if (stream->saved_stdin != -1)
+  {
+    dup2 (stream->saved_stdin, STDIN_FILENO);
+    close (stream->saved_stdin);
+  }
+  else
+  {
+    close (STDIN_FILENO);
+  }
+
+  clearerr (stdin);
+
+  pthread_join (stream->thread, NULL);
+
+  if (stream->gz != NULL)
+  {
+    hc_gz_close (stream->gz);
+    free (stream->gz);
+  }
+  else
+  {
+    PyGILState_STATE state = PyGILState_Ensure ();
+
+    Py_XDECREF (stream->iter);
+    Py_XDECREF (stream->read);
+
+    PyGILState_Release (state);
+  }
+
+  free (stream->buf);
+  free (stream);
+
+  self->stream = NULL;
+
+  hc_stream_busy = 0;
+
+}
+
+/* Wordlist prefetch. While a straight attack works through wordlists a helper thread follows hashcat's
+   position in its list and has the kernel read the current and the next wordlists into the page cache,
+   so a file switch does not start with a cold read. Per file at most a quarter of the memory is
+   prefetched, more would evict the data hashcat is still to read */
+
+#define HC_PREFETCH_STEP  (4 * 1024 * 1024)
+#define HC_PREFETCH_POLL  100
+
+typedef struct hc_prefetch
+{
+
+  char **paths;
+  u32 paths_cnt;
+  u32 ahead;
+
+  // hashcat's index into its wordlists
+  const volatile u32 *pos;
+
+  // closing the write end stops the thread
+  int stop_fd[2];
+  pthread_t thread;
+
+} hc_prefetch_t;
+
+static int hc_prefetch_stopped (hc_prefetch_t * prefetch, const int timeout)
+{
+
+  struct pollfd pfd = { prefetch->stop_fd[0], POLLIN, 0 };
+
+  return poll (&pfd, 1, timeout) > 0;
+
+}
+
+static void hc_prefetch_file (hc_prefetch_t * prefetch, const char *path)
+{
+
+  const int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+    return;
+
+  struct stat st;
+
+  if (fstat (fd, &st) == 0)
+  {
+
+    const u64 budget = (u64) sysconf (_SC_PHYS_PAGES) / 4 * (u64) sysconf (_SC_PAGESIZE);
+
+    const u64 end = ((u64) st.st_size < budget) ? (u64) st.st_size : budget;
+
+    // In steps, a stop request waits for one step at most
+    for (u64 off = 0; (off < end) && (!hc_prefetch_stopped (prefetch, 0)); off += HC_PREFETCH_STEP)
+    {
+      const u64 len = ((end - off) < HC_PREFETCH_STEP) ? (end - off) : HC_PREFETCH_STEP;
+
+      posix_fadvise (fd, (off_t) off, (off_t) len, POSIX_FADV_WILLNEED);
+    }
+  }
+
+  close (fd);
+
+}
+
+static void *hc_prefetch_thread (void *params)
+{
+
+  hc_prefetch_t *prefetch = (hc_prefetch_t *) params;
+
+  u32 next = 0;
+
+  do
+  {
+
+    const u32 pos = *prefetch->pos;
+
+    // Wordlists hashcat has passed already are left alone
+    if (next < pos)
+      next = pos;
+
+    while ((next <= pos + prefetch->ahead) && (next < prefetch->paths_cnt) && (!hc_prefetch_stopped (prefetch, 0)))
+    {
+      hc_prefetch_file (prefetch, prefetch->paths[next]);
+
+      next++;
+    }
+
+  } while ((next < prefetch->paths_cnt) && (!hc_prefetch_stopped (prefetch, HC_PREFETCH_POLL)));
+
+  return NULL;
+
+}
+
+static void hc_prefetch_free (hc_prefetch_t * prefetch)
+{
+
+  for (u32 i = 0; i < prefetch->paths_cnt; i++)
+    free (prefetch->paths[i]);
+
+  free (prefetch->paths);
+
+  hc_fd_close (&prefetch->stop_fd[0]);
+  hc_fd_close (&prefetch->stop_fd[1]);
+
+  free (prefetch);
+
+}
+
+/* Start prefetching the wordlists of a straight attack. Prefetching only saves time, when it can not
+   start the session runs without it */
+
+static void hc_prefetch_start (hashcatObject * self, const cpu_set_t * cpus)
+{
+
+  if ((self->user_options->attack_mode != 0) || (self->wordlists == NULL) || (self->wordlist_prefetch <= 0))
+    return;
+
+  hc_prefetch_t *prefetch = (hc_prefetch_t *) calloc (1, sizeof (hc_prefetch_t));
+
+  if (prefetch == NULL)
+    return;
+
+  prefetch->stop_fd[0] = -1;
+  prefetch->stop_fd[1] = -1;
+  prefetch->ahead = (u32) self->wordlist_prefetch;
+  prefetch->pos = &self->hashcat_ctx->straight_ctx->dicts_pos;
+  prefetch->paths = (char **) calloc (PyTuple_GET_SIZE (self->wordlists), sizeof (char *));
+
+  int failed = (prefetch->paths == NULL) || (pipe2 (prefetch->stop_fd, O_CLOEXEC) == -1);
+
+  for (Py_ssize_t i = 0; (!failed) && (i < PyTuple_GET_SIZE (self->wordlists)); i++)
+  {
+
+    prefetch->paths[i] = strdup (PyString_AS_STRING (PyTuple_GET_ITEM (self->wordlists, i)));
+
+    if (prefetch->paths[i] == NULL)
+      failed = 1;
+    else
+      prefetch->paths_cnt++;
+  }
+
+  if ((!failed) && (hc_thread_create (&prefetch->thread, cpus, 0, hc_prefetch_thread, prefetch) != 0))
+    failed = 1;
+
+  if (failed)
+  {
+    hc_prefetch_free (prefetch);
+    return;
+  }
+
+  self->prefetch = prefetch;
+
+}
+
+/* Stop prefetching. Runs on the session thread without the GIL */
+
+static void hc_prefetch_stop (hashcatObject * self)
+{
+
+  hc_prefetch_t *prefetch = self->prefetch;
+
+  if (prefetch == NULL)
+    return;
+
+  hc_fd_close (&prefetch->stop_fd[1]);
+
+  pthread_join (prefetch->thread, NULL);
+
+  hc_prefetch_free (prefetch);
+
+  self->prefetch = NULL;
+
+}
+
+/* Stop and release what a job set up around its session. Runs on the session thread once the session
+   is done, and again from reset, where it finds nothing left unless the session never ran */
+
+static void hashcat_job_release (hashcatObject * self)
+{
+
+  hc_prefetch_stop (self);
+
+  hc_stream_stop (self);
+
+  hashcat_dict1_unslice (self);
+
+  hashcat_dicts_release (self);
+
+}
+
+static void *hc_session_exe_thread(void *params)
+{
+ 
+ hashcatObject *self = (hashcatObject *) params;
+
+ int rtn;
+ rtn = hashcat_session_execute(self->hashcat_ctx);
+
+ hashcat_job_release (self);
+ 
+ self->session_rc = rtn;
+
+ self->session_exit_time = hc_time_now ();
+
+ // The object went away during the session, nobody is left to join this thread
+ if (self->dealloc_pending)
+ {
+   PyGILState_STATE state = PyGILState_Ensure ();
+
+   pthread_detach (pthread_self ());
+
+   self->thread_started = 0;
+
+   hashcat_dealloc (self);
+
+   PyGILState_Release (state);
+ }
+
+ return NULL;
+
+}
+
+PyDoc_STRVAR(hashcat_session_execute__doc__,
+"hashcat_session_execute -> int\n\n\
+Start hashcat cracking session in background thread.\n\n\
+Return 0 on successful thread creation, pthread error number otherwise");
+
+/* Copy the string options into the job arena so libhashcat never points into python objects. The
+   options are only repointed once every copy succeeded. Return 0 or -1 when the arena ran out */
+
+static int hashcat_arena_options (hashcatObject * self, hc_arena_t * arena)
+{
+
+  user_options_t *user_options = self->user_options;
+
+  char **fields[] =
+  {
+    &user_options->cpu_affinity,
+    &user_options->custom_charset_1,
+    &user_options->custom_charset_2,
+    &user_options->custom_charset_3,
+    &user_options->custom_charset_4,
+    &user_options->debug_file,
+    &user_options->induction_dir,
+    &user_options->markov_hcstat,
+    &user_options->opencl_device_types,
+    &user_options->opencl_devices,
+    &user_options->opencl_platforms,
+    &user_options->outfile,
+    &user_options->outfile_check_dir,
+    &user_options->potfile_path,
+    &user_options->restore_file_path,
+    &user_options->rule_buf_l,
+    &user_options->rule_buf_r,
+    &user_options->session,
+    &user_options->truecrypt_keyfiles,
+    &user_options->veracrypt_keyfiles,
+  };
+
+  const size_t fields_cnt = sizeof (fields) / sizeof (fields[0]);
+
+  char *copies[sizeof (fields) / sizeof (fields[0])];
+
+  for (size_t i = 0; i < fields_cnt; i++)
+    copies[i] = hc_arena_strdup (arena, *fields[i]);
+
+  if (arena->failed)
+    return -1;
+
+  for (size_t i = 0; i < fields_cnt; i++)
+    *fields[i] = copies[i];
+
+  return 0;
+
+}
+
+/* The hash argument, either the string as set or the path of the in-memory hashlist */
+
+static char *hashcat_arena_hash (hashcatObject * self, hc_arena_t * arena)
+{
+
+  if (self->hash_fd == -1)
+    return hc_arena_strdup (arena, PyString_AsString (self->hash));
+
+  char path[32];
+
+  hc_memfd_path (self->hash_fd, path, sizeof (path));
+
+  return hc_arena_strdup (arena, path);
+
+}
+
+/* A dictionary argument, the path as set or the path of the in-memory wordlist */
+
+static char *hashcat_arena_dict (PyObject * dict, const int fd, hc_arena_t * arena)
+{
+
+  if (fd == -1)
+    return hc_arena_strdup (arena, PyString_AsString (dict));
+
+  char path[32];
+
+  hc_memfd_path (fd, path, sizeof (path));
+
+  return hc_arena_strdup (arena, path);
+
+}
+
+static int hashcat_dict1_streamed (hashcatObject * self)
+{
+
+  return (self->dict1 != NULL) && (self->dict1_fd == -1) && (!PyString_Check (self->dict1));
+
+}
+
+/* Hand compressed wordlists to hashcat decompressed: a gzip dict1 of a straight attack is streamed to
+   stdin, any other gzip wordlist argument is replaced by a memfd. hashcat opens those more than once,
+   they cannot be streamed, so ones that decompress to more than HC_GZ_MEMFD_MAX are refused rather than
+   held in RAM. Return -1 with a python error set */
+
+static int hashcat_dicts_decompress (hashcatObject * self, char **hc_argv)
+{
+
+  int args[2] = { -1, -1 };
+
+  switch (self->user_options->attack_mode)
+  {
+    case 0: args[0] = 1;              break;
+    case 1: args[0] = 1; args[1] = 2; break;
+    case 6: args[0] = 1;              break;
+    case 7: args[0] = 2;              break;
+  }
+
+  // wordlists are checked when set, hc_argv[1] is just the first of them
+  if ((self->user_options->attack_mode == 0) && (self->wordlists != NULL))
+    args[0] = -1;
+
+  const int threads = hc_threads_default (0);
+
+  cpu_set_t cpus;
+
+  const int pinned = hashcat_placement (self, &cpus);
+
+  if (pinned == -1)
+    return -1;
+
+  for (int i = 0; i < 2; i++)
+  {
+
+    if ((args[i] == -1) || (hc_argv[args[i]] == NULL))
+      continue;
+
+    const char *path = hc_argv[args[i]];
+
+    const int kind = hashcat_wordlist_open (path, 0, NULL, NULL);
+
+    if (kind == -1)
+      return -1;
+
+    if (kind == HC_GZ_NONE)
+      continue;
+
+    if (self->user_options->attack_mode == 0)
+    {
+
+      // In stdin mode hashcat knows no keyspace and has no position to skip to
+      if ((self->user_options->skip > 0) || (self->user_options->limit > 0) || (self->user_options->keyspace))
+      {
+        PyErr_Format (PyExc_ValueError, "%s is gzip compressed, skip, limit and keyspace need it decompressed first", path);
+        return -1;
+      }
+
+      hc_gz_t *gz = (hc_gz_t *) calloc (1, sizeof (hc_gz_t));
+
+      if (gz == NULL)
+      {
+        PyErr_NoMemory ();
+        return -1;
+      }
+
+      if (hc_gz_open (path, threads, (pinned) ? &cpus : NULL, gz) == -1)
+      {
+        PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+
+        hc_gz_close (gz);
+        free (gz);
+        return -1;
+      }
+
+      self->dict1_gz = gz;
+
+      // stdin mode, the stream thread takes the decoder over
+      self->hc_argc = 1;
+      self->user_options->hc_argc = 1;
+
+      hc_argv[1] = NULL;
+
+      continue;
+    }
+
+    int fd;
+
+    Py_BEGIN_ALLOW_THREADS
+
+    fd = hc_gz_to_memfd (path, threads, (pinned) ? &cpus : NULL, HC_GZ_MEMFD_MAX);
+
+    Py_END_ALLOW_THREADS
+
+    if ((fd == -1) && (errno == EFBIG))
+    {
+      PyErr_Format (PyExc_ValueError, "%s decompresses to more than %d MiB, the most held in memory for combinator and hybrid attacks, decompress it to disk first", path, (int) (HC_GZ_MEMFD_MAX / (1024 * 1024)));
+      return -1;
+    }
+
+    if (fd == -1)
+    {
+      PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+      return -1;
+    }
+
+    self->dict_gz_fd[i] = fd;
+
+    hc_argv[args[i]] = hashcat_arena_dict (NULL, fd, &self->arena);
+
+    if (hc_argv[args[i]] == NULL)
+    {
+      PyErr_NoMemory ();
+      return -1;
+    }
+  }
+
+  return 0;
+
+}
+
+static PyObject *hashcat_hashcat_session_execute (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  char *py_path = "/usr/bin";
+  char *hc_path = "/usr/local/share/hashcat";
+  static char *kwlist[] = {"py_path", "hc_path", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ss", kwlist, &py_path, &hc_path)) 
+  {
+    return NULL;
+  }
+
+  // Only one job per object, the previous job's strings stay in use until its thread is done
+  if (self->thread_started)
+  {
+
+    if (pthread_equal (pthread_self (), self->hThread))
+    {
+      PyErr_SetString (PyExc_RuntimeError, "Cannot execute from the session thread");
+      return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+
+    pthread_join (self->hThread, NULL);
+
+    Py_END_ALLOW_THREADS
+
+    self->thread_started = 0;
+  }
+
+  // A job run without a reset in between starts from the options as set, not as the last session left them
+  if (self->options_job_saved)
+    *self->user_options = self->options_job;
+
+  if ((self->pot_sink != NULL) && (!self->user_options->benchmark))
+  {
+
+    const user_options_t *user_options = self->user_options;
+
+    // The sink appends the crack lines hashcat reports, they are hash:plain potfile records only in the default format
+    if ((user_options->username) || (user_options->outfile_format != OUTFILE_FORMAT) || (user_options->outfile_autohex != OUTFILE_AUTOHEX))
+    {
+      PyErr_SetString (PyExc_ValueError, "The potfile sink needs username off and outfile_format and outfile_autohex at their defaults");
+      return NULL;
+    }
+
+    const int potfile_disable = (self->potfile_disable_saved != -1) ? self->potfile_disable_saved : user_options->potfile_disable;
+
+    if ((!potfile_disable) && (PyErr_WarnEx (PyExc_RuntimeWarning, "The potfile sink is open, hashcat runs with potfile_disable and does not skip hashes already in the potfile, use filter_uncracked", 1) == -1))
+      return NULL;
+  }
+
+  // Everything handed to libhashcat for this job is copied into the job arena
+  hc_arena_t job_arena = { NULL, 0 };
+
+  // Build argv
+  size_t hc_argv_size = 1;
+  char **hc_argv = NULL;
+
+  // Benchmark is a special case
+  if (self->user_options->benchmark){
+
+    self->hc_argc = 1;
+    hc_argv_size = self->hc_argc + 1;
+    hc_argv = (char **) hc_arena_alloc (&job_arena, sizeof (char *) * (hc_argv_size));
+
+    if (hc_argv != NULL)
+      hc_argv[0] = NULL;
+
+  // Every other case need a hash source set otherwise fail
+  } else if (self->hash == NULL) {
+
+    PyErr_SetString (PyExc_RuntimeError, "Hash source not set");
+    Py_INCREF (Py_None);
+    return Py_None;
+
+  } else if ((hashcat_dict1_streamed (self)) && (self->user_options->attack_mode != 0)) {
+
+    PyErr_SetString (PyExc_RuntimeError, "A streamed dict1 is only supported by straight attacks");
+    return NULL;
+
+  } else if (hc_rank_spent (self->dict1)) {
+
+    PyErr_SetString (PyExc_ValueError, "dict1 is a ranked_merge stream an earlier session consumed, call ranked_merge again");
+    return NULL;
+
+  } else {
+
+    switch (self->user_options->attack_mode)
+    {
+  
+  
+    // 0 | Straight
+    case 0:
+  
+      if ((self->dict1 == NULL) && (self->wordlists == NULL))
+      {
+  
+        PyErr_SetString (PyExc_RuntimeError, "Undefined dictionary");
+        Py_INCREF (Py_None);
+        return Py_None;
+      }
+  
+      self->hc_argc = (self->wordlists != NULL) ? 1 + PyTuple_GET_SIZE (self->wordlists) : 2;
+      hc_argv_size = self->hc_argc + 1;
+      hc_argv = (char **) hc_arena_alloc (&job_arena, sizeof (char *) * (hc_argv_size));
+
+      if (hc_argv == NULL)
+        break;
+
+      hc_argv[0] = hashcat_arena_hash (self, &job_arena);
+      hc_argv[self->hc_argc] = NULL;
+
+      // A streamed dict1 leaves the wordlist out, hashcat reads candidates from stdin
+      if (self->wordlists != NULL)
+      {
+        for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE (self->wordlists); i++)
+          hc_argv[1 + i] = hc_arena_strdup (&job_arena, PyString_AS_STRING (PyTuple_GET_ITEM (self->wordlists, i)));
+      }
+      else if (!hashcat_dict1_streamed (self))
+      {
+        hc_argv[1] = hashcat_arena_dict (self->dict1, self->dict1_fd, &job_arena);
+      }
+      else
+      {
+        self->hc_argc = 1;
+
+        hc_argv[1] = NULL;
+      }
+  
+      // Set the rules files (rp_files), the array itself belongs to libhashcat and is released by user_options_destroy
+      const Py_ssize_t rp_files_cnt = PyList_Size (self->rp_files);
+
+      char **rp_files = (char **) hccalloc (rp_files_cnt + 1, sizeof (char *));
+
+      if (rp_files == NULL)
+      {
+        hc_arena_free (&job_arena);
+
+        return PyErr_NoMemory ();
+      }
+
+      for (Py_ssize_t i = 0; i < rp_files_cnt; i++)
+      {
+
+        PyObject *rp_file = PyList_GetItem (self->rp_files, i);
+
+        if (!PyString_Check (rp_file))
+        {
+
+          hcfree (rp_files);
+          hc_arena_free (&job_arena);
+
+          PyErr_SetString (PyExc_TypeError, "Rules must be strings");
+          return NULL;
+        }
+
+        rp_files[i] = hc_arena_strdup (&job_arena, PyString_AsString (rp_file));
+      }
+
+      hcfree (self->user_options->rp_files);
+
+      self->user_options->rp_files = rp_files;
+      self->user_options->rp_files_cnt = rp_files_cnt;
+  
+      break;
+  
+      // 1 | Combination
+    case 1:
+  
+      if ((self->dict1 == NULL) || (self->dict2 == NULL))
+      {
+  
+        PyErr_SetString (PyExc_RuntimeError, "Undefined dictionary");
+        Py_INCREF (Py_None);
+        return Py_None;
+      }
+  
+      self->hc_argc = 3;
+      hc_argv_size = self->hc_argc + 1;
+      hc_argv = (char **) hc_arena_alloc (&job_arena, sizeof (char *) * (hc_argv_size));
+
+      if (hc_argv == NULL)
+        break;
+
+      hc_argv[0] = hashcat_arena_hash (self, &job_arena);
+      hc_argv[1] = hashcat_arena_dict (self->dict1, self->dict1_fd, &job_arena);
+      hc_argv[2] = hashcat_arena_dict (self->dict2, self->dict2_fd, &job_arena);
+      hc_argv[3] = NULL;
+  
+      break;
+  
+      // 3 | Bruteforce (mask)
+    case 3:
+  
+      if (self->mask == NULL)
+      {
+  
+        PyErr_SetString (PyExc_RuntimeError, "Undefined mask");
+        Py_INCREF (Py_None);
+        return Py_None;
+      }
+  
+      self->hc_argc = 2;
+      hc_argv_size = self->hc_argc + 1;
+      hc_argv = (char **) hc_arena_alloc (&job_arena, sizeof (char *) * (hc_argv_size));
+
+      if (hc_argv == NULL)
+        break;
+
+      hc_argv[0] = hashcat_arena_hash (self, &job_arena);
+      hc_argv[1] = hc_arena_strdup (&job_arena, PyString_AsString (self->mask));
+      hc_argv[2] = NULL;
+  
+      break;
+  
+      // 6 | Hybrid dict mask
+    case 6:
+  
+      if (self->dict1 == NULL)
+      {
+  
+        PyErr_SetString (PyExc_RuntimeError, "Undefined dictionary");
+        Py_INCREF (Py_None);
+        return Py_None;
+      }
+  
+      if (self->mask == NULL)
+      {
+  
+        PyErr_SetString (PyExc_RuntimeError, "Undefined mask");
+        Py_INCREF (Py_None);
+        return Py_None;
+      }
+  
+      self->hc_argc = 3;
+      hc_argv_size = self->hc_argc + 1;
+      hc_argv = (char **) hc_arena_alloc (&job_arena, sizeof (char *) * (hc_argv_size));
+
+      if (hc_argv == NULL)
+        break;
+
+      hc_argv[0] = hashcat_arena_hash (self, &job_arena);
+      hc_argv[1] = hashcat_arena_dict (self->dict1, self->dict1_fd, &job_arena);
+      hc_argv[2] = hc_arena_strdup (&job_arena, PyString_AsString (self->mask));
+      hc_argv[3] = NULL;
+  
+      break;
+  
+      // 7 | Hybrid mask dict
+    case 7:
+  
+      if (self->dict1 == NULL)
+      {
+  
+        PyErr_SetString (PyExc_RuntimeError, "Undefined dictionary");
+        Py_INCREF (Py_None);
+        return Py_None;
+      }
+  
+      if (self->mask == NULL)
+      {
+  
+        PyErr_SetString (PyExc_RuntimeError, "Undefined mask");
+        Py_INCREF (Py_None);
+        return Py_None;
+      }
+  
+      self->hc_argc = 3;
+      hc_argv_size = self->hc_argc + 1;
+      hc_argv = (char **) hc_arena_alloc (&job_arena, sizeof (char *) * (hc_argv_size));
+
+      if (hc_argv == NULL)
+        break;
+
+      hc_argv[0] = hashcat_arena_hash (self, &job_arena);
+      hc_argv[1] = hc_arena_strdup (&job_arena, PyString_AsString (self->mask));
+      hc_argv[2] = hashcat_arena_dict (self->dict1, self->dict1_fd, &job_arena);
+      hc_argv[3] = NULL;
+  
+      break;
+  
+    default:
+  
+      PyErr_SetString (PyExc_NotImplementedError, "Invalid Attack Mode");
+      Py_INCREF (Py_None);
+      return Py_None;
+  
+  
+    }
+
+
+  }
+
+  // Options may still point into the previous job's arena, copy them before releasing it. On failure
+  // they keep pointing into the previous arena, which stays
+  if ((hc_argv == NULL) || (job_arena.failed) || (hashcat_arena_options (self, &job_arena) == -1))
+  {
+
+    hc_arena_free (&job_arena);
+
+    return PyErr_NoMemory ();
+  }
+
+  hc_arena_free (&self->arena);
+
+  self->arena = job_arena;
+
+  self->user_options->hc_argc = self->hc_argc;
+  self->user_options->hc_argv = hc_argv;
+
+  // reset(keep_options=True) goes back to these rather than to what the session makes of them
+  self->options_job = *self->user_options;
+  self->options_job_saved = 1;
+
+  if (self->potfile_disable_saved != -1)
+    self->options_job.potfile_disable = self->potfile_disable_saved;
+
+  // The potfile sink writes cracks in its place, hashcat's own appends would write them twice
+  if (self->pot_sink != NULL)
+  {
+    if (self->potfile_disable_saved == -1)
+      self->potfile_disable_saved = self->user_options->potfile_disable;
+
+    self->user_options->potfile_disable = 1;
+  }
+  else if (self->pot_sink == NULL)
+  {
+    hashcat_potfile_disable_restore (self);
+  }
+
+
+  // Resolve thread placement before the session allocates devices
+  cpu_set_t cpus;
+
+  const int pinned = hashcat_placement (self, &cpus);
+
+  if (pinned == -1)
+    return NULL;
+
+  if (hashcat_dicts_decompress (self, hc_argv) == -1)
+  {
+    hashcat_dicts_release (self);
+    return NULL;
+  }
+
+  // An indexed dict1 is handed over from the indexed line at or before skip
+  const int slice_fd = (self->dict1_gz == NULL) ? hashcat_dict1_slice (self) : -1;
+
+  if (slice_fd == -2)
+  {
+    hashcat_dicts_release (self);
+    return NULL;
+  }
+
+  if (slice_fd >= 0)
+  {
+
+    hc_argv[1] = hashcat_arena_dict (NULL, slice_fd, &self->arena);
+
+    if (hc_argv[1] == NULL)
+    {
+      hashcat_dict1_unslice (self);
+      hashcat_dicts_release (self);
+      return PyErr_NoMemory ();
+    }
+  }
+
+  /**  
+   *   !! IMPORTANT !!
+   *   Getting the args to hashcat_session_init correct is critical. 
+   *   The first parameter is where Python is installed and
+   *   the second is where you installed all the hashcat files.
+   * 
+   * */
+  self->rc_init = hashcat_session_init (self->hashcat_ctx, py_path, hc_path, 0, NULL, 0);
+
+  if (self->rc_init != 0)
+  {
+
+    hashcat_dict1_unslice (self);
+    hashcat_dicts_release (self);
+
+    char *msg = hashcat_get_log (self->hashcat_ctx);
+
+    PyErr_SetString (PyExc_RuntimeError, msg);
+
+    Py_INCREF (Py_None);
+    return Py_None;
+
+  }
+
+  if ((self->user_options->attack_mode == 0) && ((hashcat_dict1_streamed (self)) || (self->dict1_gz != NULL)) && (hc_stream_start (self, (pinned) ? &cpus : NULL) == -1))
+  {
+    hashcat_dicts_release (self);
+    return NULL;
+  }
+
+  hc_prefetch_start (self, (pinned) ? &cpus : NULL);
+
+  self->cancel_request_time = 0;
+  self->cancel_stop_time = 0;
+  self->session_exit_time = 0;
+
+  int rtn;
+  
+  Py_BEGIN_ALLOW_THREADS
+
+  rtn = hc_thread_create (&self->hThread, (pinned) ? &cpus : NULL, 0, hc_session_exe_thread, self);
+
+  Py_END_ALLOW_THREADS
+
+  if (rtn == 0)
+  {
+    self->thread_started = 1;
+  }
+  else
+  {
+    hashcat_job_release (self);
+  }
+
+  return Py_BuildValue ("i", rtn);
+}
+
+
+static int hashcat_sethash (hashcatObject * self, PyObject * value, void *closure);
+
+PyDoc_STRVAR(hashcat_session_execute_batch__doc__,
+"hashcat_session_execute_batch(jobs, py_path=\"/usr/bin\", hc_path=\"/usr/local/share/hashcat\") -> list\n\n\
+Run one session per job, one after the other, in this object's context.\n\n\
+jobs\tdict|list\thash_mode -> hash source, as returned by partition_hashes, or a list of (hash_mode, hash) pairs\n\n\
+Every other option (attack_mode, dict1, dict2, mask, rules, ...) is shared by all\n\
+jobs. Between jobs the object is reset with keep_options=True and keep_backend=True,\n\
+so the context stays warm. Blocks until the last job is done; events fire as usual.\n\n\
+Return a list of (hash_mode, rc) with the exit code of each session");
+
+static PyObject *hashcat_hashcat_session_execute_batch (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *jobs;
+  char *py_path = "/usr/bin";
+  char *hc_path = "/usr/local/share/hashcat";
+  static char *kwlist[] = {"jobs", "py_path", "hc_path", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ss", kwlist, &jobs, &py_path, &hc_path)) 
+  {
+    return NULL;
+  }
+
+  PyObject *items = NULL;
+
+  if (PyDict_Check (jobs))
+  {
+    items = PyDict_Items (jobs);
+
+    if ((items != NULL) && (PyList_Sort (items) == -1))
+      Py_CLEAR (items);
+  }
+  else
+  {
+    items = PySequence_List (jobs);
+  }
+
+  if (items == NULL)
+    return NULL;
+
+  // The shared options, a reset drops them along with the hash
+  PyObject *dict1 = self->dict1;
+  PyObject *dict2 = self->dict2;
+  PyObject *mask  = self->mask;
+  PyObject *rules = PySequence_List (self->rp_files);
+
+  PyObject *wordlists = self->wordlists;
+
+  Py_XINCREF (dict1);
+  Py_XINCREF (dict2);
+  Py_XINCREF (mask);
+  Py_XINCREF (wordlists);
+
+  // In-memory wordlists are kept by duplicating their sealed files, not copied again per job
+  int dict1_fd = (self->dict1_fd == -1) ? -1 : fcntl (self->dict1_fd, F_DUPFD_CLOEXEC, 3);
+  int dict2_fd = (self->dict2_fd == -1) ? -1 : fcntl (self->dict2_fd, F_DUPFD_CLOEXEC, 3);
+
+  PyObject *exec_args  = Py_BuildValue ("(ss)", py_path, hc_path);
+  PyObject *reset_args = Py_BuildValue ("(ii)", 1, 1);
+  PyObject *results    = PyList_New (0);
+
+  int failed = ((rules == NULL) || (exec_args == NULL) || (reset_args == NULL) || (results == NULL));
+
+  for (Py_ssize_t i = 0; (i < PyList_GET_SIZE (items)) && (!failed); i++)
+  {
+
+    unsigned int hash_mode;
+    PyObject *hash;
+
+    if (!PyArg_ParseTuple (PyList_GET_ITEM (items, i), "IO;jobs must map hash_mode to a hash source", &hash_mode, &hash))
+    {
+      failed = 1;
+      break;
+    }
+
+    if (i > 0)
+    {
+
+      PyObject *r = hashcat_reset (self, reset_args, NULL);
+
+      if (r == NULL)
+      {
+        failed = 1;
+        break;
+      }
+
+      Py_DECREF (r);
+
+      Py_XINCREF (dict1); self->dict1 = dict1;
+      Py_XINCREF (dict2); self->dict2 = dict2;
+      Py_XINCREF (mask);  self->mask  = mask;
+
+      Py_XINCREF (wordlists); self->wordlists = wordlists;
+
+      self->dict1_fd = (dict1_fd == -1) ? -1 : fcntl (dict1_fd, F_DUPFD_CLOEXEC, 3);
+      self->dict2_fd = (dict2_fd == -1) ? -1 : fcntl (dict2_fd, F_DUPFD_CLOEXEC, 3);
+
+      if (PyList_SetSlice (self->rp_files, 0, 0, rules) == -1)
+      {
+        failed = 1;
+        break;
+      }
+    }
+
+    self->user_options->hash_mode = hash_mode;
+
+    if (hashcat_sethash (self, hash, NULL) == -1)
+    {
+      failed = 1;
+      break;
+    }
+
+    PyObject *r = hashcat_hashcat_session_execute (self, exec_args, NULL);
+
+    // execute reports some failures as None with an exception set
+    if ((r == NULL) || (PyErr_Occurred ()))
+    {
+      Py_XDECREF (r);
+      failed = 1;
+      break;
+    }
+
+    Py_DECREF (r);
+
+    if (!self->thread_started)
+    {
+      PyErr_Format (PyExc_RuntimeError, "Failed to start the session for hash_mode %u", hash_mode);
+      failed = 1;
+      break;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+
+    pthread_join (self->hThread, NULL);
+
+    Py_END_ALLOW_THREADS
+
+    self->thread_started = 0;
+
+    PyObject *result = Py_BuildValue ("(Ii)", hash_mode, self->session_rc);
+
+    if ((result == NULL) || (PyList_Append (results, result) == -1))
+      failed = 1;
+
+    Py_XDECREF (result);
+  }
+
+  Py_XDECREF (dict1);
+  Py_XDECREF (dict2);
+  Py_XDECREF (mask);
+  Py_XDECREF (rules);
+  Py_XDECREF (wordlists);
+
+  hc_fd_close (&dict1_fd);
+  hc_fd_close (&dict2_fd);
+  Py_XDECREF (exec_args);
+  Py_XDECREF (reset_args);
+  Py_DECREF (items);
+
+  if (failed)
+  {
+    if (!PyErr_Occurred ())
+      PyErr_NoMemory ();
+
+    Py_XDECREF (results);
+    return NULL;
+  }
+
+  return results;
+
+}
+
+PyDoc_STRVAR(hashcat_session_pause__doc__,
+"hashcat_session_pause -> int\n\n\
 Pause hashcat cracking session.\n\n\
 Return 0 on success, -1 on error");
 
-static PyObject *hashcat_hashcat_session_pause (hashcatObject * self, PyObject * noargs)
+static PyObject *hashcat_hashcat_session_pause (hashcatObject * self, PyObject * noargs)
+{
+
+  int rtn;
+
+  rtn = hashcat_session_pause (self->hashcat_ctx);
+  return Py_BuildValue ("i", rtn);
+}
+
+PyDoc_STRVAR(hashcat_session_resume__doc__,
+"hashcat_session_resume -> int\n\n\
+Resume hashcat cracking session.\n\n\
+Return 0 on success, -1 on error");
+
+static PyObject *hashcat_hashcat_session_resume (hashcatObject * self, PyObject * noargs)
+{
+
+  int rtn;
+
+  rtn = hashcat_session_resume (self->hashcat_ctx);
+  return Py_BuildValue ("i", rtn);
+}
+
+PyDoc_STRVAR(hashcat_session_bypass__doc__,
+"hashcat_session_bypass -> int\n\n\
+Bypass current attack and go to next. Only applicable when using multiple wordlists or masks\n\n\
+Return 0 on success, -1 on error");
+
+static PyObject *hashcat_hashcat_session_bypass (hashcatObject * self, PyObject * noargs)
+{
+
+  int rtn;
+
+  rtn = hashcat_session_bypass (self->hashcat_ctx);
+  return Py_BuildValue ("i", rtn);
+}
+
+PyDoc_STRVAR(hashcat_session_checkpoint__doc__,
+"hashcat_session_checkpoint -> int\n\n\
+Stop at next restore point. This feature is disabled when restore_disabled is specified, and will return error\n\n\
+Return 0 on success, -1 on error");
+
+static PyObject *hashcat_hashcat_session_checkpoint (hashcatObject * self, PyObject * noargs)
+{
+
+  int rtn;
+
+  rtn = hashcat_session_checkpoint (self->hashcat_ctx);
+  return Py_BuildValue ("i", rtn);
+}
+
+PyDoc_STRVAR(hashcat_session_quit__doc__,
+"hashcat_session_quit -> int\n\n\
+Quit hashcat session.\n\n\
+Return 0 on success");
+
+static PyObject *hashcat_hashcat_session_quit (hashcatObject * self, PyObject * noargs)
+{
+
+  int rtn;
+
+  rtn = hashcat_session_quit (self->hashcat_ctx);
+  return Py_BuildValue ("i", rtn);
+}
+
+PyDoc_STRVAR(status_get_cancel_latency__doc__,
+"status_get_cancel_latency -> float|None\n\n\
+Return seconds between the last hashcat_session_cancel request and the final\n\
+EVENT_CRACKER_FINISHED/EVENT_OUTERLOOP_FINISHED, or session thread exit if no finish\n\
+event followed the request. None if no cancel was requested or the session is still stopping.\n\n");
+
+static PyObject *hashcat_status_get_cancel_latency (hashcatObject * self, PyObject * noargs)
+{
+
+  const double requested = self->cancel_request_time;
+
+  if (requested == 0)
+  {
+    Py_INCREF (Py_None);
+    return Py_None;
+  }
+
+  double stopped = self->cancel_stop_time;
+
+  if (stopped == 0)
+    stopped = self->session_exit_time;
+
+  if ((stopped == 0) || (stopped < requested))
+  {
+    Py_INCREF (Py_None);
+    return Py_None;
+  }
+
+  return Py_BuildValue ("d", stopped - requested);
+
+}
+
+PyDoc_STRVAR(hashcat_session_cancel__doc__,
+"hashcat_session_cancel(checkpoint=False, wait=True) -> float|None\n\n\
+Cancel the running session and measure how long it takes to stop.\n\n\
+checkpoint\tbool\tStop at the next restore point instead of the next kernel boundary\n\
+wait\t\tbool\tBlock until the session thread has exited\n\n\
+Return the stop latency in seconds when wait is True, None otherwise.\n\
+Use status_get_cancel_latency to poll a cancel issued with wait=False.\n\n");
+
+static PyObject *hashcat_hashcat_session_cancel (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  int checkpoint = 0;
+  int wait = 1;
+  static char *kwlist[] = {"checkpoint", "wait", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ii", kwlist, &checkpoint, &wait)) 
+  {
+    return NULL;
+  }
+
+  if (!self->thread_started)
+  {
+    PyErr_SetString (PyExc_RuntimeError, "No session running");
+    return NULL;
+  }
+
+  self->cancel_stop_time = 0;
+  self->cancel_request_time = hc_time_now ();
+
+  int rtn;
+
+  // quit clears the thread run levels, the device loops leave after the current kernel returns
+  if (checkpoint)
+    rtn = hashcat_session_checkpoint (self->hashcat_ctx);
+  else
+    rtn = hashcat_session_quit (self->hashcat_ctx);
+
+  if (rtn != 0)
+  {
+    self->cancel_request_time = 0;
+
+    PyErr_SetString (PyExc_RuntimeError, checkpoint ? "Checkpoint stop not available (restore disabled?)" : "Session could not be quit");
+    return NULL;
+  }
+
+  if (!wait)
+  {
+    Py_INCREF (Py_None);
+    return Py_None;
+  }
+
+  if (pthread_equal (pthread_self (), self->hThread))
+  {
+    PyErr_SetString (PyExc_RuntimeError, "Cannot wait for cancel from the session thread");
+    return NULL;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+
+  pthread_join (self->hThread, NULL);
+
+  Py_END_ALLOW_THREADS
+
+  self->thread_started = 0;
+
+  return hashcat_status_get_cancel_latency (self, NULL);
+
+}
+
+/* Line oriented inputs for the tool functions. A path is mapped in place, any other hash source (list,
+   buffer, string with newlines) is copied to a memfd first and mapped from there */
+
+typedef struct hc_source_map
+{
+
+  const char *buf;
+  size_t len;
+
+  void *map_base;
+  size_t map_len;
+
+} hc_source_map_t;
+
+static int hc_source_map_fd (int fd, hc_source_map_t * map)
+{
+
+  struct stat st;
+
+  if (fstat (fd, &st) == -1)
+    return -1;
+
+  map->buf = NULL;
+  map->len = st.st_size;
+
+  map->map_base = NULL;
+  map->map_len  = 0;
+
+  if (map->len == 0)
+    return 0;
+
+  void *addr = mmap (NULL, map->len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (addr == MAP_FAILED)
+    return -1;
+
+  madvise (addr, map->len, MADV_SEQUENTIAL);
+
+  map->buf = (const char *) addr;
+
+  map->map_base = addr;
+  map->map_len  = map->len;
+
+  return 0;
+
+}
+
+static int hc_source_map_open (PyObject * source, hc_source_map_t * map)
+{
+
+  int fd;
+
+  if (PyString_Check (source) && (memchr (PyString_AS_STRING (source), '\n', PyString_GET_SIZE (source)) == NULL))
+  {
+
+    fd = open (PyString_AS_STRING (source), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1)
+    {
+      PyErr_SetFromErrnoWithFilename (PyExc_IOError, PyString_AS_STRING (source));
+      return -1;
+    }
+
+  }
+  else if (PyString_Check (source) || PyList_Check (source) || PyTuple_Check (source) || PyObject_CheckBuffer (source) || PyObject_CheckReadBuffer (source))
+  {
+
+    fd = hc_memfd_from_object ("pyhashcat-source", source);
+
+    if (fd == -1)
+      return -1;
+
+  }
+  else
+  {
+
+    PyErr_SetString (PyExc_TypeError, "source must be a path, a list of strings or a buffer");
+    return -1;
+  }
+
+  const int rc = hc_source_map_fd (fd, map);
+
+  // The mapping keeps the file alive
+  close (fd);
+
+  if (rc == -1)
+  {
+    PyErr_SetFromErrno (PyExc_OSError);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static void hc_source_map_close (hc_source_map_t * map)
+{
+
+  if (map->map_base != NULL)
+    munmap (map->map_base, map->map_len);
+
+  map->buf = NULL;
+  map->len = 0;
+
+  map->map_base = NULL;
+  map->map_len  = 0;
+
+}
+
+/* Split buf into n chunks that start at line boundaries. offsets has n + 1 entries */
+
+static void hc_split_lines (const char *buf, size_t len, int n, size_t * offsets)
+{
+
+  offsets[0] = 0;
+  offsets[n] = len;
+
+  for (int i = 1; i < n; i++)
+  {
+
+    size_t pos = (size_t) ((double) len * i / n);
+
+    if (pos < offsets[i - 1])
+      pos = offsets[i - 1];
+
+    const char *nl = (pos < len) ? (const char *) memchr (buf + pos, '\n', len - pos) : NULL;
+
+    offsets[i] = (nl == NULL) ? len : (size_t) (nl - buf) + 1;
+  }
+
+}
+
+/* Next line in [pos, end). Strips the newline and a trailing carriage return like hashcat's fgetl */
+
+static const char *hc_next_line (const char *pos, const char *end, size_t * line_len)
+{
+
+  const char *nl = (const char *) memchr (pos, '\n', end - pos);
+
+  const char *line_end = (nl == NULL) ? end : nl;
+
+  *line_len = line_end - pos;
+
+  if ((*line_len > 0) && (pos[*line_len - 1] == '\r'))
+    (*line_len)--;
+
+  return (nl == NULL) ? end : nl + 1;
+
+}
+
+/* Line scans split every block of a wordlist at line ends over the scan threads. Threads for a scan of
+   size bytes: chunks of at least a MiB, the scans are memory bound */
+
+static int hc_line_threads (const size_t size, const int threads)
+{
+
+  return ((size_t) threads > size / (1024 * 1024) + 1) ? (int) (size / (1024 * 1024) + 1) : threads;
+
+}
+
+/* The head of every scan chunk, the scan state follows it */
+
+typedef struct hc_line_chunk
+{
+
+  const char *buf;
+  size_t len;
+
+} hc_line_chunk_t;
+
+/* Run fn over buf split at line ends into hc_line_threads chunks. chunks holds threads elements of
+   chunk_size bytes, only their hc_line_chunk_t head is set, and offsets threads + 1 entries. Return the
+   number of chunks run */
+
+static int hc_line_chunks_run (void *(*fn) (void *), const char *buf, const size_t len, void *chunks, const size_t chunk_size, const int threads, size_t * offsets, const cpu_set_t * cpus)
+{
+
+  const int n = hc_line_threads (len, threads);
+
+  hc_split_lines (buf, len, n, offsets);
+
+  for (int i = 0; i < n; i++)
+  {
+    hc_line_chunk_t *chunk = (hc_line_chunk_t *) ((char *) chunks + i * chunk_size);
+
+    chunk->buf = buf + offsets[i];
+    chunk->len = offsets[i + 1] - offsets[i];
+  }
+
+  hc_run_threads (fn, chunks, chunk_size, n, cpus);
+
+  return n;
+
+}
+
+/* A throwaway hashcat context with only the hashconfig of hash_mode set up, for parsing outside a session */
+
+static void event_null (const u32 id, hashcat_ctx_t * hashcat_ctx, const void *buf, const size_t len)
+{
+
+}
+
+static hashcat_ctx_t *hc_hashconfig_open_parse (const u32 hash_mode, const char separator, const int hex_salt)
+{
+
+  hashcat_ctx_t *hashcat_ctx = (hashcat_ctx_t *) malloc (sizeof (hashcat_ctx_t));
+
+  if (hashcat_ctx == NULL)
+  {
+    PyErr_NoMemory ();
+    return NULL;
+  }
+
+  if ((hashcat_init (hashcat_ctx, event_null) == -1) || (user_options_init (hashcat_ctx) == -1))
+  {
+    free (hashcat_ctx);
+
+    PyErr_SetString (PyExc_RuntimeError, "hashcat context init failed");
+    return NULL;
+  }
+
+  hashcat_ctx->user_options->hash_mode = hash_mode;
+  hashcat_ctx->user_options->separator = separator;
+  hashcat_ctx->user_options->hex_salt  = (hex_salt != 0);
+
+  if (hashconfig_init (hashcat_ctx) == -1)
+  {
+    user_options_destroy (hashcat_ctx);
+    hashcat_destroy (hashcat_ctx);
+    free (hashcat_ctx);
+
+    PyErr_Format (PyExc_ValueError, "Unknown hash_mode %u", hash_mode);
+    return NULL;
+  }
+
+  return hashcat_ctx;
+
+}
+
+static hashcat_ctx_t *hc_hashconfig_open (const u32 hash_mode)
+{
+
+  return hc_hashconfig_open_parse (hash_mode, ':', 0);
+
+}
+
+static void hc_hashconfig_close (hashcat_ctx_t * hashcat_ctx)
+{
+
+  hashconfig_destroy (hashcat_ctx);
+  user_options_destroy (hashcat_ctx);
+  hashcat_destroy (hashcat_ctx);
+
+  free (hashcat_ctx);
+
+}
+
+/* Scratch hash_t for one parser thread, sized for the hashconfig like hashes_init does */
+
+static int hc_hash_scratch_init (hash_t * hash, const hashconfig_t * hashconfig)
+{
+
+  memset (hash, 0, sizeof (hash_t));
+
+  hash->digest    = calloc (1, hashconfig->dgst_size);
+  hash->salt      = (salt_t *) calloc (1, sizeof (salt_t));
+  hash->esalt     = calloc (1, hashconfig->esalt_size ? hashconfig->esalt_size : 1);
+  hash->hook_salt = calloc (1, hashconfig->hook_salt_size ? hashconfig->hook_salt_size : 1);
+  hash->hash_info = (hashinfo_t *) calloc (1, sizeof (hashinfo_t));
+
+  if ((hash->digest == NULL) || (hash->salt == NULL) || (hash->esalt == NULL) || (hash->hook_salt == NULL) || (hash->hash_info == NULL))
+    return -1;
+
+  return 0;
+
+}
+
+static void hc_hash_scratch_reset (hash_t * hash, const hashconfig_t * hashconfig)
+{
+
+  memset (hash->digest, 0, hashconfig->dgst_size);
+  memset (hash->salt, 0, sizeof (salt_t));
+
+  if (hashconfig->esalt_size)     memset (hash->esalt, 0, hashconfig->esalt_size);
+  if (hashconfig->hook_salt_size) memset (hash->hook_salt, 0, hashconfig->hook_salt_size);
+
+}
+
+static void hc_hash_scratch_destroy (hash_t * hash)
+{
+
+  free (hash->digest);
+  free (hash->salt);
+  free (hash->esalt);
+  free (hash->hook_salt);
+  free (hash->hash_info);
+
+}
+
+/* Line level failures reported next to the parser's own PARSER_* codes */
+
+#define HC_PARSE_LINE_LENGTH  -1001
+#define HC_PARSE_NO_USERNAME  -1002
+
+static const char *hc_parse_strerror (const int rc)
+{
+
+  if (rc == HC_PARSE_LINE_LENGTH) return "Line-length exception";
+  if (rc == HC_PARSE_NO_USERNAME) return "Separator unmatched";
+
+  return strparser (rc);
+
+}
+
+/* Parse one hashlist line with the mode's parser. The parser may write to its input so it gets a copy */
+
+static int hc_parse_line (const hashconfig_t * hashconfig, hash_t * hash, char *line_buf, const char *line, size_t line_len, const int username)
+{
+
+  if (username)
+  {
+
+    const char *sep = (const char *) memchr (line, hashconfig->separator, line_len);
+
+    if (sep == NULL)
+      return HC_PARSE_NO_USERNAME;
+
+    line_len -= (sep + 1) - line;
+    line = sep + 1;
+  }
+
+  if (line_len >= HCBUFSIZ_LARGE)
+    return HC_PARSE_LINE_LENGTH;
+
+  memcpy (line_buf, line, line_len);
+
+  line_buf[line_len] = 0;
+
+  hc_hash_scratch_reset (hash, hashconfig);
+
+  return hashconfig->parse_func ((u8 *) line_buf, (u32) line_len, hash, hashconfig);
+
+}
+
+typedef struct hc_validate_chunk
+{
+
+  const char *buf;
+  size_t len;
+  const hashconfig_t *hashconfig;
+  int username;
+
+  u64 lines;
+  u64 valid;
+  u64 invalid;
+
+  // first err_max invalid lines, line numbers relative to the chunk
+  u64 *err_line;
+  int *err_rc;
+  size_t err_cnt;
+  size_t err_alloc;
+  size_t err_max;
+
+  int failed;
+
+} hc_validate_chunk_t;
+
+static void *hc_validate_thread (void *params)
+{
+
+  hc_validate_chunk_t *chunk = (hc_validate_chunk_t *) params;
+
+  const hashconfig_t *hashconfig = chunk->hashconfig;
+
+  hash_t hash;
+
+  char *line_buf = (char *) malloc (HCBUFSIZ_LARGE);
+
+  if ((hc_hash_scratch_init (&hash, hashconfig) == -1) || (line_buf == NULL))
+  {
+    chunk->failed = 1;
+    free (line_buf);
+    hc_hash_scratch_destroy (&hash);
+    return NULL;
+  }
+
+  const char *pos = chunk->buf;
+  const char *end = chunk->buf + chunk->len;
+
+  while (pos < end)
+  {
+
+    const char *line = pos;
+    size_t line_len;
+
+    pos = hc_next_line (pos, end, &line_len);
+
+    chunk->lines++;
+
+    // hashcat skips empty lines as well
+    if (line_len == 0)
+      continue;
+
+    const int rc = hc_parse_line (hashconfig, &hash, line_buf, line, line_len, chunk->username);
+
+    if (rc == PARSER_OK)
+    {
+      chunk->valid++;
+      continue;
+    }
+
+    chunk->invalid++;
+
+    if (chunk->err_cnt < chunk->err_max)
+    {
+
+      if (chunk->err_cnt == chunk->err_alloc)
+      {
+
+        const size_t err_alloc = (chunk->err_alloc == 0) ? 64 : chunk->err_alloc * 2;
+
+        u64 *err_line = (u64 *) realloc (chunk->err_line, err_alloc * sizeof (u64));
+
+        if (err_line != NULL)
+          chunk->err_line = err_line;
+
+        int *err_rc = (int *) realloc (chunk->err_rc, err_alloc * sizeof (int));
+
+        if (err_rc != NULL)
+          chunk->err_rc = err_rc;
+
+        if ((err_line == NULL) || (err_rc == NULL))
+        {
+          chunk->failed = 1;
+          break;
+        }
+
+        chunk->err_alloc = err_alloc;
+      }
+
+      chunk->err_line[chunk->err_cnt] = chunk->lines;
+      chunk->err_rc[chunk->err_cnt] = rc;
+      chunk->err_cnt++;
+    }
+  }
+
+  hc_hash_scratch_destroy (&hash);
+  free (line_buf);
+
+  return NULL;
+
+}
+
+PyDoc_STRVAR(validate_hashes__doc__,
+"validate_hashes(source, hash_mode, threads=0, username=False, max_errors=1000) -> (valid, invalid, errors)\n\n\
+Parse a hashlist with the parser of hash_mode without starting a session.\n\n\
+source\t\tstr|list|buffer\tHashlist path, or an in-memory hashlist as accepted by the hash attribute\n\
+hash_mode\tint\t\tHash mode used to parse every line\n\
+threads\t\tint\t\tParser threads, 0 uses every online CPU\n\
+username\tbool\t\tLines start with a username field\n\
+max_errors\tint\t\tMaximum number of invalid lines reported in errors\n\n\
+Return the number of valid and invalid lines and a list of (line_number, reason)\n\
+for the first max_errors invalid lines. Line numbers start at 1. Empty lines are skipped.\n\n");
+
+static PyObject *hashcat_validate_hashes (PyObject * cls, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *source;
+  unsigned int hash_mode;
+  int threads = 0;
+  int username = 0;
+  Py_ssize_t max_errors = 1000;
+  static char *kwlist[] = {"source", "hash_mode", "threads", "username", "max_errors", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OI|iin", kwlist, &source, &hash_mode, &threads, &username, &max_errors)) 
+  {
+    return NULL;
+  }
+
+  if (max_errors < 0)
+    max_errors = 0;
+
+  hashcat_ctx_t *hashcat_ctx = hc_hashconfig_open (hash_mode);
+
+  if (hashcat_ctx == NULL)
+    return NULL;
+
+  const hashconfig_t *hashconfig = hashcat_ctx->hashconfig;
+
+  if (hashconfig->opts_type & OPTS_TYPE_BINARY_HASHFILE)
+  {
+    hc_hashconfig_close (hashcat_ctx);
+
+    PyErr_Format (PyExc_ValueError, "hash_mode %u uses binary hash files and cannot be validated line by line", hash_mode);
+    return NULL;
+  }
+
+  hc_source_map_t map;
+
+  if (hc_source_map_open (source, &map) == -1)
+  {
+    hc_hashconfig_close (hashcat_ctx);
+    return NULL;
+  }
+
+  threads = hc_threads_default (threads);
+
+  // Small inputs are not worth a thread each
+  if ((size_t) threads > map.len / 4096 + 1)
+    threads = (int) (map.len / 4096 + 1);
+
+  size_t *offsets = (size_t *) calloc (threads + 1, sizeof (size_t));
+  hc_validate_chunk_t *chunks = (hc_validate_chunk_t *) calloc (threads, sizeof (hc_validate_chunk_t));
+
+  int failed = ((offsets == NULL) || (chunks == NULL));
+
+  if (!failed)
+  {
+
+    hc_split_lines (map.buf, map.len, threads, offsets);
+
+    for (int i = 0; i < threads; i++)
+    {
+      chunks[i].buf        = map.buf + offsets[i];
+      chunks[i].len        = offsets[i + 1] - offsets[i];
+      chunks[i].hashconfig = hashconfig;
+      chunks[i].username   = username;
+      chunks[i].err_max    = max_errors;
+    }
+  }
+
+  if (!failed)
+  {
+
+    Py_BEGIN_ALLOW_THREADS
+
+    hc_run_threads (hc_validate_thread, chunks, sizeof (hc_validate_chunk_t), threads, NULL);
+
+    Py_END_ALLOW_THREADS
+
+    for (int i = 0; i < threads; i++)
+      failed |= chunks[i].failed;
+  }
+
+  PyObject *rtn = NULL;
+
+  if (failed)
+  {
+
+    PyErr_NoMemory ();
+
+  }
+  else
+  {
+
+    u64 valid = 0;
+    u64 invalid = 0;
+    u64 line_base = 0;
+
+    PyObject *errors = PyList_New (0);
+
+    for (int i = 0; (i < threads) && (errors != NULL); i++)
+    {
+
+      valid   += chunks[i].valid;
+      invalid += chunks[i].invalid;
+
+      for (size_t j = 0; j < chunks[i].err_cnt; j++)
+      {
+
+        if (PyList_GET_SIZE (errors) >= max_errors)
+          break;
+
+        PyObject *err = Py_BuildValue ("(Ks)", line_base + chunks[i].err_line[j], hc_parse_strerror (chunks[i].err_rc[j]));
+
+        if ((err == NULL) || (PyList_Append (errors, err) == -1))
+        {
+          Py_XDECREF (err);
+          Py_CLEAR (errors);
+          break;
+        }
+
+        Py_DECREF (err);
+      }
+
+      line_base += chunks[i].lines;
+    }
+
+    if (errors != NULL)
+      rtn = Py_BuildValue ("(KKN)", valid, invalid, errors);
+  }
+
+  for (int i = 0; (chunks != NULL) && (i < threads); i++)
+  {
+    free (chunks[i].err_line);
+    free (chunks[i].err_rc);
+  }
+
+  free (offsets);
+  free (chunks);
+
+  hc_source_map_close (&map);
+  hc_hashconfig_close (hashcat_ctx);
+
+  return rtn;
+
+}
+
+/* 64 bit content hash. Inputs are hashed in fixed blocks so the result does not depend on the thread count */
+
+#define HC_HASH_BLOCK_SIZE (1024 * 1024)
+
+static u64 hc_hash64 (const void *data, size_t len, u64 seed)
+{
+
+  const u64 prime1 = 0x9e3779b185ebca87ULL;
+  const u64 prime2 = 0xc2b2ae3d27d4eb4fULL;
+
+  const u8 *p = (const u8 *) data;
+
+  u64 h = seed ^ (len * prime1);
+
+  while (len >= 8)
+  {
+    u64 w;
+
+    memcpy (&w, p, 8);
+
+    h ^= w * prime2;
+    h  = ((h << 31) | (h >> 33)) * prime1;
+
+    p   += 8;
+    len -= 8;
+  }
+
+  u64 tail = 0;
+
+  memcpy (&tail, p, len);
+
+  h ^= tail * prime2;
+
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  h *= prime1;
+  h ^= h >> 32;
+
+  return h;
+
+}
+
+typedef struct hc_hash_job
+{
+
+  const char *buf;
+  size_t len;
+  u64 *block_hashes;
+  size_t blocks;
+  size_t *next;
+
+} hc_hash_job_t;
+
+static void *hc_hash_thread (void *params)
+{
+
+  hc_hash_job_t *job = (hc_hash_job_t *) params;
+
+  for (;;)
+  {
+
+    const size_t block = __sync_fetch_and_add (job->next, 1);
+
+    if (block >= job->blocks)
+      break;
+
+    const size_t off = block * HC_HASH_BLOCK_SIZE;
+    const size_t len = (job->len - off < HC_HASH_BLOCK_SIZE) ? job->len - off : HC_HASH_BLOCK_SIZE;
+
+    job->block_hashes[block] = hc_hash64 (job->buf + off, len, block);
+  }
+
+  return NULL;
+
+}
+
+static u64 hc_content_hash (const char *buf, size_t len, int threads)
+{
+
+  const size_t blocks = (len + HC_HASH_BLOCK_SIZE - 1) / HC_HASH_BLOCK_SIZE;
+
+  u64 *block_hashes = (u64 *) calloc (blocks + 1, sizeof (u64));
+  hc_hash_job_t *jobs = (hc_hash_job_t *) calloc (threads, sizeof (hc_hash_job_t));
+
+  if ((block_hashes == NULL) || (jobs == NULL))
+  {
+    free (block_hashes);
+    free (jobs);
+
+    return hc_hash64 (buf, len, 0);
+  }
+
+  size_t next = 0;
+
+  for (int i = 0; i < threads; i++)
+  {
+    jobs[i].buf          = buf;
+    jobs[i].len          = len;
+    jobs[i].block_hashes = block_hashes;
+    jobs[i].blocks       = blocks;
+    jobs[i].next         = &next;
+  }
+
+  hc_run_threads (hc_hash_thread, jobs, sizeof (hc_hash_job_t), threads, NULL);
+
+  const u64 h = hc_hash64 (block_hashes, blocks * sizeof (u64), len);
+
+  free (jobs);
+  free (block_hashes);
+
+  return h;
+
+}
+
+/* Digest records for the presort stage: the sort key followed by the byte offset of its line. The key
+   is the decoded digest, preceded by a hash of the salt for salted modes and followed by a hash of the
+   esalt when the mode has one, so records of one salt sort next to each other. Records are ordered with
+   a parallel MSD pass on the first key byte and an LSD radix sort of the remaining bytes inside each
+   of the 256 buckets */
+
+#define HC_PRESORT_SALT_KEY_SIZE 8
+
+static size_t hc_presort_key_size (const hashconfig_t * hashconfig)
+{
+
+  size_t key_size = hashconfig->dgst_size;
+
+  if (hashconfig->is_salted)  key_size += HC_PRESORT_SALT_KEY_SIZE;
+  if (hashconfig->esalt_size) key_size += sizeof (u64);
+
+  return key_size;
+
+}
+
+/* Records are the key and the line offset, at most 256 bytes. Return 0 when the hashes of hash_mode
+   fit, -1 with a ValueError set */
+
+static int hc_presort_check (const hashconfig_t * hashconfig, const u32 hash_mode)
+{
+
+  const size_t rec_size = (hc_presort_key_size (hashconfig) + sizeof (u64) + 7) & ~(size_t) 7;
+
+  if ((hashconfig->dgst_size == 0) || (rec_size > 256))
+  {
+    PyErr_Format (PyExc_ValueError, "hash_mode %u has no digest that fits a sort record", hash_mode);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+typedef struct hc_presort_chunk
+{
+
+  const char *base;
+  const char *buf;
+  size_t len;
+  const hashconfig_t *hashconfig;
+  size_t key_size;
+  size_t rec_size;
+  int username;
+
+  u8 *recs;
+  size_t cnt;
+  size_t alloc;
+
+  u64 lines;
+  u64 invalid;
+
+  size_t hist[256];
+  size_t pos[256];
+  u8 *dst;
+
+  int failed;
+
+} hc_presort_chunk_t;
+
+static void *hc_presort_parse_thread (void *params)
+{
+
+  hc_presort_chunk_t *chunk = (hc_presort_chunk_t *) params;
+
+  const hashconfig_t *hashconfig = chunk->hashconfig;
+
+  hash_t hash;
+
+  char *line_buf = (char *) malloc (HCBUFSIZ_LARGE);
+
+  if ((hc_hash_scratch_init (&hash, hashconfig) == -1) || (line_buf == NULL))
+  {
+    chunk->failed = 1;
+    free (line_buf);
+    hc_hash_scratch_destroy (&hash);
+    return NULL;
+  }
+
+  const char *pos = chunk->buf;
+  const char *end = chunk->buf + chunk->len;
+
+  while (pos < end)
+  {
+
+    const char *line = pos;
+    size_t line_len;
+
+    pos = hc_next_line (pos, end, &line_len);
+
+    chunk->lines++;
+
+    if (line_len == 0)
+      continue;
+
+    if (hc_parse_line (hashconfig, &hash, line_buf, line, line_len, chunk->username) != PARSER_OK)
+    {
+      chunk->invalid++;
+      continue;
+    }
+
+    if (chunk->cnt == chunk->alloc)
+    {
+
+      const size_t alloc = (chunk->alloc == 0) ? 4096 : chunk->alloc * 2;
+
+      u8 *recs = (u8 *) realloc (chunk->recs, alloc * chunk->rec_size);
+
+      if (recs == NULL)
+      {
+        chunk->failed = 1;
+        break;
+      }
+
+      chunk->recs  = recs;
+      chunk->alloc = alloc;
+    }
+
+    u8 *rec = chunk->recs + chunk->cnt * chunk->rec_size;
+
+    const u64 off = line - chunk->base;
+
+    u8 *key = rec;
+
+    if (hashconfig->is_salted)
+    {
+      const u64 salt_key = hc_hash64 (hash.salt, sizeof (salt_t), 0);
+
+      memcpy (key, &salt_key, HC_PRESORT_SALT_KEY_SIZE);
+
+      key += HC_PRESORT_SALT_KEY_SIZE;
+    }
+
+    memcpy (key, hash.digest, hashconfig->dgst_size);
+
+    key += hashconfig->dgst_size;
+
+    if (hashconfig->esalt_size)
+    {
+      const u64 esalt_key = hc_hash64 (hash.esalt, hashconfig->esalt_size, 0);
+
+      memcpy (key, &esalt_key, sizeof (u64));
+    }
+
+    memcpy (rec + chunk->rec_size - sizeof (u64), &off, sizeof (u64));
+
+    chunk->hist[rec[0]]++;
+    chunk->cnt++;
+  }
+
+  hc_hash_scratch_destroy (&hash);
+  free (line_buf);
+
+  return NULL;
+
+}
+
+static void *hc_presort_scatter_thread (void *params)
+{
+
+  hc_presort_chunk_t *chunk = (hc_presort_chunk_t *) params;
+
+  for (size_t i = 0; i < chunk->cnt; i++)
+  {
+
+    const u8 *rec = chunk->recs + i * chunk->rec_size;
+
+    memcpy (chunk->dst + chunk->pos[rec[0]]++ * chunk->rec_size, rec, chunk->rec_size);
+  }
+
+  free (chunk->recs);
+
+  chunk->recs = NULL;
+
+  return NULL;
+
+}
+
+typedef struct hc_presort_buckets
+{
+
+  u8 *recs;
+  u8 *tmp;
+  size_t key_size;
+  size_t rec_size;
+  const size_t *bucket_start;
+  size_t *next;
+
+} hc_presort_buckets_t;
+
+static void hc_radix_sort_bucket (u8 *recs, u8 *tmp, size_t n, size_t key_size, size_t rec_size)
+{
+
+  // Small buckets are cheaper to insertion sort
+  if (n < 64)
+  {
+
+    u8 rec[256];
+
+    for (size_t i = 1; i < n; i++)
+    {
+
+      memcpy (rec, recs + i * rec_size, rec_size);
+
+      size_t j = i;
+
+      while ((j > 0) && (memcmp (recs + (j - 1) * rec_size, rec, key_size) > 0))
+      {
+        memcpy (recs + j * rec_size, recs + (j - 1) * rec_size, rec_size);
+        j--;
+      }
+
+      memcpy (recs + j * rec_size, rec, rec_size);
+    }
+
+    return;
+  }
+
+  u8 *src = recs;
+  u8 *dst = tmp;
+
+  for (size_t byte = key_size - 1; byte >= 1; byte--)
+  {
+
+    size_t cnt[256] = { 0 };
+
+    for (size_t i = 0; i < n; i++)
+      cnt[src[i * rec_size + byte]]++;
+
+    // Every record shares this byte, the pass would not move anything
+    if (cnt[src[byte]] == n)
+      continue;
+
+    size_t sum = 0;
+
+    for (int b = 0; b < 256; b++)
+    {
+      const size_t c = cnt[b];
+
+      cnt[b] = sum;
+      sum += c;
+    }
+
+    for (size_t i = 0; i < n; i++)
+      memcpy (dst + cnt[src[i * rec_size + byte]]++ * rec_size, src + i * rec_size, rec_size);
+
+    u8 *swap = src;
+
+    src = dst;
+    dst = swap;
+  }
+
+  if (src != recs)
+    memcpy (recs, src, n * rec_size);
+
+}
+
+static void *hc_presort_bucket_thread (void *params)
+{
+
+  hc_presort_buckets_t *job = (hc_presort_buckets_t *) params;
+
+  for (;;)
+  {
+
+    const size_t bucket = __sync_fetch_and_add (job->next, 1);
+
+    if (bucket >= 256)
+      break;
+
+    const size_t start = job->bucket_start[bucket];
+    const size_t n     = job->bucket_start[bucket + 1] - start;
+
+    hc_radix_sort_bucket (job->recs + start * job->rec_size, job->tmp + start * job->rec_size, n, job->key_size, job->rec_size);
+  }
+
+  return NULL;
+
+}
+
+/* Parse and sort the digests of a mapped hashlist. On success recs holds cnt sorted records of rec_size bytes */
+
+static int hc_presort_digests (const hc_source_map_t * map, const hashconfig_t * hashconfig, const int username, int threads, u8 **recs_out, size_t *cnt_out, size_t *rec_size_out, u64 *lines_out, u64 *invalid_out)
+{
+
+  const size_t key_size = hc_presort_key_size (hashconfig);
+  const size_t rec_size = (key_size + sizeof (u64) + 7) & ~(size_t) 7;
+
+  if ((hashconfig->dgst_size == 0) || (rec_size > 256))
+    return -1;
+
+  hc_presort_chunk_t *chunks = (hc_presort_chunk_t *) calloc (threads, sizeof (hc_presort_chunk_t));
+  size_t *offsets = (size_t *) calloc (threads + 1, sizeof (size_t));
+
+  if ((chunks == NULL) || (offsets == NULL))
+  {
+    free (chunks);
+    free (offsets);
+    return -1;
+  }
+
+  hc_split_lines (map->buf, map->len, threads, offsets);
+
+  for (int i = 0; i < threads; i++)
+  {
+    chunks[i].base       = map->buf;
+    chunks[i].buf        = map->buf + offsets[i];
+    chunks[i].len        = offsets[i + 1] - offsets[i];
+    chunks[i].hashconfig = hashconfig;
+    chunks[i].key_size   = key_size;
+    chunks[i].rec_size   = rec_size;
+    chunks[i].username   = username;
+  }
+
+  hc_run_threads (hc_presort_parse_thread, chunks, sizeof (hc_presort_chunk_t), threads, NULL);
+
+  int failed = 0;
+
+  size_t cnt = 0;
+  u64 lines = 0;
+  u64 invalid = 0;
+
+  for (int i = 0; i < threads; i++)
+  {
+    failed  |= chunks[i].failed;
+    cnt     += chunks[i].cnt;
+    lines   += chunks[i].lines;
+    invalid += chunks[i].invalid;
+  }
+
+  u8 *recs = NULL;
+  u8 *tmp  = NULL;
+
+  size_t bucket_start[257];
+
+  if (!failed)
+  {
+    recs = (u8 *) malloc (cnt * rec_size + 1);
+    tmp  = (u8 *) malloc (cnt * rec_size + 1);
+
+    failed = ((recs == NULL) || (tmp == NULL));
+  }
+
+  if (!failed)
+  {
+
+    // MSD pass on the first digest byte, chunk i's records of bucket b go after chunk i - 1's
+    size_t sum = 0;
+
+    for (int b = 0; b < 256; b++)
+    {
+      bucket_start[b] = sum;
+
+      for (int i = 0; i < threads; i++)
+      {
+        chunks[i].pos[b] = sum;
+        sum += chunks[i].hist[b];
+      }
+    }
+
+    bucket_start[256] = sum;
+
+    for (int i = 0; i < threads; i++)
+      chunks[i].dst = recs;
+
+    hc_run_threads (hc_presort_scatter_thread, chunks, sizeof (hc_presort_chunk_t), threads, NULL);
+
+    size_t next = 0;
+
+    hc_presort_buckets_t *jobs = (hc_presort_buckets_t *) calloc (threads, sizeof (hc_presort_buckets_t));
+
+    if (jobs == NULL)
+    {
+      failed = 1;
+    }
+    else
+    {
+      for (int i = 0; i < threads; i++)
+      {
+        jobs[i].recs         = recs;
+        jobs[i].tmp          = tmp;
+        jobs[i].key_size     = key_size;
+        jobs[i].rec_size     = rec_size;
+        jobs[i].bucket_start = bucket_start;
+        jobs[i].next         = &next;
+      }
+
+      hc_run_threads (hc_presort_bucket_thread, jobs, sizeof (hc_presort_buckets_t), threads, NULL);
+
+      free (jobs);
+    }
+  }
+
+  for (int i = 0; i < threads; i++)
+    free (chunks[i].recs);
+
+  free (chunks);
+  free (offsets);
+  free (tmp);
+
+  if (failed)
+  {
+    free (recs);
+    return -1;
+  }
+
+  *recs_out     = recs;
+  *cnt_out      = cnt;
+  *rec_size_out = rec_size;
+  *lines_out    = lines;
+  *invalid_out  = invalid;
+
+  return 0;
+
+}
+
+/* Resolve the presort cache directory, $TMPDIR/pyhashcat-<uid> (or /tmp) unless one is given, and create
+   it 0700. Other users must not be able to plant results in it, so it has to be a real directory owned
+   by us without group or other access. Return 0, -1 with errno set, or -2 when the directory is unsafe */
+
+static int hc_cache_dir (const char *cache_dir, char *buf, size_t len)
+{
+
+  if (cache_dir == NULL)
+  {
+    const char *tmp_dir = getenv ("TMPDIR");
+
+    if ((tmp_dir == NULL) || (*tmp_dir == 0))
+      tmp_dir = "/tmp";
+
+    snprintf (buf, len, "%s/pyhashcat-%u", tmp_dir, (unsigned int) getuid ());
+  }
+  else
+  {
+    snprintf (buf, len, "%s", cache_dir);
+  }
+
+  if ((mkdir (buf, 0700) == -1) && (errno != EEXIST))
+    return -1;
+
+  struct stat st;
+
+  if (lstat (buf, &st) == -1)
+    return -1;
+
+  if ((!S_ISDIR (st.st_mode)) || (st.st_uid != getuid ()) || (st.st_mode & 077))
+    return -2;
+
+  return 0;
+
+}
+
+/* Open a cache entry for reading without following links. Return the fd, or -1 when it is missing or
+   is not a regular file of ours */
+
+static int hc_cache_open (const char *path)
+{
+
+  const int fd = open (path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+
+  if (fd == -1)
+    return -1;
+
+  struct stat st;
+
+  if ((fstat (fd, &st) == -1) || (!S_ISREG (st.st_mode)) || (st.st_uid != getuid ()))
+  {
+    close (fd);
+    return -1;
+  }
+
+  return fd;
+
+}
+
+/* SHA-256 of head followed by buf as lowercase hex, through hashlib which drops the GIL on large
+   inputs. Call with the GIL. Return 0, or -1 with an exception set */
+
+static int hc_sha256_hex (const char *head, const char *buf, const size_t len, char *hex, const size_t hex_len)
+{
+
+  PyObject *hashlib = PyImport_ImportModule ("hashlib");
+
+  if (hashlib == NULL)
+    return -1;
+
+  PyObject *sha = PyObject_CallMethod (hashlib, "sha256", "s", head);
+
+  Py_DECREF (hashlib);
+
+  if (sha == NULL)
+    return -1;
+
+  PyObject *view = PyBuffer_FromMemory ((void *) buf, (Py_ssize_t) len);
+
+  PyObject *rc = (view != NULL) ? PyObject_CallMethod (sha, "update", "O", view) : NULL;
+
+  Py_XDECREF (view);
+
+  PyObject *digest = (rc != NULL) ? PyObject_CallMethod (sha, "hexdigest", NULL) : NULL;
+
+  Py_XDECREF (rc);
+  Py_DECREF (sha);
+
+  if (digest == NULL)
+    return -1;
+
+  if (!PyString_Check (digest))
+  {
+    Py_DECREF (digest);
+
+    PyErr_SetString (PyExc_TypeError, "hexdigest did not return a str");
+    return -1;
+  }
+
+  snprintf (hex, hex_len, "%s", PyString_AS_STRING (digest));
+
+  Py_DECREF (digest);
+
+  return 0;
+
+}
+
+/* A cached presort is reused only when its key file names the same digest and parsing options */
+
+static int hc_presort_key_match (const char *key_path, const char *key)
+{
+
+  const int fd = hc_cache_open (key_path);
+
+  if (fd == -1)
+    return 0;
+
+  char buf[512];
+
+  const size_t key_len = strlen (key);
+
+  const ssize_t nread = read (fd, buf, sizeof (buf));
+
+  close (fd);
+
+  return (nread == (ssize_t) key_len) && (memcmp (buf, key, key_len) == 0);
+
+}
+
+/* Write data to a fresh file next to the cache entry, readable by us only */
+
+static FILE *hc_cache_create (const char *tmp_path)
+{
+
+  const int fd = open (tmp_path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+
+  if (fd == -1)
+    return NULL;
+
+  FILE *fp = fdopen (fd, "wb");
+
+  if (fp == NULL)
+  {
+    const int saved_errno = errno;
+
+    close (fd);
+    unlink (tmp_path);
+
+    errno = saved_errno;
+  }
+
+  return fp;
+
+}
+
+PyDoc_STRVAR(presort_hashes__doc__,
+"presort_hashes(source, hash_mode, cache_dir=None, threads=0, separator=':', hex_salt=False, username=False) -> (path, valid, unique, cached)\n\n\
+Deduplicate and sort a hashlist by decoded digest ahead of a session.\n\n\
+source\t\tstr|list|buffer\tHashlist path, or an in-memory hashlist as accepted by the hash attribute\n\
+hash_mode\tint\t\tHash mode used to decode the digests\n\
+cache_dir\tstr\t\tWhere results are cached, defaults to $TMPDIR/pyhashcat-<uid> (or /tmp/...)\n\
+threads\t\tint\t\tWorker threads, 0 uses every online CPU\n\
+separator\tstr\t\tHash/salt separator, as the separator attribute\n\
+hex_salt\tbool\t\tSalts are given in hex, as the hex_salt attribute\n\
+username\tbool\t\tLines start with a user name, as the username attribute\n\n\
+Every line is decoded with the parser of hash_mode, digests are radix sorted in\n\
+parallel, grouped by salt for salted modes, and only the first line of each\n\
+distinct hash is kept. The result is written as a hashlist named after the SHA-256\n\
+of the source content and the parsing options, with a .key file next to it holding\n\
+that digest and the options. Later calls on the same content and options return the\n\
+cached path (cached is True and valid/unique are None) once the .key file matches.\n\
+The cache directory must be owned by the caller with mode 0700, cache files are not\n\
+followed through symlinks. Assign the returned path to the hash attribute and set\n\
+the same separator, hex_salt and username on the session. Invalid lines are dropped.\n\n");
+
+static PyObject *hashcat_presort_hashes (PyObject * cls, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *source;
+  unsigned int hash_mode;
+  char *cache_dir = NULL;
+  int threads = 0;
+  char separator = ':';
+  PyObject *hex_salt_obj = Py_False;
+  PyObject *username_obj = Py_False;
+  static char *kwlist[] = {"source", "hash_mode", "cache_dir", "threads", "separator", "hex_salt", "username", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OI|zicOO", kwlist, &source, &hash_mode, &cache_dir, &threads, &separator, &hex_salt_obj, &username_obj)) 
+  {
+    return NULL;
+  }
+
+  const int hex_salt = PyObject_IsTrue (hex_salt_obj);
+  const int username = PyObject_IsTrue (username_obj);
+
+  if ((hex_salt == -1) || (username == -1))
+    return NULL;
+
+  threads = hc_threads_default (threads);
+
+  char dir[PATH_MAX];
+
+  const int dir_rc = hc_cache_dir (cache_dir, dir, sizeof (dir));
+
+  if (dir_rc == -1)
+    return PyErr_SetFromErrnoWithFilename (PyExc_OSError, dir);
+
+  if (dir_rc == -2)
+  {
+    PyErr_Format (PyExc_OSError, "Cache directory %s must be a directory owned by the current user with mode 0700", dir);
+    return NULL;
+  }
+
+  hashcat_ctx_t *hashcat_ctx = hc_hashconfig_open_parse (hash_mode, separator, hex_salt);
+
+  if (hashcat_ctx == NULL)
+    return NULL;
+
+  const hashconfig_t *hashconfig = hashcat_ctx->hashconfig;
+
+  if (hashconfig->opts_type & OPTS_TYPE_BINARY_HASHFILE)
+  {
+    hc_hashconfig_close (hashcat_ctx);
+
+    PyErr_Format (PyExc_ValueError, "hash_mode %u uses binary hash files and cannot be presorted", hash_mode);
+    return NULL;
+  }
+
+  if (hc_presort_check (hashconfig, hash_mode) == -1)
+  {
+    hc_hashconfig_close (hashcat_ctx);
+    return NULL;
+  }
+
+  hc_source_map_t map;
+
+  if (hc_source_map_open (source, &map) == -1)
+  {
+    hc_hashconfig_close (hashcat_ctx);
+    return NULL;
+  }
+
+  char options[128];
+
+  snprintf (options, sizeof (options), "hash_mode=%u separator=%02x hex_salt=%d username=%d\n", hash_mode, (unsigned int) (u8) separator, hex_salt, username);
+
+  char digest[80];
+
+  if (hc_sha256_hex (options, map.buf, map.len, digest, sizeof (digest)) == -1)
+  {
+    hc_source_map_close (&map);
+    hc_hashconfig_close (hashcat_ctx);
+    return NULL;
+  }
+
+  char key[256];
+
+  snprintf (key, sizeof (key), "pyhashcat presort 1\nsha256=%s\n%s", digest, options);
+
+  char path[PATH_MAX];
+  char tmp_path[PATH_MAX];
+  char key_path[PATH_MAX];
+  char key_tmp_path[PATH_MAX];
+
+  snprintf (path,         sizeof (path),         "%s/%s.hashes", dir, digest);
+  snprintf (tmp_path,     sizeof (tmp_path),     "%s.%d.tmp", path, (int) getpid ());
+  snprintf (key_path,     sizeof (key_path),     "%s/%s.key", dir, digest);
+  snprintf (key_tmp_path, sizeof (key_tmp_path), "%s.%d.tmp", key_path, (int) getpid ());
+
+  if (hc_presort_key_match (key_path, key))
+  {
+    const int fd = hc_cache_open (path);
+
+    if (fd != -1)
+    {
+      close (fd);
+
+      hc_source_map_close (&map);
+      hc_hashconfig_close (hashcat_ctx);
+
+      return Py_BuildValue ("(sOOO)", path, Py_None, Py_None, Py_True);
+    }
+  }
+
+  if ((size_t) threads > map.len / 4096 + 1)
+    threads = (int) (map.len / 4096 + 1);
+
+  u8 *recs = NULL;
+  size_t cnt = 0;
+  size_t rec_size = 0;
+  u64 lines = 0;
+  u64 invalid = 0;
+  u64 unique = 0;
+
+  int rc;
+  int saved_errno = 0;
+
+  Py_BEGIN_ALLOW_THREADS
+
+  rc = hc_presort_digests (&map, hashconfig, username, threads, &recs, &cnt, &rec_size, &lines, &invalid);
+
+  FILE *fp = NULL;
+
+  if (rc == 0)
+  {
+    // A stale key file must not vouch for the new hashlist while it is replaced
+    unlink (key_path);
+
+    fp = hc_cache_create (tmp_path);
+
+    if (fp == NULL)
+      rc = -2;
+  }
+
+  if (rc == 0)
+  {
+
+    setvbuf (fp, NULL, _IOFBF, 1024 * 1024);
+
+    const size_t key_size = hc_presort_key_size (hashconfig);
+
+    const u8 *prev = NULL;
+
+    for (size_t i = 0; i < cnt; i++)
+    {
+
+      const u8 *rec = recs + i * rec_size;
+
+      if ((prev != NULL) && (memcmp (prev, rec, key_size) == 0))
+        continue;
+
+      prev = rec;
+
+      u64 off;
+
+      memcpy (&off, rec + rec_size - sizeof (u64), sizeof (u64));
+
+      size_t line_len;
+
+      hc_next_line (map.buf + off, map.buf + map.len, &line_len);
+
+      fwrite (map.buf + off, 1, line_len, fp);
+      fputc ('\n', fp);
+
+      unique++;
+    }
+
+    if ((fflush (fp) != 0) || (ferror (fp)))
+      rc = -2;
+
+    if ((fclose (fp) != 0) && (rc == 0))
+      rc = -2;
+
+    // Concurrent callers on the same content race benignly, the last rename wins with identical data
+    if ((rc == 0) && (rename (tmp_path, path) == -1))
+      rc = -2;
+
+    if (rc != 0)
+    {
+      saved_errno = errno;
+      unlink (tmp_path);
+    }
+
+    // The key file goes last, a hashlist without one is rebuilt on the next call
+    if (rc == 0)
+    {
+      FILE *key_fp = hc_cache_create (key_tmp_path);
+
+      if (key_fp != NULL)
+      {
+        const int key_ok = (fputs (key, key_fp) != EOF);
+
+        if ((fclose (key_fp) != 0) || (!key_ok) || (rename (key_tmp_path, key_path) == -1))
+          unlink (key_tmp_path);
+      }
+    }
+  }
+  else if (rc == -2)
+  {
+    saved_errno = errno;
+  }
+
+  free (recs);
+
+  Py_END_ALLOW_THREADS
+
+  hc_source_map_close (&map);
+  hc_hashconfig_close (hashcat_ctx);
+
+  if (rc == -1)
+    return PyErr_NoMemory ();
+
+  if (rc == -2)
+  {
+    errno = saved_errno;
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, path);
+  }
+
+  return Py_BuildValue ("(sKKO)", path, (unsigned long long) cnt, (unsigned long long) unique, Py_False);
+
+}
+
+/* Structural hash signatures for partition_hashes. The first matching entry wins, entries sharing a
+   shape with an earlier one (NTLM after MD5) are only reachable through an explicit modes list */
+
+#define HC_SIG_HEX        1   // hex_len hex digits after the optional prefix
+#define HC_SIG_PREFIX     2   // prefix followed by at least min_len bytes
+#define HC_SIG_NETNTLMV2  3   // user::domain:challenge:hmac:blob
+
+typedef struct hc_signature
+{
+
+  u32 hash_mode;
+  int kind;
+  const char *prefix;
+  u32 len;
+
+} hc_signature_t;
+
+static const hc_signature_t hc_signatures[] =
+{
+  {     0, HC_SIG_HEX,       NULL,                 32 },
+  {   100, HC_SIG_HEX,       NULL,                 40 },
+  {  1400, HC_SIG_HEX,       NULL,                 64 },
+  {  1700, HC_SIG_HEX,       NULL,                128 },
+  {   300, HC_SIG_HEX,       "*",                  40 },
+  {  1000, HC_SIG_HEX,       NULL,                 32 },
+  {   500, HC_SIG_PREFIX,    "$1$",                 1 },
+  {  1600, HC_SIG_PREFIX,    "$apr1$",              1 },
+  {  7400, HC_SIG_PREFIX,    "$5$",                 1 },
+  {  1800, HC_SIG_PREFIX,    "$6$",                 1 },
+  {  3200, HC_SIG_PREFIX,    "$2a$",               56 },
+  {  3200, HC_SIG_PREFIX,    "$2b$",               56 },
+  {  3200, HC_SIG_PREFIX,    "$2y$",               56 },
+  {   400, HC_SIG_PREFIX,    "$P$",                31 },
+  {   400, HC_SIG_PREFIX,    "$H$",                31 },
+  {   101, HC_SIG_PREFIX,    "{SHA}",              28 },
+  {   111, HC_SIG_PREFIX,    "{SSHA}",             28 },
+  {  2100, HC_SIG_PREFIX,    "$DCC2$",              1 },
+  {   124, HC_SIG_PREFIX,    "sha1$",              41 },
+  { 10000, HC_SIG_PREFIX,    "pbkdf2_sha256$",      1 },
+  { 13100, HC_SIG_PREFIX,    "$krb5tgs$23$",        1 },
+  { 18200, HC_SIG_PREFIX,    "$krb5asrep$23$",      1 },
+  {  5600, HC_SIG_NETNTLMV2, NULL,                  0 },
+};
+
+#define HC_SIGNATURES_CNT (sizeof (hc_signatures) / sizeof (hc_signatures[0]))
+
+static int hc_is_hex (const char *buf, size_t len)
+{
+
+  for (size_t i = 0; i < len; i++)
+  {
+    const u8 c = (u8) buf[i];
+
+    if (!(((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'f')) || ((c >= 'A') && (c <= 'F'))))
+      return 0;
+  }
+
+  return 1;
+
+}
+
+static int hc_signature_match (const hc_signature_t * sig, const char *line, size_t len)
+{
+
+  if (sig->prefix != NULL)
+  {
+
+    const size_t prefix_len = strlen (sig->prefix);
+
+    if ((len < prefix_len) || (memcmp (line, sig->prefix, prefix_len) != 0))
+      return 0;
+
+    line += prefix_len;
+    len  -= prefix_len;
+  }
+
+  if (sig->kind == HC_SIG_HEX)
+    return (len == sig->len) && (hc_is_hex (line, len));
+
+  if (sig->kind == HC_SIG_PREFIX)
+    return (len >= sig->len);
+
+  if (sig->kind == HC_SIG_NETNTLMV2)
+  {
+
+    // user::domain:challenge(16 hex):hmac(32 hex):blob
+    const char *field[6];
+    size_t field_len[6];
+
+    size_t n = 0;
+
+    const char *pos = line;
+    const char *end = line + len;
+
+    while ((n < 6) && (pos <= end))
+    {
+      const char *sep = (n < 5) ? (const char *) memchr (pos, ':', end - pos) : NULL;
+
+      if ((n < 5) && (sep == NULL))
+        return 0;
+
+      field[n]     = pos;
+      field_len[n] = ((sep == NULL) ? end : sep) - pos;
+
+      n++;
+
+      pos = (sep == NULL) ? end + 1 : sep + 1;
+    }
+
+    return (n == 6) && (field_len[1] == 0)
+      && (field_len[3] == 16) && (hc_is_hex (field[3], 16))
+      && (field_len[4] == 32) && (hc_is_hex (field[4], 32))
+      && (field_len[5] > 0)   && (hc_is_hex (field[5], field_len[5]));
+  }
+
+  return 0;
+
+}
+
+/* One candidate mode of a partition run: the signatures for it (if any) and, when verifying, its hashconfig */
+
+typedef struct hc_partition_mode
+{
+
+  u32 hash_mode;
+  const hc_signature_t *sigs[8];
+  int sigs_cnt;
+  hashcat_ctx_t *hashcat_ctx;
+
+} hc_partition_mode_t;
+
+typedef struct hc_partition_chunk
+{
+
+  const char *buf;
+  size_t len;
+  const hc_partition_mode_t *modes;
+  int modes_cnt;
+  int verify;
+
+  // class of every line, modes_cnt for unclassified lines
+  u8 *classes;
+  size_t lines;
+  size_t alloc;
+
+  size_t bytes[256];
+  size_t pos[256];
+  char **out;
+
+  int failed;
+
+} hc_partition_chunk_t;
+
+static int hc_partition_classify (hc_partition_chunk_t * chunk, hash_t * hashes, char *line_buf, const char *line, size_t len)
+{
+
+  for (int m = 0; m < chunk->modes_cnt; m++)
+  {
+
+    const hc_partition_mode_t *mode = &chunk->modes[m];
+
+    int match = (mode->sigs_cnt == 0);
+
+    for (int s = 0; (s < mode->sigs_cnt) && (!match); s++)
+      match = hc_signature_match (mode->sigs[s], line, len);
+
+    if (!match)
+      continue;
+
+    if ((chunk->verify) && (hc_parse_line (mode->hashcat_ctx->hashconfig, &hashes[m], line_buf, line, len, 0) != PARSER_OK))
+      continue;
+
+    return m;
+  }
+
+  return chunk->modes_cnt;
+
+}
+
+static void *hc_partition_classify_thread (void *params)
+{
+
+  hc_partition_chunk_t *chunk = (hc_partition_chunk_t *) params;
+
+  hash_t *hashes = NULL;
+  char *line_buf = NULL;
+
+  if (chunk->verify)
+  {
+    hashes   = (hash_t *) calloc (chunk->modes_cnt, sizeof (hash_t));
+    line_buf = (char *) malloc (HCBUFSIZ_LARGE);
+
+    chunk->failed = ((hashes == NULL) || (line_buf == NULL));
+
+    for (int m = 0; (m < chunk->modes_cnt) && (!chunk->failed); m++)
+      chunk->failed = (hc_hash_scratch_init (&hashes[m], chunk->modes[m].hashcat_ctx->hashconfig) == -1);
+  }
+
+  const char *pos = chunk->buf;
+  const char *end = chunk->buf + chunk->len;
+
+  while ((pos < end) && (!chunk->failed))
+  {
+
+    const char *line = pos;
+    size_t line_len;
+
+    pos = hc_next_line (pos, end, &line_len);
+
+    if (chunk->lines == chunk->alloc)
+    {
+
+      const size_t alloc = (chunk->alloc == 0) ? 65536 : chunk->alloc * 2;
+
+      u8 *classes = (u8 *) realloc (chunk->classes, alloc);
+
+      if (classes == NULL)
+      {
+        chunk->failed = 1;
+        break;
+      }
+
+      chunk->classes = classes;
+      chunk->alloc   = alloc;
+    }
+
+    const int m = (line_len == 0) ? chunk->modes_cnt : hc_partition_classify (chunk, hashes, line_buf, line, line_len);
+
+    chunk->classes[chunk->lines++] = (u8) m;
+
+    chunk->bytes[m] += line_len + 1;
+  }
+
+  for (int m = 0; (hashes != NULL) && (m < chunk->modes_cnt); m++)
+    hc_hash_scratch_destroy (&hashes[m]);
+
+  free (hashes);
+  free (line_buf);
+
+  return NULL;
+
+}
+
+static void *hc_partition_copy_thread (void *params)
+{
+
+  hc_partition_chunk_t *chunk = (hc_partition_chunk_t *) params;
+
+  const char *pos = chunk->buf;
+  const char *end = chunk->buf + chunk->len;
+
+  for (size_t i = 0; i < chunk->lines; i++)
+  {
+
+    const char *line = pos;
+    size_t line_len;
+
+    pos = hc_next_line (pos, end, &line_len);
+
+    const int m = chunk->classes[i];
+
+    if (m == chunk->modes_cnt)
+      continue;
+
+    char *dst = chunk->out[m] + chunk->pos[m];
+
+    memcpy (dst, line, line_len);
+
+    dst[line_len] = '\n';
+
+    chunk->pos[m] += line_len + 1;
+  }
+
+  return NULL;
+
+}
+
+/* Build the candidate list from modes (a sequence of hash modes, or None for the signature table) */
+
+static int hc_partition_modes (PyObject * modes, const int verify, hc_partition_mode_t * out, int *out_cnt)
+{
+
+  int cnt = 0;
+
+  PyObject *seq = NULL;
+
+  if (modes != Py_None)
+  {
+
+    seq = PySequence_Fast (modes, "modes must be a sequence of hash modes");
+
+    if (seq == NULL)
+      return -1;
+
+    if (PySequence_Fast_GET_SIZE (seq) > 255)
+    {
+      Py_DECREF (seq);
+      PyErr_SetString (PyExc_ValueError, "At most 255 modes can be partitioned");
+      return -1;
+    }
+  }
+
+  const Py_ssize_t n = (seq == NULL) ? (Py_ssize_t) HC_SIGNATURES_CNT : PySequence_Fast_GET_SIZE (seq);
+
+  for (Py_ssize_t i = 0; i < n; i++)
+  {
+
+    u32 hash_mode;
+
+    if (seq == NULL)
+    {
+      hash_mode = hc_signatures[i].hash_mode;
+    }
+    else
+    {
+      const long v = PyInt_AsLong (PySequence_Fast_GET_ITEM (seq, i));
+
+      if ((v == -1) && (PyErr_Occurred ()))
+      {
+        Py_DECREF (seq);
+        return -1;
+      }
+
+      hash_mode = (u32) v;
+    }
+
+    int m;
+
+    for (m = 0; m < cnt; m++)
+      if (out[m].hash_mode == hash_mode) break;
+
+    if (m < cnt)
+      continue;
+
+    hc_partition_mode_t *mode = &out[cnt];
+
+    memset (mode, 0, sizeof (hc_partition_mode_t));
+
+    mode->hash_mode = hash_mode;
+
+    for (size_t s = 0; s < HC_SIGNATURES_CNT; s++)
+    {
+      if ((hc_signatures[s].hash_mode == hash_mode) && (mode->sigs_cnt < 8))
+        mode->sigs[mode->sigs_cnt++] = &hc_signatures[s];
+    }
+
+    if ((mode->sigs_cnt == 0) && (!verify))
+    {
+      Py_XDECREF (seq);
+      PyErr_Format (PyExc_ValueError, "No signature for hash_mode %u, use verify=True to classify it with its parser", hash_mode);
+      return -1;
+    }
+
+    cnt++;
+  }
+
+  Py_XDECREF (seq);
+
+  *out_cnt = cnt;
+
+  return 0;
+
+}
+
+PyDoc_STRVAR(partition_hashes__doc__,
+"partition_hashes(source, modes=None, verify=False, threads=0) -> (partitions, unclassified)\n\n\
+Split a hashlist that mixes hash modes into one hashlist per mode.\n\n\
+source\t\tstr|list|buffer\tHashlist path, or an in-memory hashlist as accepted by the hash attribute\n\
+modes\t\tlist\t\tCandidate hash modes in order of preference, defaults to the built-in signatures\n\
+verify\t\tbool\t\tConfirm a structural match with the mode's parser, modes without a signature are parser-only\n\
+threads\t\tint\t\tWorker threads, 0 uses every online CPU\n\n\
+Every line is assigned to the first candidate whose signature (length, charset,\n\
+prefix) matches. partitions maps hash_mode to a newline terminated hashlist that\n\
+can be assigned to the hash attribute as is, unclassified counts the lines no\n\
+candidate took. Pass the partitions to hashcat_session_execute_batch to run them.\n\n");
+
+static PyObject *hashcat_partition_hashes (PyObject * cls, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *source;
+  PyObject *modes = Py_None;
+  int verify = 0;
+  int threads = 0;
+  static char *kwlist[] = {"source", "modes", "verify", "threads", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Oii", kwlist, &source, &modes, &verify, &threads)) 
+  {
+    return NULL;
+  }
+
+  hc_partition_mode_t cand[256];
+
+  int cand_cnt = 0;
+
+  if (hc_partition_modes (modes, verify, cand, &cand_cnt) == -1)
+    return NULL;
+
+  if (verify)
+  {
+
+    int kept = 0;
+
+    for (int m = 0; m < cand_cnt; m++)
+    {
+
+      cand[m].hashcat_ctx = hc_hashconfig_open (cand[m].hash_mode);
+
+      if (cand[m].hashcat_ctx == NULL)
+      {
+
+        // The built-in table may name modes this libhashcat lacks, an explicit list may not
+        if (modes != Py_None)
+        {
+          for (int i = 0; i < kept; i++)
+            hc_hashconfig_close (cand[i].hashcat_ctx);
+
+          return NULL;
+        }
+
+        PyErr_Clear ();
+        continue;
+      }
+
+      cand[kept++] = cand[m];
+    }
+
+    cand_cnt = kept;
+  }
+
+  hc_source_map_t map;
+
+  if (hc_source_map_open (source, &map) == -1)
+  {
+    for (int m = 0; (verify) && (m < cand_cnt); m++)
+      hc_hashconfig_close (cand[m].hashcat_ctx);
+
+    return NULL;
+  }
+
+  threads = hc_threads_default (threads);
+
+  if ((size_t) threads > map.len / 4096 + 1)
+    threads = (int) (map.len / 4096 + 1);
+
+  hc_partition_chunk_t *chunks = (hc_partition_chunk_t *) calloc (threads, sizeof (hc_partition_chunk_t));
+  size_t *offsets = (size_t *) calloc (threads + 1, sizeof (size_t));
+
+  char *out[256] = { NULL };
+  PyObject *parts[256] = { NULL };
+
+  int failed = ((chunks == NULL) || (offsets == NULL));
+
+  if (!failed)
+  {
+
+    hc_split_lines (map.buf, map.len, threads, offsets);
+
+    for (int i = 0; i < threads; i++)
+    {
+      chunks[i].buf       = map.buf + offsets[i];
+      chunks[i].len       = offsets[i + 1] - offsets[i];
+      chunks[i].modes     = cand;
+      chunks[i].modes_cnt = cand_cnt;
+      chunks[i].verify    = verify;
+      chunks[i].out       = out;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+
+    hc_run_threads (hc_partition_classify_thread, chunks, sizeof (hc_partition_chunk_t), threads, NULL);
+
+    Py_END_ALLOW_THREADS
+
+    for (int i = 0; i < threads; i++)
+      failed |= chunks[i].failed;
+  }
+
+  if (failed)
+    PyErr_NoMemory ();
+
+  u64 unclassified = 0;
+
+  // One output string per mode, chunk i's lines of a mode go after chunk i - 1's
+  for (int m = 0; (m < cand_cnt) && (!failed); m++)
+  {
+
+    size_t sum = 0;
+
+    for (int i = 0; i < threads; i++)
+    {
+      chunks[i].pos[m] = sum;
+      sum += chunks[i].bytes[m];
+    }
+
+    if (sum == 0)
+      continue;
+
+    parts[m] = PyString_FromStringAndSize (NULL, sum);
+
+    if (parts[m] == NULL)
+      failed = 1;
+    else
+      out[m] = PyString_AS_STRING (parts[m]);
+  }
+
+  PyObject *rtn = NULL;
+
+  if (!failed)
+  {
+
+    Py_BEGIN_ALLOW_THREADS
+
+    hc_run_threads (hc_partition_copy_thread, chunks, sizeof (hc_partition_chunk_t), threads, NULL);
+
+    Py_END_ALLOW_THREADS
+
+    for (int i = 0; i < threads; i++)
+      for (size_t j = 0; j < chunks[i].lines; j++)
+        unclassified += (chunks[i].classes[j] == cand_cnt);
+
+    PyObject *dict = PyDict_New ();
+
+    for (int m = 0; (m < cand_cnt) && (dict != NULL); m++)
+    {
+
+      if (parts[m] == NULL)
+        continue;
+
+      PyObject *key = PyInt_FromLong (cand[m].hash_mode);
+
+      if ((key == NULL) || (PyDict_SetItem (dict, key, parts[m]) == -1))
+        Py_CLEAR (dict);
+
+      Py_XDECREF (key);
+    }
+
+    if (dict != NULL)
+      rtn = Py_BuildValue ("(NK)", dict, (unsigned long long) unclassified);
+  }
+
+  for (int m = 0; m < cand_cnt; m++)
+    Py_XDECREF (parts[m]);
+
+  for (int i = 0; (chunks != NULL) && (i < threads); i++)
+    free (chunks[i].classes);
+
+  free (chunks);
+  free (offsets);
+
+  hc_source_map_close (&map);
+
+  for (int m = 0; (verify) && (m < cand_cnt); m++)
+    hc_hashconfig_close (cand[m].hashcat_ctx);
+
+  return rtn;
+
+}
+
+/* Salt groups of a salted hashlist: distinct hashes sorted by salt, one group per salt */
+
+typedef struct hc_salt_group
+{
+
+  size_t start;
+  size_t cnt;
+
+} hc_salt_group_t;
+
+typedef struct hc_salt_run
+{
+
+  hashcat_ctx_t *hashcat_ctx;
+  hc_source_map_t map;
+
+  u8 *recs;
+  size_t rec_size;
+  size_t digests_cnt;
+
+  hc_salt_group_t *groups;
+  size_t groups_cnt;
+
+} hc_salt_run_t;
+
+static int hc_salt_groups (hc_salt_run_t * run, int threads)
+{
+
+  const hashconfig_t *hashconfig = run->hashcat_ctx->hashconfig;
+
+  const size_t key_size = hc_presort_key_size (hashconfig);
+
+  size_t cnt;
+  u64 lines;
+  u64 invalid;
+
+  if (hc_presort_digests (&run->map, hashconfig, 0, threads, &run->recs, &cnt, &run->rec_size, &lines, &invalid) == -1)
+    return -1;
+
+  const size_t rec_size = run->rec_size;
+
+  // Drop duplicates in place, the records stay sorted
+  size_t unique = 0;
+
+  for (size_t i = 0; i < cnt; i++)
+  {
+
+    u8 *rec = run->recs + i * rec_size;
+
+    if ((unique > 0) && (memcmp (run->recs + (unique - 1) * rec_size, rec, key_size) == 0))
+      continue;
+
+    if (unique != i)
+      memcpy (run->recs + unique * rec_size, rec, rec_size);
+
+    unique++;
+  }
+
+  run->digests_cnt = unique;
+
+  size_t groups_cnt = 0;
+
+  for (size_t i = 0; i < unique; i++)
+  {
+    if ((i == 0) || (memcmp (run->recs + (i - 1) * rec_size, run->recs + i * rec_size, HC_PRESORT_SALT_KEY_SIZE) != 0))
+      groups_cnt++;
+  }
+
+  run->groups = (hc_salt_group_t *) calloc (groups_cnt + 1, sizeof (hc_salt_group_t));
+
+  if (run->groups == NULL)
+    return -1;
+
+  size_t g = 0;
+
+  for (size_t i = 0; i < unique; i++)
+  {
+    if ((i > 0) && (memcmp (run->recs + (i - 1) * rec_size, run->recs + i * rec_size, HC_PRESORT_SALT_KEY_SIZE) != 0))
+      g++;
+
+    if (run->groups[g].cnt == 0)
+      run->groups[g].start = i;
+
+    run->groups[g].cnt++;
+  }
+
+  run->groups_cnt = groups_cnt;
+
+  return 0;
+
+}
+
+static void hc_salt_run_close (hc_salt_run_t * run)
+{
+
+  free (run->recs);
+  free (run->groups);
+
+  hc_source_map_close (&run->map);
+  hc_hashconfig_close (run->hashcat_ctx);
+
+}
+
+/* Set up run for a salted hash_mode and group source by salt. Return -1 with a python error set */
+
+static int hc_salt_run_open (hc_salt_run_t * run, PyObject * source, const u32 hash_mode, int threads)
+{
+
+  memset (run, 0, sizeof (hc_salt_run_t));
+
+  run->hashcat_ctx = hc_hashconfig_open (hash_mode);
+
+  if (run->hashcat_ctx == NULL)
+    return -1;
+
+  const hashconfig_t *hashconfig = run->hashcat_ctx->hashconfig;
+
+  if ((!hashconfig->is_salted) || (hashconfig->opts_type & OPTS_TYPE_BINARY_HASHFILE))
+  {
+    hc_hashconfig_close (run->hashcat_ctx);
+
+    PyErr_Format (PyExc_ValueError, "hash_mode %u is not a salted mode with text hashlists", hash_mode);
+    return -1;
+  }
+
+  if (hc_presort_check (hashconfig, hash_mode) == -1)
+  {
+    hc_hashconfig_close (run->hashcat_ctx);
+    return -1;
+  }
+
+  if (hc_source_map_open (source, &run->map) == -1)
+  {
+    hc_hashconfig_close (run->hashcat_ctx);
+    return -1;
+  }
+
+  threads = hc_threads_default (threads);
+
+  if ((size_t) threads > run->map.len / 4096 + 1)
+    threads = (int) (run->map.len / 4096 + 1);
+
+  int rc;
+
+  Py_BEGIN_ALLOW_THREADS
+
+  rc = hc_salt_groups (run, threads);
+
+  Py_END_ALLOW_THREADS
+
+  if (rc == -1)
+  {
+    hc_salt_run_close (run);
+
+    PyErr_NoMemory ();
+    return -1;
+  }
+
+  return 0;
+
+}
+
+static int hc_salt_group_cmp (const void *a, const void *b)
+{
+
+  const hc_salt_group_t *ga = (const hc_salt_group_t *) a;
+  const hc_salt_group_t *gb = (const hc_salt_group_t *) b;
+
+  if (ga->cnt != gb->cnt) return (ga->cnt > gb->cnt) ? -1 : 1;
+
+  return (ga->start < gb->start) ? -1 : (ga->start > gb->start);
+
+}
+
+PyDoc_STRVAR(salt_stats__doc__,
+"salt_stats(source, hash_mode, threads=0) -> dict\n\n\
+Salt cardinality of a hashlist for a salted hash mode, before any session runs.\n\n\
+source\t\tstr|list|buffer\tHashlist path or in-memory hashlist\n\
+hash_mode\tint\t\tSalted hash mode used to decode the hashlist\n\
+threads\t\tint\t\tWorker threads, 0 uses every online CPU\n\n\
+Return a dict with salts_cnt and digests_cnt as status_get_salts_cnt and\n\
+status_get_digests_cnt will report them, max_digests_per_salt and distribution,\n\
+a list of (digests per salt, number of salts) pairs from dense to sparse.\n\n");
+
+static PyObject *hashcat_salt_stats (PyObject * cls, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *source;
+  unsigned int hash_mode;
+  int threads = 0;
+  static char *kwlist[] = {"source", "hash_mode", "threads", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OI|i", kwlist, &source, &hash_mode, &threads)) 
+  {
+    return NULL;
+  }
+
+  hc_salt_run_t run;
+
+  if (hc_salt_run_open (&run, source, hash_mode, threads) == -1)
+    return NULL;
+
+  qsort (run.groups, run.groups_cnt, sizeof (hc_salt_group_t), hc_salt_group_cmp);
+
+  PyObject *distribution = PyList_New (0);
+
+  for (size_t g = 0; (g < run.groups_cnt) && (distribution != NULL); )
+  {
+
+    size_t n = 1;
+
+    while ((g + n < run.groups_cnt) && (run.groups[g + n].cnt == run.groups[g].cnt))
+      n++;
+
+    PyObject *entry = Py_BuildValue ("(nn)", (Py_ssize_t) run.groups[g].cnt, (Py_ssize_t) n);
+
+    if ((entry == NULL) || (PyList_Append (distribution, entry) == -1))
+      Py_CLEAR (distribution);
+
+    Py_XDECREF (entry);
+
+    g += n;
+  }
+
+  PyObject *rtn = NULL;
+
+  if (distribution != NULL)
+  {
+    rtn = Py_BuildValue ("{s:n,s:n,s:n,s:N}",
+      "salts_cnt",            (Py_ssize_t) run.groups_cnt,
+      "digests_cnt",          (Py_ssize_t) run.digests_cnt,
+      "max_digests_per_salt", (Py_ssize_t) ((run.groups_cnt > 0) ? run.groups[0].cnt : 0),
+      "distribution",         distribution);
+  }
+
+  hc_salt_run_close (&run);
+
+  return rtn;
+
+}
+
+PyDoc_STRVAR(salt_cohorts__doc__,
+"salt_cohorts(source, hash_mode, cohorts=4, threads=0) -> list\n\n\
+Split a salted hashlist into salt cohorts ordered by priority.\n\n\
+source\t\tstr|list|buffer\tHashlist path or in-memory hashlist\n\
+hash_mode\tint\t\tSalted hash mode used to decode the hashlist\n\
+cohorts\t\tint\t\tNumber of cohorts\n\
+threads\t\tint\t\tWorker threads, 0 uses every online CPU\n\n\
+Salts are ranked by how many distinct hashes share them and dealt into cohorts\n\
+holding the same number of salts, so each cohort costs about the same device time\n\
+and the first one holds the most hashes. Return a list of (hash_mode, hashlist)\n\
+pairs, densest first, ready for hashcat_session_execute_batch.\n\n");
+
+static PyObject *hashcat_salt_cohorts (PyObject * cls, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *source;
+  unsigned int hash_mode;
+  int cohorts = 4;
+  int threads = 0;
+  static char *kwlist[] = {"source", "hash_mode", "cohorts", "threads", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OI|ii", kwlist, &source, &hash_mode, &cohorts, &threads)) 
+  {
+    return NULL;
+  }
+
+  if (cohorts < 1)
+  {
+    PyErr_SetString (PyExc_ValueError, "cohorts must be at least 1");
+    return NULL;
+  }
+
+  hc_salt_run_t run;
+
+  if (hc_salt_run_open (&run, source, hash_mode, threads) == -1)
+    return NULL;
+
+  qsort (run.groups, run.groups_cnt, sizeof (hc_salt_group_t), hc_salt_group_cmp);
+
+  const char *end = run.map.buf + run.map.len;
+
+  PyObject *rtn = PyList_New (0);
+
+  for (int c = 0; (c < cohorts) && (rtn != NULL); c++)
+  {
+
+    const size_t first = run.groups_cnt * c / cohorts;
+    const size_t last  = run.groups_cnt * (c + 1) / cohorts;
+
+    if (first == last)
+      continue;
+
+    // Size the cohort, then copy its lines straight into the result string
+    size_t len = 0;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+
+      PyObject *hashlist = NULL;
+      char *dst = NULL;
+
+      if (pass == 1)
+      {
+        hashlist = PyString_FromStringAndSize (NULL, len);
+
+        if (hashlist == NULL)
+        {
+          Py_CLEAR (rtn);
+          break;
+        }
+
+        dst = PyString_AS_STRING (hashlist);
+      }
+
+      for (size_t g = first; g < last; g++)
+      {
+        for (size_t i = run.groups[g].start; i < run.groups[g].start + run.groups[g].cnt; i++)
+        {
+
+          u64 off;
+
+          memcpy (&off, run.recs + i * run.rec_size + run.rec_size - sizeof (u64), sizeof (u64));
+
+          size_t line_len;
+
+          hc_next_line (run.map.buf + off, end, &line_len);
+
+          if (pass == 0)
+          {
+            len += line_len + 1;
+            continue;
+          }
+
+          memcpy (dst, run.map.buf + off, line_len);
+
+          dst[line_len] = '\n';
+
+          dst += line_len + 1;
+        }
+      }
+
+      if (pass == 1)
+      {
+        PyObject *entry = Py_BuildValue ("(IN)", hash_mode, hashlist);
+
+        if ((entry == NULL) || (PyList_Append (rtn, entry) == -1))
+          Py_CLEAR (rtn);
+
+        Py_XDECREF (entry);
+      }
+    }
+  }
+
+  hc_salt_run_close (&run);
+
+  return rtn;
+
+}
+
+/* Potfile index. A sidecar file next to the potfile holds an open addressing table from a hash of each
+   entry's hash part to the entry's line offset. The table covers the potfile up to indexed_len and is
+   caught up with appended lines whenever it is opened, a potfile that was replaced or truncated gets
+   a fresh index. Writers take an exclusive flock on the sidecar, readers a shared one */
+
+#define HC_POTIDX_MAGIC     "PYHCPOT\001"
+#define HC_POTIDX_VERSION   1
+#define HC_POTIDX_SUFFIX    ".pyhcidx"
+#define HC_POTIDX_MIN_SLOTS 1024
+
+typedef struct hc_potidx_header
+{
+
+  char magic[8];
+  u32 version;
+  u32 reserved;
+  u64 pot_dev;
+  u64 pot_ino;
+  u64 indexed_len;
+  u64 slots_cnt;
+  u64 used_cnt;
+
+} hc_potidx_header_t;
+
+typedef struct hc_potidx_slot
+{
+
+  u64 key;
+  u64 off;    // line offset + 1, 0 for an empty slot
+
+} hc_potidx_slot_t;
+
+typedef struct hc_potidx
+{
+
+  int idx_fd;
+  hc_potidx_header_t *hdr;
+  size_t idx_len;
+  hc_potidx_slot_t *slots;
+
+  const char *pot;
+  size_t pot_map_len;
+  size_t pot_len;
+
+} hc_potidx_t;
+
+/* Hash part of a potfile line, everything before the last separator. hashcat writes plains containing
+   the separator as $HEX[], so the last one is always the boundary */
+
+static int hc_pot_split (const char *line, const size_t len, size_t * hash_len)
+{
+
+  for (size_t i = len; i > 0; i--)
+  {
+    if (line[i - 1] == ':')
+    {
+      *hash_len = i - 1;
+      return 1;
+    }
+  }
+
+  return 0;
+
+}
+
+static u64 hc_pot_key (const char *hash, const size_t hash_len)
+{
+
+  return hc_hash64 (hash, hash_len, 0x706f7466696c65ULL);
+
+}
+
+/* Compare the entry at off against hash, on a match point plain at its plain */
+
+static int hc_potidx_entry_match (const hc_potidx_t * idx, const u64 off, const char *hash, const size_t hash_len, const char **plain, size_t * plain_len)
+{
+
+  const char *line = idx->pot + off - 1;
+
+  size_t line_len;
+
+  hc_next_line (line, idx->pot + idx->pot_len, &line_len);
+
+  size_t entry_len;
+
+  if ((!hc_pot_split (line, line_len, &entry_len)) || (entry_len != hash_len) || (memcmp (line, hash, hash_len) != 0))
+    return 0;
+
+  if (plain != NULL)
+  {
+    *plain     = line + entry_len + 1;
+    *plain_len = line_len - entry_len - 1;
+  }
+
+  return 1;
+
+}
+
+static int hc_potidx_find (const hc_potidx_t * idx, const char *hash, const size_t hash_len, const char **plain, size_t * plain_len)
+{
+
+  if (idx->slots == NULL)
+    return 0;
+
+  const u64 mask = idx->hdr->slots_cnt - 1;
+  const u64 key  = hc_pot_key (hash, hash_len);
+
+  for (u64 i = key & mask;; i = (i + 1) & mask)
+  {
+
+    const hc_potidx_slot_t *slot = &idx->slots[i];
+
+    if (slot->off == 0)
+      return 0;
+
+    if ((slot->key == key) && (hc_potidx_entry_match (idx, slot->off, hash, hash_len, plain, plain_len)))
+      return 1;
+  }
+
+}
+
+/* Index the potfile lines in [start, idx->pot_len). The first entry of a hash wins */
+
+static void hc_potidx_insert_lines (hc_potidx_t * idx, size_t start)
+{
+
+  const u64 mask = idx->hdr->slots_cnt - 1;
+
+  const char *pos = idx->pot + start;
+  const char *end = idx->pot + idx->pot_len;
+
+  while (pos < end)
+  {
+
+    const char *line = pos;
+    size_t line_len;
+
+    pos = hc_next_line (pos, end, &line_len);
+
+    size_t hash_len;
+
+    if (!hc_pot_split (line, line_len, &hash_len))
+      continue;
+
+    const u64 key = hc_pot_key (line, hash_len);
+
+    u64 i;
+
+    for (i = key & mask; idx->slots[i].off != 0; i = (i + 1) & mask)
+    {
+      if ((idx->slots[i].key == key) && (hc_potidx_entry_match (idx, idx->slots[i].off, line, hash_len, NULL, NULL)))
+        break;
+    }
+
+    if (idx->slots[i].off != 0)
+      continue;
+
+    idx->slots[i].key = key;
+    idx->slots[i].off = (u64) (line - idx->pot) + 1;
+
+    idx->hdr->used_cnt++;
+  }
+
+}
+
+static void hc_potidx_close (hc_potidx_t * idx)
+{
+
+  if (idx->hdr != NULL)
+    munmap ((void *) idx->hdr, idx->idx_len);
+
+  if (idx->pot != NULL)
+    munmap ((void *) idx->pot, idx->pot_map_len);
+
+  // Closing the descriptor drops the lock
+  if (idx->idx_fd != -1)
+    close (idx->idx_fd);
+
+  memset (idx, 0, sizeof (hc_potidx_t));
+
+  idx->idx_fd = -1;
+
+}
+
+/* (Re)size the sidecar to slots_cnt empty slots and map it */
+
+static int hc_potidx_map_new (hc_potidx_t * idx, const u64 slots_cnt)
+{
+
+  const size_t len = sizeof (hc_potidx_header_t) + slots_cnt * sizeof (hc_potidx_slot_t);
+
+  if ((ftruncate (idx->idx_fd, 0) == -1) || (ftruncate (idx->idx_fd, len) == -1))
+    return -1;
+
+  void *addr = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, idx->idx_fd, 0);
+
+  if (addr == MAP_FAILED)
+    return -1;
+
+  idx->hdr     = (hc_potidx_header_t *) addr;
+  idx->idx_len = len;
+  idx->slots   = (hc_potidx_slot_t *) (idx->hdr + 1);
+
+  memcpy (idx->hdr->magic, HC_POTIDX_MAGIC, sizeof (idx->hdr->magic));
+
+  idx->hdr->version   = HC_POTIDX_VERSION;
+  idx->hdr->slots_cnt = slots_cnt;
+
+  return 0;
+
+}
+
+/* Open the index of pot_path, bringing it up to date first. A missing potfile gives an empty index.
+   Call without the GIL. Return 0, or -1 with errno set */
+
+static int hc_potidx_open (const char *pot_path, hc_potidx_t * idx)
+{
+
+  memset (idx, 0, sizeof (hc_potidx_t));
+
+  idx->idx_fd = -1;
+
+  const int pot_fd = open (pot_path, O_RDONLY | O_CLOEXEC);
+
+  if (pot_fd == -1)
+    return (errno == ENOENT) ? 0 : -1;
+
+  struct stat pot_st;
+
+  if (fstat (pot_fd, &pot_st) == -1)
+  {
+    const int saved_errno = errno;
+    close (pot_fd);
+    errno = saved_errno;
+    return -1;
+  }
+
+  if (pot_st.st_size > 0)
+  {
+
+    void *addr = mmap (NULL, pot_st.st_size, PROT_READ, MAP_SHARED, pot_fd, 0);
+
+    if (addr == MAP_FAILED)
+    {
+      const int saved_errno = errno;
+      close (pot_fd);
+      errno = saved_errno;
+      return -1;
+    }
+
+    idx->pot         = (const char *) addr;
+    idx->pot_map_len = pot_st.st_size;
+
+    // Only complete lines, an appender may be in the middle of one
+    const char *nl = (const char *) memrchr (idx->pot, '\n', idx->pot_map_len);
+
+    idx->pot_len = (nl == NULL) ? 0 : (size_t) (nl - idx->pot) + 1;
+  }
+
+  close (pot_fd);
+
+  char idx_path[PATH_MAX];
+
+  snprintf (idx_path, sizeof (idx_path), "%s%s", pot_path, HC_POTIDX_SUFFIX);
+
+  idx->idx_fd = open (idx_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+  if ((idx->idx_fd == -1) || (flock (idx->idx_fd, LOCK_EX) == -1))
+  {
+    const int saved_errno = errno;
+    hc_potidx_close (idx);
+    errno = saved_errno;
+    return -1;
+  }
+
+  struct stat idx_st;
+
+  if (fstat (idx->idx_fd, &idx_st) == -1)
+  {
+    const int saved_errno = errno;
+    hc_potidx_close (idx);
+    errno = saved_errno;
+    return -1;
+  }
+
+  int valid = 0;
+
+  if ((size_t) idx_st.st_size >= sizeof (hc_potidx_header_t))
+  {
+
+    void *addr = mmap (NULL, idx_st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, idx->idx_fd, 0);
+
+    if (addr != MAP_FAILED)
+    {
+
+      idx->hdr     = (hc_potidx_header_t *) addr;
+      idx->idx_len = idx_st.st_size;
+      idx->slots   = (hc_potidx_slot_t *) (idx->hdr + 1);
+
+      const hc_potidx_header_t *hdr = idx->hdr;
+
+      valid = (memcmp (hdr->magic, HC_POTIDX_MAGIC, sizeof (hdr->magic)) == 0)
+        && (hdr->version == HC_POTIDX_VERSION)
+        && (hdr->pot_dev == (u64) pot_st.st_dev)
+        && (hdr->pot_ino == (u64) pot_st.st_ino)
+        && (hdr->slots_cnt >= HC_POTIDX_MIN_SLOTS)
+        && ((hdr->slots_cnt & (hdr->slots_cnt - 1)) == 0)
+        && (idx->idx_len == sizeof (hc_potidx_header_t) + hdr->slots_cnt * sizeof (hc_potidx_slot_t))
+        && (hdr->indexed_len <= idx->pot_len)
+        && ((hdr->indexed_len == 0) || (idx->pot[hdr->indexed_len - 1] == '\n'));
+    }
+  }
+
+  const size_t start = (valid) ? idx->hdr->indexed_len : 0;
+  const u64 used     = (valid) ? idx->hdr->used_cnt : 0;
+
+  u64 new_lines = 0;
+
+  for (const char *pos = idx->pot + start; pos < idx->pot + idx->pot_len; new_lines++)
+    pos = (const char *) memchr (pos, '\n', idx->pot + idx->pot_len - pos) + 1;
+
+  // Keep the load factor below 0.7
+  u64 slots_cnt = HC_POTIDX_MIN_SLOTS;
+
+  while (slots_cnt * 7 < (used + new_lines) * 10)
+    slots_cnt *= 2;
+
+  if ((!valid) || (idx->hdr->slots_cnt < slots_cnt))
+  {
+
+    // Grow by rehashing the existing entries, the potfile is not read again
+    hc_potidx_slot_t *old = NULL;
+
+    u64 old_cnt = 0;
+
+    if (valid)
+    {
+
+      old = (hc_potidx_slot_t *) malloc (used * sizeof (hc_potidx_slot_t) + 1);
+
+      if (old == NULL)
+      {
+        hc_potidx_close (idx);
+        errno = ENOMEM;
+        return -1;
+      }
+
+      for (u64 i = 0; i < idx->hdr->slots_cnt; i++)
+        if (idx->slots[i].off != 0) old[old_cnt++] = idx->slots[i];
+    }
+
+    if (idx->hdr != NULL)
+      munmap ((void *) idx->hdr, idx->idx_len);
+
+    idx->hdr = NULL;
+
+    if (hc_potidx_map_new (idx, slots_cnt) == -1)
+    {
+      const int saved_errno = errno;
+      free (old);
+      hc_potidx_close (idx);
+      errno = saved_errno;
+      return -1;
+    }
+
+    const u64 mask = slots_cnt - 1;
+
+    for (u64 j = 0; j < old_cnt; j++)
+    {
+
+      u64 i;
+
+      for (i = old[j].key & mask; idx->slots[i].off != 0; i = (i + 1) & mask);
+
+      idx->slots[i] = old[j];
+    }
+
+    free (old);
+
+    idx->hdr->pot_dev  = pot_st.st_dev;
+    idx->hdr->pot_ino  = pot_st.st_ino;
+    idx->hdr->used_cnt = old_cnt;
+  }
+
+  hc_potidx_insert_lines (idx, start);
+
+  idx->hdr->indexed_len = idx->pot_len;
+
+  // Up to date, let other readers in
+  flock (idx->idx_fd, LOCK_SH);
+
+  return 0;
+
+}
+
+/* The potfile a lookup runs against: the argument, else the potfile_path option, else the default
+   potfile of an initialized session */
+
+static const char *hashcat_potfile (hashcatObject * self, const char *potfile_path)
+{
+
+  if (potfile_path != NULL)
+    return potfile_path;
+
+  if (self->user_options->potfile_path != NULL)
+    return self->user_options->potfile_path;
+
+  if ((self->rc_init == 0) && (self->hashcat_ctx->potfile_ctx != NULL) && (self->hashcat_ctx->potfile_ctx->filename != NULL))
+    return self->hashcat_ctx->potfile_ctx->filename;
+
+  PyErr_SetString (PyExc_RuntimeError, "No potfile, set potfile_path or pass it explicitly");
+  return NULL;
+
+}
+
+static int hashcat_potidx_open (hashcatObject * self, const char *potfile_path, hc_potidx_t * idx)
+{
+
+  const char *path = hashcat_potfile (self, potfile_path);
+
+  if (path == NULL)
+    return -1;
+
+  int rc;
+
+  Py_BEGIN_ALLOW_THREADS
+
+  rc = hc_potidx_open (path, idx);
+
+  Py_END_ALLOW_THREADS
+
+  if (rc == -1)
+  {
+    PyErr_SetFromErrnoWithFilename (PyExc_IOError, path);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+PyDoc_STRVAR(potfile_lookup__doc__,
+"potfile_lookup(hashes, potfile_path=None) -> str|dict\n\n\
+Look hashes up in the potfile through its persistent index.\n\n\
+hashes\t\tstr|list\tA hash, or a list of hashes\n\
+potfile_path\tstr\t\tPotfile to use, defaults to the potfile_path option or the session's potfile\n\n\
+Hashes are matched as hashcat writes them to the potfile. The index lives next to\n\
+the potfile (" HC_POTIDX_SUFFIX " suffix), is built on first use and afterwards\n\
+only reads lines appended since, so a lookup costs O(hashes) instead of a potfile\n\
+parse. Return the plain (None if not cracked) for a single hash, or a dict of\n\
+hash -> plain holding the cracked ones for a list.\n\n");
+
+static PyObject *hashcat_potfile_lookup (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *hashes;
+  char *potfile_path = NULL;
+  static char *kwlist[] = {"hashes", "potfile_path", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|z", kwlist, &hashes, &potfile_path)) 
+  {
+    return NULL;
+  }
+
+  PyObject *seq = NULL;
+
+  if (!PyString_Check (hashes))
+  {
+    seq = PySequence_Fast (hashes, "hashes must be a string or a sequence of strings");
+
+    if (seq == NULL)
+      return NULL;
+  }
+
+  hc_potidx_t idx;
+
+  if (hashcat_potidx_open (self, potfile_path, &idx) == -1)
+  {
+    Py_XDECREF (seq);
+    return NULL;
+  }
+
+  const char *plain;
+  size_t plain_len;
+
+  PyObject *rtn = NULL;
+
+  if (seq == NULL)
+  {
+
+    if (hc_potidx_find (&idx, PyString_AS_STRING (hashes), PyString_GET_SIZE (hashes), &plain, &plain_len))
+    {
+      rtn = PyString_FromStringAndSize (plain, plain_len);
+    }
+    else
+    {
+      Py_INCREF (Py_None);
+      rtn = Py_None;
+    }
+
+  }
+  else
+  {
+
+    rtn = PyDict_New ();
+
+    for (Py_ssize_t i = 0; (rtn != NULL) && (i < PySequence_Fast_GET_SIZE (seq)); i++)
+    {
+
+      PyObject *hash = PySequence_Fast_GET_ITEM (seq, i);
+
+      if (!PyString_Check (hash))
+      {
+        PyErr_SetString (PyExc_TypeError, "hashes must be strings");
+        Py_CLEAR (rtn);
+        break;
+      }
+
+      if (!hc_potidx_find (&idx, PyString_AS_STRING (hash), PyString_GET_SIZE (hash), &plain, &plain_len))
+        continue;
+
+      PyObject *value = PyString_FromStringAndSize (plain, plain_len);
+
+      if ((value == NULL) || (PyDict_SetItem (rtn, hash, value) == -1))
+        Py_CLEAR (rtn);
+
+      Py_XDECREF (value);
+    }
+
+    Py_DECREF (seq);
+  }
+
+  hc_potidx_close (&idx);
+
+  return rtn;
+
+}
+
+PyDoc_STRVAR(filter_uncracked__doc__,
+"filter_uncracked(hashes, potfile_path=None) -> list|str\n\n\
+Drop the hashes the potfile already has, using the persistent potfile index.\n\n\
+hashes\t\tlist|str|buffer\tA list of hashes, or a hashlist path or in-memory hashlist\n\
+potfile_path\tstr\t\tPotfile to use, defaults to the potfile_path option or the session's potfile\n\n\
+A list gives a list of the uncracked hashes. Any other hashlist gives the uncracked\n\
+lines as a newline terminated hashlist, ready for the hash attribute.\n\n");
+
+static PyObject *hashcat_filter_uncracked (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *hashes;
+  char *potfile_path = NULL;
+  static char *kwlist[] = {"hashes", "potfile_path", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|z", kwlist, &hashes, &potfile_path)) 
+  {
+    return NULL;
+  }
+
+  hc_potidx_t idx;
+
+  if (PyList_Check (hashes) || PyTuple_Check (hashes))
+  {
+
+    if (hashcat_potidx_open (self, potfile_path, &idx) == -1)
+      return NULL;
+
+    PyObject *rtn = PyList_New (0);
+
+    for (Py_ssize_t i = 0; (rtn != NULL) && (i < PySequence_Fast_GET_SIZE (hashes)); i++)
+    {
+
+      PyObject *hash = PySequence_Fast_GET_ITEM (hashes, i);
+
+      if (!PyString_Check (hash))
+      {
+        PyErr_SetString (PyExc_TypeError, "hashes must be strings");
+        Py_CLEAR (rtn);
+        break;
+      }
+
+      if (hc_potidx_find (&idx, PyString_AS_STRING (hash), PyString_GET_SIZE (hash), NULL, NULL))
+        continue;
+
+      if (PyList_Append (rtn, hash) == -1)
+        Py_CLEAR (rtn);
+    }
+
+    hc_potidx_close (&idx);
+
+    return rtn;
+  }
+
+  hc_source_map_t map;
+
+  if (hc_source_map_open (hashes, &map) == -1)
+    return NULL;
+
+  if (hashcat_potidx_open (self, potfile_path, &idx) == -1)
+  {
+    hc_source_map_close (&map);
+    return NULL;
+  }
+
+  // The output never outgrows the input plus a final newline
+  char *out = (char *) malloc (map.len + 1);
+
+  size_t out_len = 0;
+
+  if (out != NULL)
+  {
+
+    Py_BEGIN_ALLOW_THREADS
+
+    const char *pos = map.buf;
+    const char *end = map.buf + map.len;
+
+    while (pos < end)
+    {
+
+      const char *line = pos;
+      size_t line_len;
+
+      pos = hc_next_line (pos, end, &line_len);
+
+      if ((line_len == 0) || (hc_potidx_find (&idx, line, line_len, NULL, NULL)))
+        continue;
+
+      memcpy (out + out_len, line, line_len);
+
+      out[out_len + line_len] = '\n';
+
+      out_len += line_len + 1;
+    }
+
+    Py_END_ALLOW_THREADS
+  }
+
+  hc_potidx_close (&idx);
+  hc_source_map_close (&map);
+
+  if (out == NULL)
+    return PyErr_NoMemory ();
+
+  PyObject *rtn = PyString_FromStringAndSize (out, out_len);
+
+  free (out);
+
+  return rtn;
+
+}
+
+/* Potfile compaction: an external merge sort over the lines of the potfile that drops repeated
+   (hash, plain) lines. Sorted runs are bounded by memory_limit bytes of line descriptors, the lines
+   themselves stay in the read-only mapping of the potfile */
+
+typedef struct hc_line
+{
+
+  const char *buf;
+  size_t len;
+
+} hc_line_t;
+
+static int hc_line_cmp (const void *a, const void *b)
+{
+
+  const hc_line_t *la = (const hc_line_t *) a;
+  const hc_line_t *lb = (const hc_line_t *) b;
+
+  const int rc = memcmp (la->buf, lb->buf, (la->len < lb->len) ? la->len : lb->len);
+
+  if (rc != 0)
+    return rc;
+
+  return (la->len < lb->len) ? -1 : (la->len > lb->len);
+
+}
+
+typedef struct hc_sort_piece
+{
+
+  hc_line_t *lines;
+  size_t cnt;
+
+} hc_sort_piece_t;
+
+static void *hc_sort_piece_thread (void *params)
+{
+
+  hc_sort_piece_t *piece = (hc_sort_piece_t *) params;
+
+  qsort (piece->lines, piece->cnt, sizeof (hc_line_t), hc_line_cmp);
+
+  return NULL;
+
+}
+
+/* A sorted input of the merge, either a sorted piece in memory or a run file */
+
+typedef struct hc_merge_src
+{
+
+  const hc_line_t *lines;
+  size_t cnt;
+  size_t pos;
+
+  FILE *fp;
+  char *buf;
+  size_t buf_size;
+
+  hc_line_t cur;
+
+} hc_merge_src_t;
+
+static int hc_merge_src_next (hc_merge_src_t * src)
+{
+
+  if (src->fp == NULL)
+  {
+    if (src->pos == src->cnt)
+      return 0;
+
+    src->cur = src->lines[src->pos++];
+
+    return 1;
+  }
+
+  const ssize_t len = getline (&src->buf, &src->buf_size, src->fp);
+
+  if (len <= 0)
+    return 0;
+
+  src->cur.buf = src->buf;
+  src->cur.len = (size_t) len - 1;
+
+  return 1;
+
+}
+
+/* Merge sorted sources into fp, writing each distinct line once. Return the number of lines written */
+
+static u64 hc_merge_write (hc_merge_src_t * srcs, const size_t srcs_cnt, FILE * fp)
+{
+
+  // Binary min-heap of source indexes, ordered by their current line
+  size_t *heap = (size_t *) malloc ((srcs_cnt + 1) * sizeof (size_t));
+
+  if (heap == NULL)
+    return (u64) -1;
+
+  size_t heap_cnt = 0;
+
+  for (size_t i = 0; i < srcs_cnt; i++)
+  {
+
+    if (!hc_merge_src_next (&srcs[i]))
+      continue;
+
+    size_t c = heap_cnt++;
+
+    while ((c > 0) && (hc_line_cmp (&srcs[i].cur, &srcs[heap[(c - 1) / 2]].cur) < 0))
+    {
+      heap[c] = heap[(c - 1) / 2];
+      c = (c - 1) / 2;
+    }
+
+    heap[c] = i;
+  }
+
+  char *prev = NULL;
+  size_t prev_len = 0;
+  size_t prev_size = 0;
+  int have_prev = 0;
+
+  u64 written = 0;
+
+  while (heap_cnt > 0)
+  {
+
+    hc_merge_src_t *src = &srcs[heap[0]];
+
+    if ((!have_prev) || (prev_len != src->cur.len) || (memcmp (prev, src->cur.buf, prev_len) != 0))
+    {
+
+      fwrite (src->cur.buf, 1, src->cur.len, fp);
+      fputc ('\n', fp);
+
+      written++;
+
+      // File sources reuse their line buffer, keep a copy for the duplicate check
+      if (src->cur.len + 1 > prev_size)
+      {
+        prev_size = (src->cur.len + 1) * 2;
+
+        char *tmp = (char *) realloc (prev, prev_size);
+
+        if (tmp == NULL)
+        {
+          free (prev);
+          free (heap);
+          return (u64) -1;
+        }
+
+        prev = tmp;
+      }
+
+      memcpy (prev, src->cur.buf, src->cur.len);
+
+      prev_len  = src->cur.len;
+      have_prev = 1;
+    }
+
+    if (!hc_merge_src_next (src))
+      heap[0] = heap[--heap_cnt];
+
+    // Sift down
+    size_t c = 0;
+
+    for (;;)
+    {
+      size_t l = 2 * c + 1;
+
+      if (l >= heap_cnt)
+        break;
+
+      if ((l + 1 < heap_cnt) && (hc_line_cmp (&srcs[heap[l + 1]].cur, &srcs[heap[l]].cur) < 0))
+        l++;
+
+      if (hc_line_cmp (&srcs[heap[l]].cur, &srcs[heap[c]].cur) >= 0)
+        break;
+
+      const size_t swap = heap[c];
+
+      heap[c] = heap[l];
+      heap[l] = swap;
+
+      c = l;
+    }
+  }
+
+  free (prev);
+  free (heap);
+
+  return written;
+
+}
+
+typedef struct hc_compact
+{
+
+  const char *path;
+  int threads;
+  size_t memory_limit;
+
+  u64 before_bytes;
+  u64 before_lines;
+  u64 after_bytes;
+  u64 after_lines;
+  u64 tail_bytes;
+
+  pid_t writer;
+
+} hc_compact_t;
+
+/* Sort lines[0..cnt) with threads pieces and merge the pieces into fp. Return lines written or -1 */
+
+static u64 hc_compact_sort_run (hc_line_t * lines, const size_t cnt, const int threads, FILE * fp)
+{
+
+  hc_sort_piece_t *pieces = (hc_sort_piece_t *) calloc (threads, sizeof (hc_sort_piece_t));
+  hc_merge_src_t *srcs = (hc_merge_src_t *) calloc (threads, sizeof (hc_merge_src_t));
+
+  if ((pieces == NULL) || (srcs == NULL))
+  {
+    free (pieces);
+    free (srcs);
+    return (u64) -1;
+  }
+
+  for (int i = 0; i < threads; i++)
+  {
+    const size_t first = cnt * i / threads;
+    const size_t last  = cnt * (i + 1) / threads;
+
+    pieces[i].lines = lines + first;
+    pieces[i].cnt   = last - first;
+
+    srcs[i].lines = pieces[i].lines;
+    srcs[i].cnt   = pieces[i].cnt;
+  }
+
+  hc_run_threads (hc_sort_piece_thread, pieces, sizeof (hc_sort_piece_t), threads, NULL);
+
+  const u64 written = hc_merge_write (srcs, threads, fp);
+
+  free (pieces);
+  free (srcs);
+
+  return written;
+
+}
+
+/* Find a process holding the file st for writing, other than through own_fd of this process. hashcat
+   opens the potfile once per session and appends to that descriptor, what it writes after a swap is
+   lost. Processes whose descriptors can not be read are not seen. Return the pid or 0 if there is none */
+
+static pid_t hc_file_writer (const struct stat * st, const int own_fd)
+{
+
+  DIR *proc = opendir ("/proc");
+
+  if (proc == NULL)
+    return 0;
+
+  const pid_t self_pid = getpid ();
+
+  pid_t writer = 0;
+
+  struct dirent *de;
+
+  while ((writer == 0) && ((de = readdir (proc)) != NULL))
+  {
+
+    char *end;
+
+    const long pid = strtol (de->d_name, &end, 10);
+
+    if ((end == de->d_name) || (*end != 0))
+      continue;
+
+    char path[64];
+
+    snprintf (path, sizeof (path), "/proc/%ld/fd", pid);
+
+    DIR *fds = opendir (path);
+
+    if (fds == NULL)
+      continue;
+
+    struct dirent *fde;
+
+    while ((writer == 0) && ((fde = readdir (fds)) != NULL))
+    {
+
+      const long fd = strtol (fde->d_name, &end, 10);
+
+      if ((end == fde->d_name) || (*end != 0))
+        continue;
+
+      if ((pid == self_pid) && (fd == own_fd))
+        continue;
+
+      char fd_path[64];
+
+      struct stat fd_st;
+
+      snprintf (fd_path, sizeof (fd_path), "/proc/%ld/fd/%ld", pid, fd);
+
+      if ((stat (fd_path, &fd_st) == -1) || (fd_st.st_dev != st->st_dev) || (fd_st.st_ino != st->st_ino))
+        continue;
+
+      // Readers lose nothing, only descriptors open for writing count
+      snprintf (fd_path, sizeof (fd_path), "/proc/%ld/fdinfo/%ld", pid, fd);
+
+      FILE *info = fopen (fd_path, "rb");
+
+      if (info == NULL)
+        continue;
+
+      char line[128];
+
+      while (fgets (line, sizeof (line), info) != NULL)
+      {
+        if (strncmp (line, "flags:", 6) == 0)
+        {
+          if ((strtol (line + 6, NULL, 8) & O_ACCMODE) != O_RDONLY)
+            writer = (pid_t) pid;
+
+          break;
+        }
+      }
+
+      fclose (info);
+    }
+
+    closedir (fds);
+  }
+
+  closedir (proc);
+
+  return writer;
+
+}
+
+/* Compact c->path in place. Call without the GIL. Return 0, -1 with errno set, -2 if the potfile
+   was replaced while compacting, or -3 if c->writer holds it open for writing */
+
+static int hc_compact_potfile (hc_compact_t * c)
+{
+
+  const int pot_fd = open (c->path, O_RDONLY | O_CLOEXEC);
+
+  if (pot_fd == -1)
+    return -1;
+
+  struct stat st;
+
+  if (fstat (pot_fd, &st) == -1)
+  {
+    const int saved_errno = errno;
+    close (pot_fd);
+    errno = saved_errno;
+    return -1;
+  }
+
+  const char *pot = NULL;
+
+  if (st.st_size > 0)
+  {
+    void *addr = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, pot_fd, 0);
+
+    if (addr == MAP_FAILED)
+    {
+      const int saved_errno = errno;
+      close (pot_fd);
+      errno = saved_errno;
+      return -1;
+    }
+
+    pot = (const char *) addr;
+
+    madvise (addr, st.st_size, MADV_SEQUENTIAL);
+  }
+
+  // Complete lines only, the rest is carried over verbatim at swap time
+  const char *nl = (pot == NULL) ? NULL : (const char *) memrchr (pot, '\n', st.st_size);
+
+  const size_t sorted_len = (nl == NULL) ? 0 : (size_t) (nl - pot) + 1;
+
+  char tmp_path[PATH_MAX];
+
+  snprintf (tmp_path, sizeof (tmp_path), "%s.compact.%d.tmp", c->path, (int) getpid ());
+
+  size_t run_lines = c->memory_limit / sizeof (hc_line_t);
+
+  if (run_lines < 1024)
+    run_lines = 1024;
+
+  hc_line_t *lines = (hc_line_t *) malloc (run_lines * sizeof (hc_line_t));
+
+  FILE *out = fopen (tmp_path, "wb");
+
+  int rc = 0;
+
+  if (lines == NULL)
+  {
+    errno = ENOMEM;
+    rc = -1;
+  }
+
+  if (out == NULL)
+    rc = -1;
+  else
+    setvbuf (out, NULL, _IOFBF, 1024 * 1024);
+
+  // Sorted runs when the potfile does not fit into one, unlinked files next to the potfile
+  hc_merge_src_t *runs = NULL;
+  size_t runs_cnt = 0;
+
+  const char *pos = pot;
+  const char *end = pot + sorted_len;
+
+  while ((rc == 0) && (pos < end))
+  {
+
+    size_t cnt = 0;
+
+    while ((pos < end) && (cnt < run_lines))
+    {
+      lines[cnt].buf = pos;
+
+      pos = hc_next_line (pos, end, &lines[cnt].len);
+
+      // Empty lines are dropped
+      if (lines[cnt].len > 0)
+      {
+        cnt++;
+
+        c->before_lines++;
+      }
+    }
+
+    FILE *dst = out;
+
+    if ((pos < end) || (runs_cnt > 0))
+    {
+
+      hc_merge_src_t *tmp = (hc_merge_src_t *) realloc (runs, (runs_cnt + 1) * sizeof (hc_merge_src_t));
+
+      if (tmp == NULL)
+      {
+        errno = ENOMEM;
+        rc = -1;
+        break;
+      }
+
+      runs = tmp;
+
+      memset (&runs[runs_cnt], 0, sizeof (hc_merge_src_t));
+
+      char run_path[PATH_MAX];
+
+      snprintf (run_path, sizeof (run_path), "%s.run%zu.%d.tmp", c->path, runs_cnt, (int) getpid ());
+
+      const int run_fd = open (run_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+      if (run_fd == -1)
+      {
+        rc = -1;
+        break;
+      }
+
+      unlink (run_path);
+
+      runs[runs_cnt].fp = fdopen (run_fd, "w+b");
+
+      if (runs[runs_cnt].fp == NULL)
+      {
+        close (run_fd);
+        rc = -1;
+        break;
+      }
+
+      setvbuf (runs[runs_cnt].fp, NULL, _IOFBF, 1024 * 1024);
+
+      dst = runs[runs_cnt++].fp;
+    }
+
+    const u64 written = hc_compact_sort_run (lines, cnt, c->threads, dst);
+
+    if (written == (u64) -1)
+    {
+      errno = ENOMEM;
+      rc = -1;
+      break;
+    }
+
+    if (dst == out)
+      c->after_lines = written;
+  }
+
+  free (lines);
+
+  for (size_t r = 0; (rc == 0) && (r < runs_cnt); r++)
+  {
+    if ((fflush (runs[r].fp) != 0) || (ferror (runs[r].fp)) || (fseek (runs[r].fp, 0, SEEK_SET) == -1))
+      rc = -1;
+  }
+
+  if ((rc == 0) && (runs_cnt > 0))
+  {
+    const u64 written = hc_merge_write (runs, runs_cnt, out);
+
+    if (written == (u64) -1)
+    {
+      errno = ENOMEM;
+      rc = -1;
+    }
+    else
+    {
+      c->after_lines = written;
+    }
+  }
+
+  for (size_t r = 0; r < runs_cnt; r++)
+  {
+    fclose (runs[r].fp);
+    free (runs[r].buf);
+  }
+
+  free (runs);
+
+  c->before_bytes = st.st_size;
+
+  if (pot != NULL)
+    munmap ((void *) pot, st.st_size);
+
+  close (pot_fd);
+
+  if (out == NULL)
+    return -1;
+
+  if (rc == 0)
+  {
+    if ((fflush (out) != 0) || (ferror (out)))
+      rc = -1;
+  }
+
+  // Swap under the flock sinks append under and the fcntl write lock hashcat appends under, carrying
+  // over whatever was appended meanwhile
+  int lock_fd = -1;
+
+  if (rc == 0)
+  {
+    lock_fd = open (c->path, O_RDWR | O_CLOEXEC);
+
+    if ((lock_fd == -1) || (flock (lock_fd, LOCK_EX) == -1))
+      rc = -1;
+  }
+
+  if (rc == 0)
+  {
+
+    struct flock lock;
+
+    memset (&lock, 0, sizeof (lock));
+
+    lock.l_type = F_WRLCK;
+
+    while ((rc == 0) && (fcntl (lock_fd, F_SETLKW, &lock) == -1))
+    {
+      if (errno != EINTR)
+        rc = -1;
+    }
+  }
+
+  struct stat now;
+
+  if (rc == 0)
+  {
+    if (fstat (lock_fd, &now) == -1)
+      rc = -1;
+    else if ((now.st_ino != st.st_ino) || (now.st_dev != st.st_dev) || (now.st_size < st.st_size))
+      rc = -2;
+    else if ((c->writer = hc_file_writer (&now, lock_fd)) != 0)
+      rc = -3;
+  }
+
+  if (rc == 0)
+  {
+
+    if (lseek (lock_fd, sorted_len, SEEK_SET) == -1)
+      rc = -1;
+
+    char buf[65536];
+
+    while (rc == 0)
+    {
+      const ssize_t n = read (lock_fd, buf, sizeof (buf));
+
+      if (n == -1)
+      {
+        if (errno == EINTR)
+          continue;
+
+        rc = -1;
+        break;
+      }
+
+      if (n == 0)
+        break;
+
+      fwrite (buf, 1, n, out);
+
+      c->tail_bytes += n;
+    }
+  }
+
+  if ((rc == 0) && ((fflush (out) != 0) || (ferror (out)) || (fchmod (fileno (out), st.st_mode & 07777) == -1) || (fsync (fileno (out)) == -1)))
+    rc = -1;
+
+  if (rc == 0)
+  {
+    struct stat out_st;
+
+    if (fstat (fileno (out), &out_st) == 0)
+      c->after_bytes = out_st.st_size;
+  }
+
+  const int saved_errno = errno;
+
+  fclose (out);
+
+  if ((rc == 0) && (rename (tmp_path, c->path) == -1))
+    rc = -1;
+
+  if (rc != 0)
+    unlink (tmp_path);
+
+  // Sinks blocked on the old file notice the replaced inode once they get the lock
+  if (lock_fd != -1)
+    close (lock_fd);
+
+  errno = saved_errno;
+
+  return rc;
+
+}
+
+PyDoc_STRVAR(compact_potfile__doc__,
+"compact_potfile(potfile_path=None, threads=0, memory_limit=268435456) -> dict\n\n\
+Drop repeated (hash, plain) entries from a potfile and swap the result in atomically.\n\n\
+potfile_path\tstr\tPotfile to compact, defaults to the potfile_path option or the session's potfile\n\
+threads\t\tint\tSort threads, 0 uses every online CPU\n\
+memory_limit\tint\tBytes of line descriptors per sorted run, larger potfiles are merged from runs\n\n\
+The potfile is mapped and sorted in runs that are merged into a new file. The swap\n\
+happens under an exclusive flock, the lock potfile sinks take, and the fcntl write\n\
+lock hashcat appends under, and carries over every byte appended since the sort\n\
+started. hashcat keeps the potfile open for a whole session and would append to the\n\
+replaced file, so while any process holds the potfile open for writing nothing is\n\
+changed and RuntimeError is raised. Only processes whose descriptors are readable\n\
+in /proc are seen. Empty lines are neither counted nor kept. The result is in\n\
+sorted order.\n\n\
+Return a dict with before_bytes, after_bytes, before_lines, after_lines, tail_bytes\n\
+(carried over unsorted) and seconds.\n\n");
+
+static PyObject *hashcat_compact_potfile (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  char *potfile_path = NULL;
+  int threads = 0;
+  Py_ssize_t memory_limit = 256 * 1024 * 1024;
+  static char *kwlist[] = {"potfile_path", "threads", "memory_limit", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|zin", kwlist, &potfile_path, &threads, &memory_limit)) 
+  {
+    return NULL;
+  }
+
+  const char *path = hashcat_potfile (self, potfile_path);
+
+  if (path == NULL)
+    return NULL;
+
+  hc_compact_t c;
+
+  memset (&c, 0, sizeof (c));
+
+  c.path         = path;
+  c.threads      = hc_threads_default (threads);
+  c.memory_limit = (memory_limit > 0) ? (size_t) memory_limit : 0;
+
+  int rc;
+
+  const double start = hc_time_now ();
+
+  Py_BEGIN_ALLOW_THREADS
+
+  rc = hc_compact_potfile (&c);
+
+  Py_END_ALLOW_THREADS
+
+  const double seconds = hc_time_now () - start;
+
+  if (rc == -1)
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+
+  if (rc == -2)
+  {
+    PyErr_Format (PyExc_RuntimeError, "%s was replaced while compacting, nothing was changed", path);
+    return NULL;
+  }
+
+  if (rc == -3)
+  {
+    PyErr_Format (PyExc_RuntimeError, "%s is open for writing by process %d, nothing was changed", path, (int) c.writer);
+    return NULL;
+  }
+
+  return Py_BuildValue ("{s:K,s:K,s:K,s:K,s:K,s:d}",
+    "before_bytes", (unsigned long long) c.before_bytes,
+    "after_bytes",  (unsigned long long) c.after_bytes,
+    "before_lines", (unsigned long long) c.before_lines,
+    "after_lines",  (unsigned long long) c.after_lines,
+    "tail_bytes",   (unsigned long long) c.tail_bytes,
+    "seconds",      seconds);
+
+}
+
+static int hc_sink_fsync_policy (const char *name)
+{
+
+  if (strcmp (name, "never")  == 0) return HC_SINK_FSYNC_NEVER;
+  if (strcmp (name, "batch")  == 0) return HC_SINK_FSYNC_BATCH;
+  if (strcmp (name, "finish") == 0) return HC_SINK_FSYNC_FINISH;
+
+  return -1;
+
+}
+
+static int hashcat_session_running (hashcatObject * self)
+{
+
+  return (self->thread_started) && (self->session_exit_time == 0);
+
+}
+
+PyDoc_STRVAR(potfile_sink_open__doc__,
+"potfile_sink_open(potfile_path=None, batch=256, fsync=\"never\")\n\n\
+Write cracks to the potfile from this module instead of from hashcat.\n\n\
+potfile_path\tstr\tPotfile to append to, defaults to the potfile_path option\n\
+batch\t\tint\tCracks buffered before a write\n\
+fsync\t\tstr\t\"never\", \"batch\" (after every write) or \"finish\" (when a session finishes)\n\n\
+Every batch is a single O_APPEND write of whole records under an exclusive flock\n\
+on the potfile, so sessions of any number of objects and processes sharing it never\n\
+interleave lines. Buffered cracks are also written when a session finishes, on\n\
+potfile_sink_flush and on potfile_sink_close. While the sink is open sessions run\n\
+with potfile_disable so cracks are not written twice, the potfile_disable attribute\n\
+keeps the value set and is applied again when the sink is closed. Use\n\
+filter_uncracked to drop cracked hashes up front, execute warns with a\n\
+RuntimeWarning when it turns potfile_disable on for a sink. Records are taken\n\
+from EVENT_CRACKER_HASH_CRACKED, so execute raises ValueError unless username is\n\
+off and outfile_format and outfile_autohex are at their defaults (hash:plain).\n\n");
+
+static PyObject *hashcat_potfile_sink_open (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  char *potfile_path = NULL;
+  int batch = 256;
+  char *fsync_name = "never";
+  static char *kwlist[] = {"potfile_path", "batch", "fsync", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|zis", kwlist, &potfile_path, &batch, &fsync_name)) 
+  {
+    return NULL;
+  }
+
+  const int fsync_policy = hc_sink_fsync_policy (fsync_name);
+
+  if (fsync_policy == -1)
+  {
+    PyErr_SetString (PyExc_ValueError, "fsync must be \"never\", \"batch\" or \"finish\"");
+    return NULL;
+  }
+
+  if (batch < 1)
+  {
+    PyErr_SetString (PyExc_ValueError, "batch must be at least 1");
+    return NULL;
+  }
+
+  if (hashcat_session_running (self))
+  {
+    PyErr_SetString (PyExc_RuntimeError, "Cannot change the potfile sink while a session is running");
+    return NULL;
+  }
+
+  const char *path = hashcat_potfile (self, potfile_path);
+
+  if (path == NULL)
+    return NULL;
+
+  hc_pot_sink_t *sink = (hc_pot_sink_t *) calloc (1, sizeof (hc_pot_sink_t));
+
+  if (sink == NULL)
+    return PyErr_NoMemory ();
+
+  pthread_mutex_init (&sink->lock, NULL);
+
+  sink->path         = strdup (path);
+  sink->fsync_policy = fsync_policy;
+  sink->batch        = batch;
+  sink->fd           = -1;
+
+  // Checked up front, every batch opens the potfile again
+  const int fd = open (path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+
+  if (fd != -1)
+    close (fd);
+
+  if ((sink->path == NULL) || (fd == -1))
+  {
+    const int saved_errno = (sink->path == NULL) ? ENOMEM : errno;
+
+    hc_pot_sink_free (sink);
+
+    errno = saved_errno;
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+  }
+
+  hc_pot_sink_t *old = self->pot_sink;
+
+  self->pot_sink = sink;
+
+  if ((old != NULL) && (hc_pot_sink_free (old) == -1))
+    return PyErr_SetFromErrno (PyExc_IOError);
+
+  Py_INCREF (Py_None);
+  return Py_None;
+
+}
+
+PyDoc_STRVAR(potfile_sink_flush__doc__,
+"potfile_sink_flush(sync=False) -> int\n\n\
+Write the cracks buffered by the potfile sink now, with fdatasync if sync is True.\n\n\
+Return the number of cracks the sink has written so far");
+
+static PyObject *hashcat_potfile_sink_flush (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  int sync = 0;
+  static char *kwlist[] = {"sync", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|i", kwlist, &sync)) 
+  {
+    return NULL;
+  }
+
+  hc_pot_sink_t *sink = self->pot_sink;
+
+  if (sink == NULL)
+  {
+    PyErr_SetString (PyExc_RuntimeError, "No potfile sink open");
+    return NULL;
+  }
+
+  int rc;
+
+  Py_BEGIN_ALLOW_THREADS
+
+  pthread_mutex_lock (&sink->lock);
+
+  rc = hc_pot_sink_flush_locked (sink, sync);
+
+  if ((rc == 0) && (sink->error != 0))
+    rc = -1;
+
+  errno = sink->error;
+
+  sink->error = 0;
+
+  pthread_mutex_unlock (&sink->lock);
+
+  Py_END_ALLOW_THREADS
+
+  if (rc == -1)
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, sink->path);
+
+  return Py_BuildValue ("K", (unsigned long long) (sink->records - sink->pending));
+
+}
+
+PyDoc_STRVAR(potfile_sink_close__doc__,
+"potfile_sink_close() -> dict\n\n\
+Flush and close the potfile sink, sessions write the potfile themselves again.\n\n\
+Return a dict with records, writes and bytes written by the sink");
+
+static PyObject *hashcat_potfile_sink_close (hashcatObject * self, PyObject * noargs)
+{
+
+  hc_pot_sink_t *sink = self->pot_sink;
+
+  if (sink == NULL)
+  {
+    PyErr_SetString (PyExc_RuntimeError, "No potfile sink open");
+    return NULL;
+  }
+
+  if (hashcat_session_running (self))
+  {
+    PyErr_SetString (PyExc_RuntimeError, "Cannot change the potfile sink while a session is running");
+    return NULL;
+  }
+
+  self->pot_sink = NULL;
+
+  hashcat_potfile_disable_restore (self);
+
+  PyObject *stats = Py_BuildValue ("{s:K,s:K,s:K}",
+    "records", (unsigned long long) sink->records,
+    "writes",  (unsigned long long) sink->writes,
+    "bytes",   (unsigned long long) (sink->bytes + sink->len));
+
+  int rc;
+
+  Py_BEGIN_ALLOW_THREADS
+
+  rc = hc_pot_sink_free (sink);
+
+  Py_END_ALLOW_THREADS
+
+  if (rc == -1)
+  {
+    Py_XDECREF (stats);
+    return PyErr_SetFromErrno (PyExc_IOError);
+  }
+
+  return stats;
+
+}
+
+/* Username map. load_user_map parses a username:hash list once and keeps, for every distinct digest,
+   the usernames sharing it: one arena holding the names back to back, the sorted 64 bit digest keys
+   and per key a range of (offset, length) pairs into the arena, plus the hash text of the key's first
+   line. Crack lines from EVENT_CRACKER_HASH_CRACKED are parsed with the same parser, looked up by key,
+   confirmed against the stored hash and queued; python objects are only made when cracked_users asks
+   for rows */
+
+typedef struct hc_user_crack
+{
+
+  u64 text_off;
+  u32 hash_len;
+  u32 text_len;
+
+  // index into keys, HC_USER_UNMATCHED when the line did not parse or is not in the map
+  u64 key_idx;
+
+} hc_user_crack_t;
+
+#define HC_USER_UNMATCHED ((u64) -1)
+
+typedef struct hc_user_map
+{
+
+  hashcat_ctx_t *hashcat_ctx;
+
+  char *names;
+  u64 names_len;
+
+  u64 *keys;
+  u64 *first;
+  u64 keys_cnt;
+
+  u64 *name_off;
+  u32 *name_len;
+  u64 accounts_cnt;
+
+  // hash text of every key, key k spans hash_off[k] to hash_off[k + 1]
+  char *hashes;
+  u64 *hash_off;
+
+  // crack queue, appended by the session thread under lock
+  pthread_mutex_t lock;
+
+  hash_t hash;
+  hash_t stored;
+  char *line_buf;
+
+  char *text;
+  u64 text_len;
+  u64 text_size;
+
+  hc_user_crack_t *cracks;
+  u64 cracks_cnt;
+  u64 cracks_alloc;
+  u64 unmatched;
+
+  int failed;
+
+  // The object and every cracked_users or user_map_info call in flight, changed with the GIL held
+  u32 refs;
+
+} hc_user_map_t;
+
+static u64 hc_user_key (const hashconfig_t * hashconfig, const hash_t * hash)
+{
+
+  u64 seed = 0;
+
+  if (hashconfig->is_salted)  seed  = hc_hash64 (hash->salt, sizeof (salt_t), 0);
+  if (hashconfig->esalt_size) seed ^= hc_hash64 (hash->esalt, hashconfig->esalt_size, 1);
+
+  return hc_hash64 (hash->digest, hashconfig->dgst_size, seed);
+
+}
+
+static u64 hc_user_map_find (const hc_user_map_t * map, const u64 key)
+{
+
+  u64 lo = 0;
+  u64 hi = map->keys_cnt;
+
+  while (lo < hi)
+  {
+    const u64 mid = lo + (hi - lo) / 2;
+
+    if (map->keys[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if ((lo < map->keys_cnt) && (map->keys[lo] == key))
+    return lo;
+
+  return HC_USER_UNMATCHED;
+
+}
+
+static void hc_user_map_free (hc_user_map_t * map)
+{
+
+  if (map->hashcat_ctx != NULL)
+    hc_hashconfig_close (map->hashcat_ctx);
+
+  hc_hash_scratch_destroy (&map->hash);
+  hc_hash_scratch_destroy (&map->stored);
+
+  pthread_mutex_destroy (&map->lock);
+
+  free (map->names);
+  free (map->hashes);
+  free (map->hash_off);
+  free (map->keys);
+  free (map->first);
+  free (map->name_off);
+  free (map->name_len);
+  free (map->line_buf);
+  free (map->text);
+  free (map->cracks);
+  free (map);
+
+}
+
+/* Drop one reference, the last one frees the map. Call with the GIL held */
+
+static void hc_user_map_release (hc_user_map_t * map)
+{
+
+  if (--map->refs == 0)
+    hc_user_map_free (map);
+
+}
+
+/* Keys are 64 bit hashes and only narrow the search. The hash parsed into map->hash matches key_idx
+   when the key's stored hash decodes to the same digest, salt and esalt. Caller holds map->lock */
+
+static int hc_user_map_confirm (hc_user_map_t * map, const u64 key_idx)
+{
+
+  const hashconfig_t *hashconfig = map->hashcat_ctx->hashconfig;
+
+  const u64 off = map->hash_off[key_idx];
+
+  if (hc_parse_line (hashconfig, &map->stored, map->line_buf, map->hashes + off, map->hash_off[key_idx + 1] - off, 0) != PARSER_OK)
+    return 0;
+
+  if (memcmp (map->stored.digest, map->hash.digest, hashconfig->dgst_size) != 0)
+    return 0;
+
+  if ((hashconfig->is_salted) && (memcmp (map->stored.salt, map->hash.salt, sizeof (salt_t)) != 0))
+    return 0;
+
+  if ((hashconfig->esalt_size) && (memcmp (map->stored.esalt, map->hash.esalt, hashconfig->esalt_size) != 0))
+    return 0;
+
+  return 1;
+
+}
+
+/* Queue one crack line. Runs on the session thread. With the username option hashcat puts the account
+   in front of the hash, that field is dropped and the account is taken from the map. Salts and plains
+   may both contain the separator, so the hash is the shortest prefix ending before a separator that
+   parses to a digest in the map, or failing that the shortest one the parser accepts */
+
+static void hc_user_map_add_crack (hc_user_map_t * map, const char *line, size_t len, const int username)
+{
+
+  const hashconfig_t *hashconfig = map->hashcat_ctx->hashconfig;
+
+  const char separator = hashconfig->separator;
+
+  if (username)
+  {
+
+    const char *sep = (const char *) memchr (line, separator, len);
+
+    if (sep != NULL)
+    {
+      len -= (sep + 1) - line;
+      line = sep + 1;
+    }
+  }
+
+  pthread_mutex_lock (&map->lock);
+
+  if ((map->cracks_cnt == map->cracks_alloc) || (map->text_len + len > map->text_size))
+  {
+
+    const u64 cracks_alloc = (map->cracks_cnt == map->cracks_alloc) ? ((map->cracks_alloc == 0) ? 1024 : map->cracks_alloc * 2) : map->cracks_alloc;
+
+    u64 text_size = (map->text_size == 0) ? 65536 : map->text_size;
+
+    while (map->text_len + len > text_size)
+      text_size *= 2;
+
+    hc_user_crack_t *cracks = (hc_user_crack_t *) realloc (map->cracks, cracks_alloc * sizeof (hc_user_crack_t));
+
+    if (cracks != NULL)
+    {
+      map->cracks       = cracks;
+      map->cracks_alloc = cracks_alloc;
+    }
+
+    char *text = (char *) realloc (map->text, text_size);
+
+    if (text != NULL)
+    {
+      map->text      = text;
+      map->text_size = text_size;
+    }
+
+    if ((cracks == NULL) || (text == NULL))
+    {
+      map->failed = 1;
+
+      pthread_mutex_unlock (&map->lock);
+      return;
+    }
+  }
+
+  hc_user_crack_t *crack = &map->cracks[map->cracks_cnt];
+
+  crack->text_off = map->text_len;
+  crack->text_len = (u32) len;
+  crack->key_idx  = HC_USER_UNMATCHED;
+
+  const char *sep = (const char *) memrchr (line, separator, len);
+
+  crack->hash_len = (sep == NULL) ? (u32) len : (u32) (sep - line);
+
+  int parsed = 0;
+
+  for (const char *pos = line; pos < line + len; pos++)
+  {
+
+    if (*pos != separator)
+      continue;
+
+    if (hc_parse_line (hashconfig, &map->hash, map->line_buf, line, pos - line, 0) != PARSER_OK)
+      continue;
+
+    if (!parsed)
+      crack->hash_len = (u32) (pos - line);
+
+    parsed = 1;
+
+    const u64 key_idx = hc_user_map_find (map, hc_user_key (hashconfig, &map->hash));
+
+    if ((key_idx == HC_USER_UNMATCHED) || (!hc_user_map_confirm (map, key_idx)))
+      continue;
+
+    crack->hash_len = (u32) (pos - line);
+    crack->key_idx  = key_idx;
+
+    break;
+  }
+
+  if (crack->key_idx == HC_USER_UNMATCHED)
+    map->unmatched++;
+
+  memcpy (map->text + map->text_len, line, len);
+
+  map->text_len += len;
+  map->cracks_cnt++;
+
+  pthread_mutex_unlock (&map->lock);
+
+}
+
+typedef struct hc_user_entry
+{
+
+  u64 key;
+  u64 off;
+  u64 len;
+  u64 hash_len;
+
+} hc_user_entry_t;
+
+typedef struct hc_user_chunk
+{
+
+  const char *base;
+  const char *buf;
+  size_t len;
+  const hashconfig_t *hashconfig;
+
+  hc_user_entry_t *entries;
+  size_t cnt;
+  size_t alloc;
+
+  u64 names_len;
+  u64 hashes_len;
+  u64 invalid;
+
+  int failed;
+
+} hc_user_chunk_t;
+
+static void *hc_user_parse_thread (void *params)
+{
+
+  hc_user_chunk_t *chunk = (hc_user_chunk_t *) params;
+
+  const hashconfig_t *hashconfig = chunk->hashconfig;
+
+  hash_t hash;
+
+  char *line_buf = (char *) malloc (HCBUFSIZ_LARGE);
+
+  if ((hc_hash_scratch_init (&hash, hashconfig) == -1) || (line_buf == NULL))
+  {
+    chunk->failed = 1;
+    free (line_buf);
+    hc_hash_scratch_destroy (&hash);
+    return NULL;
+  }
+
+  const char *pos = chunk->buf;
+  const char *end = chunk->buf + chunk->len;
+
+  while (pos < end)
+  {
+
+    const char *line = pos;
+    size_t line_len;
+
+    pos = hc_next_line (pos, end, &line_len);
+
+    if (line_len == 0)
+      continue;
+
+    if (hc_parse_line (hashconfig, &hash, line_buf, line, line_len, 1) != PARSER_OK)
+    {
+      chunk->invalid++;
+      continue;
+    }
+
+    if (chunk->cnt == chunk->alloc)
+    {
+
+      const size_t alloc = (chunk->alloc == 0) ? 4096 : chunk->alloc * 2;
+
+      hc_user_entry_t *entries = (hc_user_entry_t *) realloc (chunk->entries, alloc * sizeof (hc_user_entry_t));
+
+      if (entries == NULL)
+      {
+        chunk->failed = 1;
+        break;
+      }
+
+      chunk->entries = entries;
+      chunk->alloc   = alloc;
+    }
+
+    const char *sep = (const char *) memchr (line, hashconfig->separator, line_len);
+
+    hc_user_entry_t *entry = &chunk->entries[chunk->cnt++];
+
+    entry->key      = hc_user_key (hashconfig, &hash);
+    entry->off      = line - chunk->base;
+    entry->len      = sep - line;
+    entry->hash_len = line_len - entry->len - 1;
+
+    chunk->names_len  += entry->len;
+    chunk->hashes_len += entry->hash_len;
+  }
+
+  hc_hash_scratch_destroy (&hash);
+  free (line_buf);
+
+  return NULL;
+
+}
+
+/* LSD radix sort of the entries on their key, 16 bits a pass. Stable, so accounts sharing a digest keep
+   their hashlist order */
+
+static int hc_user_sort (hc_user_entry_t * entries, const size_t cnt)
+{
+
+  hc_user_entry_t *tmp = (hc_user_entry_t *) malloc (cnt * sizeof (hc_user_entry_t));
+  size_t *hist = (size_t *) malloc (65536 * sizeof (size_t));
+
+  if ((tmp == NULL) || (hist == NULL))
+  {
+    free (tmp);
+    free (hist);
+    return -1;
+  }
+
+  hc_user_entry_t *src = entries;
+  hc_user_entry_t *dst = tmp;
+
+  for (int shift = 0; shift < 64; shift += 16)
+  {
+
+    memset (hist, 0, 65536 * sizeof (size_t));
+
+    for (size_t i = 0; i < cnt; i++)
+      hist[(src[i].key >> shift) & 0xffff]++;
+
+    size_t sum = 0;
+
+    for (size_t d = 0; d < 65536; d++)
+    {
+      const size_t n = hist[d];
+
+      hist[d] = sum;
+      sum += n;
+    }
+
+    for (size_t i = 0; i < cnt; i++)
+      dst[hist[(src[i].key >> shift) & 0xffff]++] = src[i];
+
+    hc_user_entry_t *swap = src;
+
+    src = dst;
+    dst = swap;
+  }
+
+  // An even number of passes leaves the result in entries
+  free (tmp);
+  free (hist);
+
+  return 0;
+
+}
+
+/* Lay the sorted entries out as the map's arrays, copying the names into the arena in key order and
+   the hash text of each key's first entry next to them */
+
+static int hc_user_map_build (hc_user_map_t * map, const char *base, const hc_user_entry_t * entries, const size_t cnt, const u64 names_len, const u64 hashes_len)
+{
+
+  map->names    = (char *) malloc (names_len ? names_len : 1);
+  map->hashes   = (char *) malloc (hashes_len ? hashes_len : 1);
+  map->name_off = (u64 *) malloc ((cnt ? cnt : 1) * sizeof (u64));
+  map->name_len = (u32 *) malloc ((cnt ? cnt : 1) * sizeof (u32));
+
+  size_t keys_cnt = 0;
+
+  for (size_t i = 0; i < cnt; i++)
+    if ((i == 0) || (entries[i].key != entries[i - 1].key))
+      keys_cnt++;
+
+  map->keys     = (u64 *) malloc ((keys_cnt ? keys_cnt : 1) * sizeof (u64));
+  map->first    = (u64 *) malloc ((keys_cnt + 1) * sizeof (u64));
+  map->hash_off = (u64 *) malloc ((keys_cnt + 1) * sizeof (u64));
+
+  if ((map->names == NULL) || (map->hashes == NULL) || (map->name_off == NULL) || (map->name_len == NULL) || (map->keys == NULL) || (map->first == NULL) || (map->hash_off == NULL))
+    return -1;
+
+  u64 k = 0;
+  u64 hashes_pos = 0;
+
+  for (size_t i = 0; i < cnt; i++)
+  {
+
+    if ((i == 0) || (entries[i].key != entries[i - 1].key))
+    {
+      map->keys[k]     = entries[i].key;
+      map->first[k]    = i;
+      map->hash_off[k] = hashes_pos;
+
+      memcpy (map->hashes + hashes_pos, base + entries[i].off + entries[i].len + 1, entries[i].hash_len);
+
+      hashes_pos += entries[i].hash_len;
+
+      k++;
+    }
+
+    memcpy (map->names + map->names_len, base + entries[i].off, entries[i].len);
+
+    map->name_off[i] = map->names_len;
+    map->name_len[i] = (u32) entries[i].len;
+
+    map->names_len += entries[i].len;
+  }
+
+  map->first[keys_cnt]    = cnt;
+  map->hash_off[keys_cnt] = hashes_pos;
+
+  map->keys_cnt     = keys_cnt;
+  map->accounts_cnt = cnt;
+
+  return 0;
+
+}
+
+PyDoc_STRVAR(load_user_map__doc__,
+"load_user_map(source=None, threads=0) -> (accounts, digests, invalid)\n\n\
+Map every digest of a username:hash list to the usernames sharing it, so cracks\n\
+can be returned per account by cracked_users.\n\n\
+source\t\tstr|list|buffer\tHashlist with a username field, defaults to the hash attribute\n\
+threads\t\tint\t\tParser threads, 0 uses every online CPU\n\n\
+Lines are parsed with the parser of the hash_mode attribute, using the separator and\n\
+hex_salt attributes. Usernames are kept back to back in a single buffer with offset\n\
+arrays next to the sorted digest keys, with the hash text of one line per digest.\n\
+Keys are 64 bit hashes of digest, salt and esalt, a crack matches a key only once its\n\
+decoded digest, salt and esalt equal those of the stored hash. Loading replaces the\n\
+previous map and its cracks. Return the number of accounts, distinct digests and\n\
+unparsable lines.\n\n");
+
+static PyObject *hashcat_load_user_map (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *source = Py_None;
+  int threads = 0;
+  static char *kwlist[] = {"source", "threads", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Oi", kwlist, &source, &threads)) 
+  {
+    return NULL;
+  }
+
+  if (hashcat_session_running (self))
+  {
+    PyErr_SetString (PyExc_RuntimeError, "Cannot load a user map while a session is running");
+    return NULL;
+  }
+
+  if (source == Py_None)
+  {
+
+    if (self->hash == NULL)
+    {
+      PyErr_SetString (PyExc_ValueError, "No source given and the hash attribute is not set");
+      return NULL;
+    }
+
+    if (self->hash_fd != -1)
+    {
+      char path[32];
+
+      hc_memfd_path (self->hash_fd, path, sizeof (path));
+
+      source = PyString_FromString (path);
+    }
+    else
+    {
+      source = self->hash;
+
+      Py_INCREF (source);
+    }
+
+    if (source == NULL)
+      return NULL;
+  }
+  else
+  {
+    Py_INCREF (source);
+  }
+
+  hc_user_map_t *map = (hc_user_map_t *) calloc (1, sizeof (hc_user_map_t));
+
+  if (map == NULL)
+  {
+    Py_DECREF (source);
+    return PyErr_NoMemory ();
+  }
+
+  pthread_mutex_init (&map->lock, NULL);
+
+  map->refs = 1;
+
+  map->hashcat_ctx = hc_hashconfig_open_parse (self->user_options->hash_mode, self->user_options->separator, self->user_options->hex_salt);
+
+  if (map->hashcat_ctx == NULL)
+  {
+    Py_DECREF (source);
+    hc_user_map_free (map);
+    return NULL;
+  }
+
+  const hashconfig_t *hashconfig = map->hashcat_ctx->hashconfig;
+
+  map->line_buf = (char *) malloc (HCBUFSIZ_LARGE);
+
+  if ((hc_hash_scratch_init (&map->hash, hashconfig) == -1) || (hc_hash_scratch_init (&map->stored, hashconfig) == -1) || (map->line_buf == NULL))
+  {
+    Py_DECREF (source);
+    hc_user_map_free (map);
+    return PyErr_NoMemory ();
+  }
+
+  if (hashconfig->opts_type & OPTS_TYPE_BINARY_HASHFILE)
+  {
+    Py_DECREF (source);
+    hc_user_map_free (map);
+
+    PyErr_Format (PyExc_ValueError, "hash_mode %u uses binary hash files and has no username field", self->user_options->hash_mode);
+    return NULL;
+  }
+
+  hc_source_map_t src;
+
+  const int rc = hc_source_map_open (source, &src);
+
+  Py_DECREF (source);
+
+  if (rc == -1)
+  {
+    hc_user_map_free (map);
+    return NULL;
+  }
+
+  cpu_set_t cpus;
+
+  const int pinned = hashcat_placement (self, &cpus);
+
+  if (pinned == -1)
+  {
+    hc_source_map_close (&src);
+    hc_user_map_free (map);
+    return NULL;
+  }
+
+  threads = hc_threads_default (threads);
+
+  if ((size_t) threads > src.len / 4096 + 1)
+    threads = (int) (src.len / 4096 + 1);
+
+  size_t *offsets = (size_t *) calloc (threads + 1, sizeof (size_t));
+  hc_user_chunk_t *chunks = (hc_user_chunk_t *) calloc (threads, sizeof (hc_user_chunk_t));
+
+  int failed = ((offsets == NULL) || (chunks == NULL));
+
+  u64 invalid = 0;
+
+  if (!failed)
+  {
+
+    hc_split_lines (src.buf, src.len, threads, offsets);
+
+    for (int i = 0; i < threads; i++)
+    {
+      chunks[i].base       = src.buf;
+      chunks[i].buf        = src.buf + offsets[i];
+      chunks[i].len        = offsets[i + 1] - offsets[i];
+      chunks[i].hashconfig = hashconfig;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+
+    hc_run_threads (hc_user_parse_thread, chunks, sizeof (hc_user_chunk_t), threads, (pinned) ? &cpus : NULL);
+
+    size_t cnt = 0;
+    u64 names_len = 0;
+    u64 hashes_len = 0;
+
+    for (int i = 0; i < threads; i++)
+    {
+      failed     |= chunks[i].failed;
+      cnt        += chunks[i].cnt;
+      names_len  += chunks[i].names_len;
+      hashes_len += chunks[i].hashes_len;
+      invalid    += chunks[i].invalid;
+    }
+
+    hc_user_entry_t *entries = NULL;
+
+    if (!failed)
+    {
+
+      entries = (hc_user_entry_t *) malloc ((cnt ? cnt : 1) * sizeof (hc_user_entry_t));
+
+      failed = (entries == NULL);
+    }
+
+    if (!failed)
+    {
+
+      size_t pos = 0;
+
+      for (int i = 0; i < threads; i++)
+      {
+        memcpy (entries + pos, chunks[i].entries, chunks[i].cnt * sizeof (hc_user_entry_t));
+
+        pos += chunks[i].cnt;
+
+        free (chunks[i].entries);
+
+        chunks[i].entries = NULL;
+      }
+
+      failed = (hc_user_sort (entries, cnt) == -1) || (hc_user_map_build (map, src.buf, entries, cnt, names_len, hashes_len) == -1);
+    }
+
+    free (entries);
+
+    Py_END_ALLOW_THREADS
+  }
+
+  for (int i = 0; (chunks != NULL) && (i < threads); i++)
+    free (chunks[i].entries);
+
+  free (offsets);
+  free (chunks);
+
+  hc_source_map_close (&src);
+
+  if (failed)
+  {
+    hc_user_map_free (map);
+    return PyErr_NoMemory ();
+  }
+
+  hc_user_map_t *old = self->user_map;
+
+  self->user_map = map;
+
+  if (old != NULL)
+    hc_user_map_release (old);
+
+  return Py_BuildValue ("(KKK)", (unsigned long long) map->accounts_cnt, (unsigned long long) map->keys_cnt, (unsigned long long) invalid);
+
+}
+
+PyDoc_STRVAR(cracked_users__doc__,
+"cracked_users(start=0, limit=-1) -> list\n\n\
+Return (username, hash, plain) rows for the cracks received since load_user_map.\n\n\
+start\tint\tFirst crack, cracks are numbered in the order they arrived\n\
+limit\tint\tMaximum number of cracks, -1 for all\n\n\
+A crack of a digest shared by several accounts gives one row per account. Cracks\n\
+that do not match the map give a single row with username None. Rows reflect\n\
+hashcat's outfile lines, so outfile_format must stay at its default (hash:plain).\n\
+Sessions run with username on report user:hash:plain, the user field is dropped\n\
+and the accounts come from the map.\n\
+Poll with start set to the previous user_map_info()['cracks'] to get new rows only.\n\n");
+
+static PyObject *hashcat_cracked_users (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  Py_ssize_t start = 0;
+  Py_ssize_t limit = -1;
+  static char *kwlist[] = {"start", "limit", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|nn", kwlist, &start, &limit)) 
+  {
+    return NULL;
+  }
+
+  hc_user_map_t *map = self->user_map;
+
+  if (map == NULL)
+  {
+    PyErr_SetString (PyExc_RuntimeError, "No user map loaded");
+    return NULL;
+  }
+
+  if (start < 0)
+  {
+    PyErr_SetString (PyExc_ValueError, "start must not be negative");
+    return NULL;
+  }
+
+  // Keeps the map alive while the GIL is released, clear_user_map may run meanwhile
+  map->refs++;
+
+  hc_user_crack_t *cracks = NULL;
+  char *text = NULL;
+  u64 cnt = 0;
+  u64 text_base = 0;
+  int failed = 0;
+
+  // Copy the requested cracks under the lock with the GIL released, python objects are only made once
+  // it is dropped. The session thread appends under the same lock, names and keys never change
+  Py_BEGIN_ALLOW_THREADS
+
+  pthread_mutex_lock (&map->lock);
+
+  u64 end = map->cracks_cnt;
+
+  if ((limit >= 0) && ((u64) start + (u64) limit < end))
+    end = (u64) start + (u64) limit;
+
+  if ((u64) start < end)
+  {
+
+    cnt       = end - (u64) start;
+    text_base = map->cracks[start].text_off;
+
+    const u64 text_len = map->cracks[end - 1].text_off + map->cracks[end - 1].text_len - text_base;
+
+    cracks = (hc_user_crack_t *) malloc (cnt * sizeof (hc_user_crack_t));
+    text   = (char *) malloc (text_len + 1);
+
+    failed = (cracks == NULL) || (text == NULL);
+
+    if (!failed)
+    {
+      memcpy (cracks, map->cracks + start, cnt * sizeof (hc_user_crack_t));
+      memcpy (text, map->text + text_base, text_len);
+    }
+  }
+
+  pthread_mutex_unlock (&map->lock);
+
+  Py_END_ALLOW_THREADS
+
+  PyObject *rows = (failed) ? PyErr_NoMemory () : PyList_New (0);
+
+  for (u64 i = 0; (i < cnt) && (rows != NULL); i++)
+  {
+
+    const hc_user_crack_t *crack = &cracks[i];
+
+    const char *line = text + (crack->text_off - text_base);
+
+    const u32 plain_off = (crack->hash_len < crack->text_len) ? crack->hash_len + 1 : crack->text_len;
+
+    PyObject *hash  = PyString_FromStringAndSize (line, crack->hash_len);
+    PyObject *plain = PyString_FromStringAndSize (line + plain_off, crack->text_len - plain_off);
+
+    const u64 first = (crack->key_idx == HC_USER_UNMATCHED) ? 0 : map->first[crack->key_idx];
+    const u64 last  = (crack->key_idx == HC_USER_UNMATCHED) ? 1 : map->first[crack->key_idx + 1];
+
+    for (u64 j = first; (j < last) && (hash != NULL) && (plain != NULL); j++)
+    {
+
+      PyObject *row;
+
+      if (crack->key_idx == HC_USER_UNMATCHED)
+        row = Py_BuildValue ("(OOO)", Py_None, hash, plain);
+      else
+        row = Py_BuildValue ("(s#OO)", map->names + map->name_off[j], (Py_ssize_t) map->name_len[j], hash, plain);
+
+      if ((row == NULL) || (PyList_Append (rows, row) == -1))
+      {
+        Py_XDECREF (row);
+        Py_CLEAR (rows);
+        break;
+      }
+
+      Py_DECREF (row);
+    }
+
+    if ((hash == NULL) || (plain == NULL))
+      Py_CLEAR (rows);
+
+    Py_XDECREF (hash);
+    Py_XDECREF (plain);
+  }
+
+  free (cracks);
+  free (text);
+
+  hc_user_map_release (map);
+
+  return rows;
+
+}
+
+PyDoc_STRVAR(user_map_info__doc__,
+"user_map_info() -> dict\n\n\
+Return accounts, digests, names_bytes, cracks and unmatched for the loaded user map.\n\n");
+
+static PyObject *hashcat_user_map_info (hashcatObject * self, PyObject * noargs)
+{
+
+  hc_user_map_t *map = self->user_map;
+
+  if (map == NULL)
+  {
+    PyErr_SetString (PyExc_RuntimeError, "No user map loaded");
+    return NULL;
+  }
+
+  map->refs++;
+
+  u64 cracks;
+  u64 unmatched;
+  int failed;
+
+  // Never wait for the lock with the GIL held, the session thread may hold the lock and want the GIL
+  Py_BEGIN_ALLOW_THREADS
+
+  pthread_mutex_lock (&map->lock);
+
+  cracks    = map->cracks_cnt;
+  unmatched = map->unmatched;
+  failed    = map->failed;
+
+  pthread_mutex_unlock (&map->lock);
+
+  Py_END_ALLOW_THREADS
+
+  PyObject *rtn = NULL;
+
+  if (failed)
+    PyErr_SetString (PyExc_MemoryError, "Cracks were dropped, the user map ran out of memory");
+  else
+    rtn = Py_BuildValue ("{s:K,s:K,s:K,s:K,s:K}",
+      "accounts",    (unsigned long long) map->accounts_cnt,
+      "digests",     (unsigned long long) map->keys_cnt,
+      "names_bytes", (unsigned long long) map->names_len,
+      "cracks",      (unsigned long long) cracks,
+      "unmatched",   (unsigned long long) unmatched);
+
+  hc_user_map_release (map);
+
+  return rtn;
+
+}
+
+PyDoc_STRVAR(clear_user_map__doc__,
+"clear_user_map()\n\n\
+Release the user map and its cracks.\n\n");
+
+static PyObject *hashcat_clear_user_map (hashcatObject * self, PyObject * noargs)
+{
+
+  if (hashcat_session_running (self))
+  {
+    PyErr_SetString (PyExc_RuntimeError, "Cannot release the user map while a session is running");
+    return NULL;
+  }
+
+  if (self->user_map != NULL)
+  {
+    hc_user_map_release (self->user_map);
+
+    self->user_map = NULL;
+  }
+
+  Py_INCREF (Py_None);
+  return Py_None;
+
+}
+
+typedef struct hc_widx_chunk
+{
+
+  const char *base;
+  size_t off;
+  size_t len;
+  u32 stride;
+  int pass;
+
+  // words inside the chunk on the first pass, words before it on the second
+  u64 words;
+  u64 *entries;
+
+} hc_widx_chunk_t;
+
+/* Chunks end at line ends. The first pass counts words, the second records the line offset of every
+   stride-th word */
+
+static void *hc_widx_thread (void *params)
+{
+
+  hc_widx_chunk_t *chunk = (hc_widx_chunk_t *) params;
+
+  const char *pos = chunk->base + chunk->off;
+  const char *end = pos + chunk->len;
+
+  u64 word = (chunk->pass == 1) ? 0 : chunk->words;
+
+  while (pos < end)
+  {
+
+    const char *line = pos;
+    size_t len;
+
+    pos = hc_next_line (pos, end, &len);
+
+    // Same rule as hc_dictstat_count_thread, hashcat does not count longer lines as words
+    if (len >= PW_MAX)
+      continue;
+
+    if ((chunk->pass == 2) && ((word % chunk->stride) == 0))
+      chunk->entries[word / chunk->stride] = line - chunk->base;
+
+    word++;
+  }
+
+  if (chunk->pass == 1)
+    chunk->words = word;
+
+  return NULL;
+
+}
+
+PyDoc_STRVAR(index_wordlist__doc__,
+"index_wordlist(path, stride=65536, threads=0, slice_max=268435456) -> (words, entries, cached)\n\n\
+Write the word index a straight attack uses to start at skip without scanning dict1.\n\n\
+path\t\tstr\tWordlist to index, the index is written next to it as <path>.pyhcwidx\n\
+stride\t\tint\tWords between indexed offsets\n\
+threads\t\tint\tIndexer threads, 0 uses every online CPU\n\
+slice_max\tint\tRAM in bytes a session may spend on a copy of its shard, 0 never copies\n\n\
+Words are counted as hashcat counts them for skip and limit: every line shorter\n\
+than the maximum password length once a trailing CR is dropped. The index holds the\n\
+byte offset of every stride-th word and a content hash of the wordlist. It is tied\n\
+to the wordlist's inode, size and mtime; an index that no longer matches is ignored.\n\n\
+hashcat 5 can only read a wordlist from its start. When a straight attack sets skip\n\
+and limit and dict1 has a current index, the shard from the indexed word at or\n\
+before skip up to the indexed word at or after limit is copied into an anonymous\n\
+memory file and hashcat gets that copy, with skip and limit adjusted to match.\n\
+The copy costs up to slice_max bytes of RAM for the whole session, and reading it\n\
+costs a pass over the shard. A larger shard is not copied and hashcat reads dict1\n\
+itself. The copy is a new file to hashcat's dictstat cache, so every such session\n\
+counts the shard's words again and adds a dictstat entry. Status progress is\n\
+relative to the copy and skip/limit read back adjusted while the session runs.\n\
+Return the number of words, indexed offsets and whether a current index with the\n\
+same stride and slice_max was already in place.\n\n");
+
+static PyObject *hashcat_index_wordlist (PyObject * cls, PyObject * args, PyObject * kwargs)
+{
+
+  char *path;
+  unsigned int stride = 65536;
+  int threads = 0;
+  unsigned long long slice_max = HC_WIDX_SLICE_MAX;
+  static char *kwlist[] = {"path", "stride", "threads", "slice_max", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|IiK", kwlist, &path, &stride, &threads, &slice_max)) 
+  {
+    return NULL;
+  }
+
+  if (stride == 0)
+  {
+    PyErr_SetString (PyExc_ValueError, "stride must be at least 1");
+    return NULL;
+  }
+
+  char idx_path[PATH_MAX];
+
+  if (hc_widx_path (path, idx_path, sizeof (idx_path)) == -1)
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, path);
+
+  const int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, path);
+
+  struct stat st;
+
+  if (fstat (fd, &st) == -1)
+  {
+    close (fd);
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, path);
+  }
+
+  if (!S_ISREG (st.st_mode))
+  {
+    close (fd);
+
+    PyErr_Format (PyExc_ValueError, "%s is not a regular file", path);
+    return NULL;
+  }
+
+  hc_widx_t idx;
+
+  if ((hc_widx_open (path, &st, &idx) == 1) && (idx.hdr->stride == stride) && (idx.hdr->slice_max == slice_max))
+  {
+    PyObject *rtn = Py_BuildValue ("(KKO)", (unsigned long long) idx.hdr->words, (unsigned long long) idx.hdr->entries_cnt, Py_True);
+
+    hc_widx_close (&idx);
+    close (fd);
+
+    return rtn;
+  }
+
+  const size_t size = st.st_size;
+
+  const char *base = NULL;
+
+  if (size > 0)
+  {
+
+    void *addr = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (addr == MAP_FAILED)
+    {
+      close (fd);
+      return PyErr_SetFromErrnoWithFilename (PyExc_IOError, path);
+    }
+
+    madvise (addr, size, MADV_SEQUENTIAL);
+
+    base = (const char *) addr;
+  }
+
+  threads = hc_line_threads (size, hc_threads_default (threads));
+
+  hc_widx_chunk_t *chunks = (hc_widx_chunk_t *) calloc (threads, sizeof (hc_widx_chunk_t));
+  size_t *offsets = (size_t *) calloc (threads + 1, sizeof (size_t));
+
+  hc_widx_header_t hdr;
+
+  memset (&hdr, 0, sizeof (hdr));
+
+  u64 *entries = NULL;
+
+  int rc = ((chunks == NULL) || (offsets == NULL)) ? -1 : 0;
+  int saved_errno = 0;
+
+  char tmp_path[PATH_MAX];
+
+  snprintf (tmp_path, sizeof (tmp_path), "%s.%d.tmp", idx_path, (int) getpid ());
+
+  Py_BEGIN_ALLOW_THREADS
+
+  if (rc == 0)
+  {
+
+    hc_split_lines (base, size, threads, offsets);
+
+    for (int i = 0; i < threads; i++)
+    {
+      chunks[i].base   = base;
+      chunks[i].off    = offsets[i];
+      chunks[i].len    = offsets[i + 1] - offsets[i];
+      chunks[i].stride = stride;
+      chunks[i].pass   = 1;
+    }
+
+    hc_run_threads (hc_widx_thread, chunks, sizeof (hc_widx_chunk_t), threads, NULL);
+
+    u64 words = 0;
+
+    for (int i = 0; i < threads; i++)
+    {
+      const u64 n = chunks[i].words;
+
+      chunks[i].words = words;
+      words += n;
+    }
+
+    hdr.words = words;
+
+    hdr.entries_cnt = (hdr.words + stride - 1) / stride;
+
+    entries = (u64 *) calloc (hdr.entries_cnt + 1, sizeof (u64));
+
+    if (entries == NULL)
+      rc = -1;
+  }
+
+  if (rc == 0)
+  {
+
+    for (int i = 0; i < threads; i++)
+    {
+      chunks[i].entries = entries;
+      chunks[i].pass    = 2;
+    }
+
+    hc_run_threads (hc_widx_thread, chunks, sizeof (hc_widx_chunk_t), threads, NULL);
+
+    memcpy (hdr.magic, HC_WIDX_MAGIC, 8);
+
+    hdr.version    = HC_WIDX_VERSION;
+    hdr.stride     = stride;
+    hdr.slice_max  = slice_max;
+    hdr.file_dev   = st.st_dev;
+    hdr.file_ino   = st.st_ino;
+    hdr.file_size  = st.st_size;
+    hdr.file_mtime = hc_stat_mtime (&st);
+    hdr.checksum   = hc_content_hash (base, size, threads);
+
+    struct stat after;
+
+    // A wordlist written to while it was indexed gets no index
+    if ((fstat (fd, &after) == -1) || ((u64) after.st_size != hdr.file_size) || (hc_stat_mtime (&after) != hdr.file_mtime))
+      rc = -3;
+  }
+
+  if (rc == 0)
+  {
+
+    const int out = open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if ((out == -1)
+     || (hc_write_all (out, (const char *) &hdr, sizeof (hdr)) == -1)
+     || (hc_write_all (out, (const char *) entries, hdr.entries_cnt * sizeof (u64)) == -1)
+     || (close (out) == -1)
+     || (rename (tmp_path, idx_path) == -1))
+    {
+      saved_errno = errno;
+
+      unlink (tmp_path);
+
+      rc = -2;
+    }
+  }
+
+  Py_END_ALLOW_THREADS
+
+  if (base != NULL)
+    munmap ((void *) base, size);
+
+  close (fd);
+  free (chunks);
+  free (offsets);
+  free (entries);
+
+  if (rc == -1)
+    return PyErr_NoMemory ();
+
+  if (rc == -2)
+  {
+    errno = saved_errno;
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, idx_path);
+  }
+
+  if (rc == -3)
+  {
+    PyErr_Format (PyExc_RuntimeError, "%s changed while it was indexed", path);
+    return NULL;
+  }
+
+  return Py_BuildValue ("(KKO)", (unsigned long long) hdr.words, (unsigned long long) hdr.entries_cnt, Py_False);
+
+}
+
+PyDoc_STRVAR(wordlist_index_info__doc__,
+"wordlist_index_info(path) -> dict|None\n\n\
+Return stride, words, entries, slice_max and checksum from the current index of the\n\
+wordlist at path, or None when it has none or it no longer matches. Shards on other\n\
+hosts can compare checksums to make sure they index the same wordlist.\n\n");
+
+static PyObject *hashcat_wordlist_index_info (PyObject * cls, PyObject * args, PyObject * kwargs)
+{
+
+  char *path;
+  static char *kwlist[] = {"path", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s", kwlist, &path)) 
+  {
+    return NULL;
+  }
+
+  struct stat st;
+
+  if (stat (path, &st) == -1)
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, path);
+
+  hc_widx_t idx;
+
+  const int rc = hc_widx_open (path, &st, &idx);
+
+  if (rc == -1)
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, path);
+
+  if (rc == 0)
+  {
+    Py_INCREF (Py_None);
+    return Py_None;
+  }
+
+  PyObject *rtn = Py_BuildValue ("{s:I,s:K,s:K,s:K,s:K}",
+    "stride",    (unsigned int) idx.hdr->stride,
+    "words",     (unsigned long long) idx.hdr->words,
+    "entries",   (unsigned long long) idx.hdr->entries_cnt,
+    "slice_max", (unsigned long long) idx.hdr->slice_max,
+    "checksum",  (unsigned long long) idx.hdr->checksum);
+
+  hc_widx_close (&idx);
+
+  return rtn;
+
+}
+
+/* Wordlist preparation. Lines that pass the length filter are routed by content hash to partitions,
+   held in memory when the inputs fit memory_limit and spilled to unlinked files next to out when
+   they do not, so that every partition is deduplicated on its own. What survives is merged back in
+   input order, or byte order with sort */
+
+#define HC_PREP_SEGMENT_SIZE (16 * 1024 * 1024)
+#define HC_PREP_PARTS_MAX    512
+
+// Records are [u64 seq][u64 hash][u32 len][line], seq is the line's offset in the concatenated inputs
+#define HC_PREP_REC_HDR      20
+
+typedef struct hc_prep_part
+{
+
+  pthread_mutex_t lock;
+
+  int fd;
+  char *buf;
+  size_t len;
+  size_t size;
+
+  // Survivors, record offsets in seq order or lines in byte order, or a run file once spilled
+  size_t *offs;
+  hc_line_t *lines;
+  size_t cnt;
+  FILE *run;
+
+} hc_prep_part_t;
+
+typedef struct hc_prep
+{
+
+  u32 min_len;
+  u32 max_len;
+  int dedup;
+  int sort;
+
+  const char *out_path;
+
+  // placement of the worker threads
+  const cpu_set_t *cpus;
+
+  hc_prep_part_t *parts;
+  u32 parts_cnt;
+  int spill;
+
+  size_t next;
+  int failed;
+
+  // The block being filtered and its offset in the concatenated inputs, records are ordered by offset
+  const char *block;
+  u64 block_seq;
+
+  u64 lines;
+  u64 too_short;
+  u64 too_long;
+  u64 kept;
+  u64 unique;
+
+} hc_prep_t;
+
+typedef struct hc_prep_chunk
+{
+
+  // hc_line_chunk_t head
+  const char *buf;
+  size_t len;
+
+  hc_prep_t *prep;
+
+  // Filtered lines, newline terminated, when there is nothing to deduplicate
+  char *out;
+  size_t out_len;
+
+  u64 lines;
+  u64 too_short;
+  u64 too_long;
+  u64 kept;
+  int failed;
+
+} hc_prep_chunk_t;
+
+typedef struct hc_prep_entry
+{
+
+  u64 hash;
+  u32 off;
+  u32 len;
+  u32 part;
+
+} hc_prep_entry_t;
+
+/* Candidate length as hashcat checks it, $HEX[...] lines count their decoded length */
+
+static size_t hc_prep_line_len (const char *line, const size_t len)
+{
+
+  if ((len >= 6) && (memcmp (line, "$HEX[", 5) == 0) && (line[len - 1] == ']') && (((len - 6) % 2) == 0) && (hc_is_hex (line + 5, len - 6)))
+    return (len - 6) / 2;
+
+  return len;
+
+}
+
+static int hc_prep_append (hc_prep_part_t * part, const char *buf, const size_t len, const int spill)
+{
+
+  if (spill)
+    return hc_write_all (part->fd, buf, len);
+
+  if (part->len + len > part->size)
+  {
+    size_t size = (part->size == 0) ? 65536 : part->size;
+
+    while (part->len + len > size)
+      size *= 2;
+
+    char *tmp = (char *) realloc (part->buf, size);
+
+    if (tmp == NULL)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+    part->buf  = tmp;
+    part->size = size;
+  }
+
+  memcpy (part->buf + part->len, buf, len);
+
+  part->len += len;
+
+  return 0;
+
+}
+
+/* Filter one chunk of lines. Kept lines are grouped by partition so that each partition is locked once */
+
+static void *hc_prep_thread (void *params)
+{
+
+  hc_prep_chunk_t *chunk = (hc_prep_chunk_t *) params;
+  hc_prep_t *prep = chunk->prep;
+
+  const char *pos = chunk->buf;
+  const char *end = chunk->buf + chunk->len;
+
+  hc_prep_entry_t *entries = NULL;
+  size_t entries_cnt = 0;
+  size_t entries_size = 0;
+
+  char *out = NULL;
+
+  if (!prep->dedup)
+  {
+    out = (char *) malloc (chunk->len + 1);
+
+    if (out == NULL)
+    {
+      chunk->failed = ENOMEM;
+      return NULL;
+    }
+  }
+
+  while (pos < end)
+  {
+
+    const char *line = pos;
+    size_t line_len;
+
+    pos = hc_next_line (pos, end, &line_len);
+
+    chunk->lines++;
+
+    const size_t pw_len = hc_prep_line_len (line, line_len);
+
+    if (pw_len < prep->min_len)
+    {
+      chunk->too_short++;
+      continue;
+    }
+
+    if (pw_len > prep->max_len)
+    {
+      chunk->too_long++;
+      continue;
+    }
+
+    chunk->kept++;
+
+    if (out != NULL)
+    {
+      memcpy (out + chunk->out_len, line, line_len);
+
+      chunk->out_len += line_len;
+
+      out[chunk->out_len++] = '\n';
+
+      continue;
+    }
+
+    if (entries_cnt == entries_size)
+    {
+      entries_size = (entries_size == 0) ? 65536 : entries_size * 2;
+
+      hc_prep_entry_t *tmp = (hc_prep_entry_t *) realloc (entries, entries_size * sizeof (hc_prep_entry_t));
+
+      if (tmp == NULL)
+      {
+        free (entries);
+
+        chunk->failed = ENOMEM;
+        return NULL;
+      }
+
+      entries = tmp;
+    }
+
+    hc_prep_entry_t *entry = &entries[entries_cnt++];
+
+    entry->hash = hc_hash64 (line, line_len, 0);
+    entry->off  = (u32) (line - chunk->buf);
+    entry->len  = (u32) line_len;
+    entry->part = (u32) (entry->hash >> 32) & (prep->parts_cnt - 1);
+  }
+
+  if (out != NULL)
+  {
+    chunk->out = out;
+    return NULL;
+  }
+
+  size_t *part_off = (size_t *) calloc (prep->parts_cnt + 1, sizeof (size_t));
+
+  if (part_off == NULL)
+  {
+    free (entries);
+
+    chunk->failed = ENOMEM;
+    return NULL;
+  }
+
+  for (size_t i = 0; i < entries_cnt; i++)
+    part_off[entries[i].part + 1] += HC_PREP_REC_HDR + entries[i].len;
+
+  for (u32 p = 0; p < prep->parts_cnt; p++)
+    part_off[p + 1] += part_off[p];
+
+  char *recs = (char *) malloc (part_off[prep->parts_cnt] + 1);
+
+  if (recs == NULL)
+  {
+    free (part_off);
+    free (entries);
+
+    chunk->failed = ENOMEM;
+    return NULL;
+  }
+
+  for (size_t i = 0; i < entries_cnt; i++)
+  {
+    const hc_prep_entry_t *entry = &entries[i];
+
+    char *rec = recs + part_off[entry->part];
+
+    const u64 seq = prep->block_seq + (u64) (chunk->buf - prep->block) + entry->off;
+
+    memcpy (rec,      &seq,         8);
+    memcpy (rec + 8,  &entry->hash, 8);
+    memcpy (rec + 16, &entry->len,  4);
+    memcpy (rec + HC_PREP_REC_HDR, chunk->buf + entry->off, entry->len);
+
+    part_off[entry->part] += HC_PREP_REC_HDR + entry->len;
+  }
+
+  // part_off[p] now ends partition p
+  size_t start = 0;
+
+  for (u32 p = 0; p < prep->parts_cnt; p++)
+  {
+
+    const size_t len = part_off[p] - start;
+
+    if (len > 0)
+    {
+      hc_prep_part_t *part = &prep->parts[p];
+
+      pthread_mutex_lock (&part->lock);
+
+      if (hc_prep_append (part, recs + start, len, prep->spill) == -1)
+        chunk->failed = errno;
+
+      pthread_mutex_unlock (&part->lock);
+    }
+
+    start = part_off[p];
+  }
+
+  free (recs);
+  free (part_off);
+  free (entries);
+
+  return NULL;
+
+}
+
+typedef struct hc_prep_seq
+{
+
+  u64 seq;
+  size_t off;
+
+} hc_prep_seq_t;
+
+static int hc_prep_seq_cmp (const void *a, const void *b)
+{
+
+  const u64 sa = ((const hc_prep_seq_t *) a)->seq;
+  const u64 sb = ((const hc_prep_seq_t *) b)->seq;
+
+  return (sa < sb) ? -1 : (sa > sb);
+
+}
+
+static u64 hc_prep_rec_seq (const char *rec)
+{
+
+  u64 seq;
+
+  memcpy (&seq, rec, 8);
+
+  return seq;
+
+}
+
+static u32 hc_prep_rec_len (const char *rec)
+{
+
+  u32 len;
+
+  memcpy (&len, rec + 16, 4);
+
+  return len;
+
+}
+
+/* Deduplicate one partition, keeping the first occurrence of every line, and order what is left */
+
+static int hc_prep_dedup_part (hc_prep_t * prep, hc_prep_part_t * part)
+{
+
+  if (prep->spill)
+  {
+
+    const off_t size = lseek (part->fd, 0, SEEK_END);
+
+    if (size == -1)
+      return -1;
+
+    part->buf  = (char *) malloc ((size_t) size + 1);
+    part->len  = (size_t) size;
+    part->size = (size_t) size + 1;
+
+    if (part->buf == NULL)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+    size_t done = 0;
+
+    while (done < part->len)
+    {
+      const ssize_t n = pread (part->fd, part->buf + done, part->len - done, done);
+
+      if ((n == -1) && (errno == EINTR))
+        continue;
+
+      if (n <= 0)
+      {
+        if (n == 0)
+          errno = EIO;
+
+        return -1;
+      }
+
+      done += n;
+    }
+
+    hc_fd_close (&part->fd);
+  }
+
+  size_t cnt = 0;
+
+  for (size_t off = 0; off < part->len; off += HC_PREP_REC_HDR + hc_prep_rec_len (part->buf + off))
+    cnt++;
+
+  size_t slots = 16;
+
+  while (slots < cnt * 2)
+    slots *= 2;
+
+  // Open addressing over record offsets, 0 marks a free slot
+  size_t *table = (size_t *) calloc (slots, sizeof (size_t));
+
+  if (table == NULL)
+  {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  size_t unique = 0;
+
+  for (size_t off = 0; off < part->len; off += HC_PREP_REC_HDR + hc_prep_rec_len (part->buf + off))
+  {
+
+    const char *rec = part->buf + off;
+
+    u64 hash;
+
+    memcpy (&hash, rec + 8, 8);
+
+    const u32 len = hc_prep_rec_len (rec);
+
+    size_t slot = (size_t) hash & (slots - 1);
+
+    for (;;)
+    {
+
+      if (table[slot] == 0)
+      {
+        table[slot] = off + 1;
+
+        unique++;
+        break;
+      }
+
+      const char *other = part->buf + table[slot] - 1;
+
+      if ((memcmp (other + 8, rec + 8, 8) == 0) && (hc_prep_rec_len (other) == len) && (memcmp (other + HC_PREP_REC_HDR, rec + HC_PREP_REC_HDR, len) == 0))
+      {
+        // Threads append to a partition in any order
+        if (hc_prep_rec_seq (rec) < hc_prep_rec_seq (other))
+          table[slot] = off + 1;
+
+        break;
+      }
+
+      slot = (slot + 1) & (slots - 1);
+    }
+  }
+
+  int rc = 0;
+
+  if (prep->sort)
+  {
+    part->lines = (hc_line_t *) malloc ((unique + 1) * sizeof (hc_line_t));
+
+    if (part->lines == NULL)
+      rc = -1;
+
+    for (size_t s = 0, i = 0; (rc == 0) && (s < slots); s++)
+    {
+      if (table[s] == 0)
+        continue;
+
+      const char *rec = part->buf + table[s] - 1;
+
+      part->lines[i].buf = rec + HC_PREP_REC_HDR;
+      part->lines[i].len = hc_prep_rec_len (rec);
+
+      i++;
+    }
+
+    if (rc == 0)
+      qsort (part->lines, unique, sizeof (hc_line_t), hc_line_cmp);
+  }
+  else
+  {
+    hc_prep_seq_t *seqs = (hc_prep_seq_t *) malloc ((unique + 1) * sizeof (hc_prep_seq_t));
+
+    part->offs = (size_t *) malloc ((unique + 1) * sizeof (size_t));
+
+    if ((seqs == NULL) || (part->offs == NULL))
+      rc = -1;
+
+    for (size_t s = 0, i = 0; (rc == 0) && (s < slots); s++)
+    {
+      if (table[s] == 0)
+        continue;
+
+      seqs[i].off = table[s] - 1;
+      seqs[i].seq = hc_prep_rec_seq (part->buf + seqs[i].off);
+
+      i++;
+    }
+
+    if (rc == 0)
+    {
+      qsort (seqs, unique, sizeof (hc_prep_seq_t), hc_prep_seq_cmp);
+
+      for (size_t i = 0; i < unique; i++)
+        part->offs[i] = seqs[i].off;
+    }
+
+    free (seqs);
+  }
+
+  free (table);
+
+  if (rc == -1)
+  {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  part->cnt = unique;
+
+  __sync_fetch_and_add (&prep->unique, unique);
+
+  if (!prep->spill)
+    return 0;
+
+  // Spilled partitions leave a run file behind, survivor records in seq order or sorted lines
+  char run_path[PATH_MAX];
+
+  snprintf (run_path, sizeof (run_path), "%s.run%u.%d.tmp", prep->out_path, (unsigned int) (part - prep->parts), (int) getpid ());
+
+  const int run_fd = open (run_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+  if (run_fd == -1)
+    return -1;
+
+  unlink (run_path);
+
+  part->run = fdopen (run_fd, "w+b");
+
+  if (part->run == NULL)
+  {
+    close (run_fd);
+    return -1;
+  }
+
+  setvbuf (part->run, NULL, _IOFBF, 1024 * 1024);
+
+  for (size_t i = 0; i < unique; i++)
+  {
+    if (prep->sort)
+    {
+      fwrite (part->lines[i].buf, 1, part->lines[i].len, part->run);
+      fputc ('\n', part->run);
+    }
+    else
+    {
+      const char *rec = part->buf + part->offs[i];
+
+      fwrite (rec, 1, HC_PREP_REC_HDR + hc_prep_rec_len (rec), part->run);
+    }
+  }
+
+  if ((fflush (part->run) != 0) || (ferror (part->run)) || (fseek (part->run, 0, SEEK_SET) == -1))
+    return -1;
+
+  free (part->buf);
+  free (part->offs);
+  free (part->lines);
+
+  part->buf   = NULL;
+  part->offs  = NULL;
+  part->lines = NULL;
+
+  return 0;
+
+}
+
+static void *hc_prep_dedup_thread (void *params)
+{
+
+  hc_prep_t *prep = *(hc_prep_t **) params;
+
+  for (;;)
+  {
+
+    const size_t p = __sync_fetch_and_add (&prep->next, 1);
+
+    if ((p >= prep->parts_cnt) || (prep->failed != 0))
+      break;
+
+    if (hc_prep_dedup_part (prep, &prep->parts[p]) == -1)
+      __sync_bool_compare_and_swap (&prep->failed, 0, errno);
+  }
+
+  return NULL;
+
+}
+
+/* A partition's survivors in seq order, from memory or from its run file */
+
+typedef struct hc_prep_src
+{
+
+  hc_prep_part_t *part;
+  size_t pos;
+
+  char *buf;
+  size_t buf_size;
+
+  u64 seq;
+  const char *line;
+  u32 len;
+
+} hc_prep_src_t;
+
+static int hc_prep_src_next (hc_prep_src_t * src)
+{
+
+  const char *rec;
+
+  if (src->part->run == NULL)
+  {
+    if (src->pos == src->part->cnt)
+      return 0;
+
+    rec = src->part->buf + src->part->offs[src->pos++];
+
+    src->len = hc_prep_rec_len (rec);
+  }
+  else
+  {
+    char hdr[HC_PREP_REC_HDR];
+
+    if (fread (hdr, 1, HC_PREP_REC_HDR, src->part->run) != HC_PREP_REC_HDR)
+      return 0;
+
+    src->len = hc_prep_rec_len (hdr);
+
+    if (HC_PREP_REC_HDR + src->len > src->buf_size)
+    {
+      const size_t size = (HC_PREP_REC_HDR + src->len) * 2;
+
+      char *tmp = (char *) realloc (src->buf, size);
+
+      if (tmp == NULL)
+        return -1;
+
+      src->buf      = tmp;
+      src->buf_size = size;
+    }
+
+    memcpy (src->buf, hdr, HC_PREP_REC_HDR);
+
+    if (fread (src->buf + HC_PREP_REC_HDR, 1, src->len, src->part->run) != src->len)
+      return 0;
+
+    rec = src->buf;
+  }
+
+  src->seq  = hc_prep_rec_seq (rec);
+  src->line = rec + HC_PREP_REC_HDR;
+
+  return 1;
+
+}
+
+/* Merge the partitions into fp by seq. Return 0 or -1 */
+
+static int hc_prep_merge_seq (hc_prep_t * prep, FILE * fp)
+{
+
+  hc_prep_src_t *srcs = (hc_prep_src_t *) calloc (prep->parts_cnt, sizeof (hc_prep_src_t));
+  size_t *heap = (size_t *) malloc ((prep->parts_cnt + 1) * sizeof (size_t));
+
+  if ((srcs == NULL) || (heap == NULL))
+  {
+    free (srcs);
+    free (heap);
+    return -1;
+  }
+
+  int rc = 0;
+
+  size_t heap_cnt = 0;
+
+  for (size_t i = 0; i < prep->parts_cnt; i++)
+  {
+
+    srcs[i].part = &prep->parts[i];
+
+    const int n = hc_prep_src_next (&srcs[i]);
+
+    if (n == -1)
+      rc = -1;
+
+    if (n != 1)
+      continue;
+
+    size_t c = heap_cnt++;
+
+    while ((c > 0) && (srcs[i].seq < srcs[heap[(c - 1) / 2]].seq))
+    {
+      heap[c] = heap[(c - 1) / 2];
+      c = (c - 1) / 2;
+    }
+
+    heap[c] = i;
+  }
+
+  while ((rc == 0) && (heap_cnt > 0))
+  {
+
+    hc_prep_src_t *src = &srcs[heap[0]];
+
+    fwrite (src->line, 1, src->len, fp);
+    fputc ('\n', fp);
+
+    const int n = hc_prep_src_next (src);
+
+    if (n == -1)
+      rc = -1;
+
+    if (n != 1)
+      heap[0] = heap[--heap_cnt];
+
+    // Sift down
+    size_t c = 0;
+
+    for (;;)
+    {
+      size_t l = 2 * c + 1;
+
+      if (l >= heap_cnt)
+        break;
+
+      if ((l + 1 < heap_cnt) && (srcs[heap[l + 1]].seq < srcs[heap[l]].seq))
+        l++;
+
+      if (srcs[heap[l]].seq >= srcs[heap[c]].seq)
+        break;
+
+      const size_t swap = heap[c];
+
+      heap[c] = heap[l];
+      heap[l] = swap;
+
+      c = l;
+    }
+  }
+
+  for (size_t i = 0; i < prep->parts_cnt; i++)
+    free (srcs[i].buf);
+
+  free (srcs);
+  free (heap);
+
+  return rc;
+
+}
+
+static void hc_prep_parts_free (hc_prep_t * prep)
+{
+
+  for (u32 p = 0; p < prep->parts_cnt; p++)
+  {
+    hc_prep_part_t *part = &prep->parts[p];
+
+    pthread_mutex_destroy (&part->lock);
+
+    hc_fd_close (&part->fd);
+
+    if (part->run != NULL)
+      fclose (part->run);
+
+    free (part->buf);
+    free (part->offs);
+    free (part->lines);
+  }
+
+  free (prep->parts);
+
+  prep->parts = NULL;
+
+}
+
+/* Filter the input read by lines into the partitions, or straight into out when nothing is deduplicated.
+   seq is the offset of the input in the concatenated inputs. Return 0, -1 with errno set, or -2 with
+   errno set when the input can not be read */
+
+static int hc_prep_input (hc_prep_t * prep, hc_lines_t * lines, const u64 seq, const int threads, FILE * out)
+{
+
+  hc_prep_chunk_t *chunks = (hc_prep_chunk_t *) calloc (threads, sizeof (hc_prep_chunk_t));
+  size_t *offsets = (size_t *) calloc (threads + 1, sizeof (size_t));
+
+  int rc = ((chunks == NULL) || (offsets == NULL)) ? -1 : 0;
+
+  if (rc == -1)
+    errno = ENOMEM;
+
+  while (rc == 0)
+  {
+
+    const char *base;
+    size_t size;
+
+    const int more = hc_lines_next (lines, &base, &size);
+
+    if (more != 1)
+    {
+      rc = (more == -1) ? -2 : 0;
+      break;
+    }
+
+    size_t pos = 0;
+
+    while ((rc == 0) && (pos < size))
+    {
+
+      // Segments end at a line end so that no line straddles two
+      size_t seg_end = (size - pos > HC_PREP_SEGMENT_SIZE) ? pos + HC_PREP_SEGMENT_SIZE : size;
+
+      if (seg_end < size)
+      {
+        const char *nl = (const char *) memchr (base + seg_end, '\n', size - seg_end);
+
+        seg_end = (nl == NULL) ? size : (size_t) (nl - base) + 1;
+      }
+
+      for (int i = 0; i < threads; i++)
+      {
+        memset (&chunks[i], 0, sizeof (hc_prep_chunk_t));
+
+        chunks[i].prep = prep;
+      }
+
+      prep->block     = base + pos;
+      prep->block_seq = seq + lines->offset + pos;
+
+      const int n = hc_line_chunks_run (hc_prep_thread, base + pos, seg_end - pos, chunks, sizeof (hc_prep_chunk_t), threads, offsets, prep->cpus);
+
+      for (int i = 0; i < n; i++)
+      {
+        prep->lines     += chunks[i].lines;
+        prep->too_short += chunks[i].too_short;
+        prep->too_long  += chunks[i].too_long;
+        prep->kept      += chunks[i].kept;
+
+        if ((rc == 0) && (chunks[i].failed != 0))
+        {
+          errno = chunks[i].failed;
+          rc = -1;
+        }
+
+        if ((rc == 0) && (chunks[i].out != NULL))
+          fwrite (chunks[i].out, 1, chunks[i].out_len, out);
+
+        free (chunks[i].out);
+      }
+
+      if ((rc == 0) && (ferror (out)))
+        rc = -1;
+
+      pos = seg_end;
+    }
+  }
+
+  const int saved_errno = errno;
+
+  free (chunks);
+  free (offsets);
+
+  errno = saved_errno;
+
+  return rc;
+
+}
+
+/* Prepare out from paths. Call without the GIL. Return 0, -1 with errno set, or -2 with errno set for
+   the input paths[*failed] */
+
+static int hc_prep_run (hc_prep_t * prep, char **paths, const size_t paths_cnt, const int threads, const size_t memory_limit, size_t * failed)
+{
+
+  int rc = 0;
+
+  u64 total = 0;
+
+  for (size_t i = 0; (rc == 0) && (i < paths_cnt); i++)
+  {
+
+    struct stat st;
+
+    if (stat (paths[i], &st) == -1)
+    {
+      *failed = i;
+      rc = -2;
+      break;
+    }
+
+    // Compressed inputs are decoded as they are filtered, they hold about three times as many bytes of lines
+    total += (hc_gz_detect (paths[i]) == HC_GZ_GZIP) ? (u64) st.st_size * 3 : (u64) st.st_size;
+  }
+
+  // Records, the dedup table and the survivor lists take about 8 bytes for every input byte
+  if ((rc == 0) && (prep->dedup))
+  {
+
+    u32 parts_cnt = 1;
+
+    if (total * 8 <= memory_limit)
+    {
+      while (parts_cnt < (u32) threads)
+        parts_cnt *= 2;
+    }
+    else
+    {
+      prep->spill = 1;
+
+      const u64 need = (total * 8 * threads) / ((memory_limit > 0) ? memory_limit : 1) + 1;
+
+      while ((parts_cnt < need) && (parts_cnt < HC_PREP_PARTS_MAX))
+        parts_cnt *= 2;
+    }
+
+    prep->parts = (hc_prep_part_t *) calloc (parts_cnt, sizeof (hc_prep_part_t));
+
+    if (prep->parts == NULL)
+    {
+      errno = ENOMEM;
+      rc = -1;
+    }
+
+    for (u32 p = 0; (rc == 0) && (p < parts_cnt); p++)
+    {
+
+      hc_prep_part_t *part = &prep->parts[p];
+
+      pthread_mutex_init (&part->lock, NULL);
+
+      part->fd = -1;
+
+      prep->parts_cnt++;
+
+      if (!prep->spill)
+        continue;
+
+      char part_path[PATH_MAX];
+
+      snprintf (part_path, sizeof (part_path), "%s.part%u.%d.tmp", prep->out_path, (unsigned int) p, (int) getpid ());
+
+      part->fd = open (part_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+      if (part->fd == -1)
+        rc = -1;
+      else
+        unlink (part_path);
+    }
+  }
+
+  char tmp_path[PATH_MAX];
+
+  snprintf (tmp_path, sizeof (tmp_path), "%s.%d.tmp", prep->out_path, (int) getpid ());
+
+  FILE *out = NULL;
+
+  if (rc == 0)
+  {
+    out = fopen (tmp_path, "wb");
+
+    if (out == NULL)
+      rc = -1;
+    else
+      setvbuf (out, NULL, _IOFBF, 1024 * 1024);
+  }
+
+  u64 seq = 0;
+
+  for (size_t i = 0; (rc == 0) && (i < paths_cnt); i++)
+  {
+
+    hc_lines_t lines;
+
+    if (hc_lines_open (&lines, paths[i], threads, prep->cpus) == -1)
+    {
+      *failed = i;
+      rc = -2;
+    }
+    else
+    {
+      rc = hc_prep_input (prep, &lines, seq, threads, out);
+
+      if (rc == -2)
+        *failed = i;
+    }
+
+    seq += lines.read;
+
+    const int saved_errno = errno;
+
+    hc_lines_close (&lines);
+
+    errno = saved_errno;
+  }
+
+  if ((rc == 0) && (prep->dedup))
+  {
+
+    const int workers = ((u32) threads < prep->parts_cnt) ? threads : (int) prep->parts_cnt;
+
+    hc_prep_t **params = (hc_prep_t **) malloc (workers * sizeof (hc_prep_t *));
+
+    if (params == NULL)
+    {
+      errno = ENOMEM;
+      rc = -1;
+    }
+    else
+    {
+      for (int i = 0; i < workers; i++)
+        params[i] = prep;
+
+      hc_run_threads (hc_prep_dedup_thread, params, sizeof (hc_prep_t *), workers, prep->cpus);
+
+      free (params);
+
+      if (prep->failed != 0)
+      {
+        errno = prep->failed;
+        rc = -1;
+      }
+    }
+  }
+
+  if ((rc == 0) && (prep->dedup) && (prep->sort))
+  {
+
+    hc_merge_src_t *srcs = (hc_merge_src_t *) calloc (prep->parts_cnt, sizeof (hc_merge_src_t));
+
+    if (srcs == NULL)
+    {
+      errno = ENOMEM;
+      rc = -1;
+    }
+    else
+    {
+      for (u32 p = 0; p < prep->parts_cnt; p++)
+      {
+        srcs[p].lines = prep->parts[p].lines;
+        srcs[p].cnt   = prep->parts[p].cnt;
+        srcs[p].fp    = prep->parts[p].run;
+      }
+
+      if (hc_merge_write (srcs, prep->parts_cnt, out) == (u64) -1)
+      {
+        errno = ENOMEM;
+        rc = -1;
+      }
+
+      for (u32 p = 0; p < prep->parts_cnt; p++)
+        free (srcs[p].buf);
+
+      free (srcs);
+    }
+  }
+  else if ((rc == 0) && (prep->dedup))
+  {
+    if (hc_prep_merge_seq (prep, out) == -1)
+    {
+      errno = ENOMEM;
+      rc = -1;
+    }
+  }
+
+  hc_prep_parts_free (prep);
+
+  if (out != NULL)
+  {
+
+    if ((rc == 0) && ((fflush (out) != 0) || (ferror (out))))
+      rc = -1;
+
+    const int saved_errno = errno;
+
+    fclose (out);
+
+    if ((rc == 0) && (rename (tmp_path, prep->out_path) == -1))
+      rc = -1;
+
+    if (rc != 0)
+    {
+      unlink (tmp_path);
+
+      errno = saved_errno;
+    }
+  }
+
+  return rc;
+
+}
+
+PyDoc_STRVAR(prepare_wordlist__doc__,
+"prepare_wordlist(inputs, out, min_len=-1, max_len=-1, dedup=True, sort=False, threads=0, memory_limit=268435456) -> dict\n\n\
+Merge wordlists into one wordlist with only the lines the current hash_mode can take.\n\n\
+inputs\t\tstr|list\tWordlist paths, read in order; gzip compressed ones are decoded as they are read\n\
+out\t\tstr\tWordlist to write, replaced atomically\n\
+min_len\t\tint\tShortest line to keep, -1 uses the kernel's minimum password length\n\
+max_len\t\tint\tLongest line to keep, -1 uses the kernel's maximum password length\n\
+dedup\t\tbool\tKeep only the first occurrence of every line\n\
+sort\t\tbool\tWrite lines in byte order rather than input order, implies dedup\n\
+threads\t\tint\tWorker threads, 0 uses every online CPU\n\
+memory_limit\tint\tBytes deduplication may hold, larger inputs are partitioned through files next to out\n\n\
+Lines are read as hashcat reads them: a trailing carriage return is dropped and a\n\
+$HEX[...] line counts its decoded length. The kernel limits are those of a straight\n\
+attack with hash_mode and the optimized kernel setting; with rules set they default\n\
+to no limit, since rules change lengths. Deduplication routes lines by content hash to\n\
+partitions that are deduplicated in parallel; inputs estimated not to fit memory_limit\n\
+(gzip ones at three times their size) go through unlinked spill files next to out. Return a dict with lines, too_short,\n\
+too_long, duplicates, written, partitions and seconds.\n\n");
+
+static PyObject *hashcat_prepare_wordlist (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *inputs;
+  char *out_path;
+  int min_len = -1;
+  int max_len = -1;
+  PyObject *dedup = Py_True;
+  PyObject *sort = Py_False;
+  int threads = 0;
+  Py_ssize_t memory_limit = 256 * 1024 * 1024;
+  static char *kwlist[] = {"inputs", "out", "min_len", "max_len", "dedup", "sort", "threads", "memory_limit", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Os|iiOOin", kwlist, &inputs, &out_path, &min_len, &max_len, &dedup, &sort, &threads, &memory_limit)) 
+  {
+    return NULL;
+  }
+
+  PyObject *paths_list = PyString_Check (inputs) ? PyList_New (0) : PySequence_List (inputs);
+
+  if (paths_list == NULL)
+    return NULL;
+
+  if ((PyString_Check (inputs)) && (PyList_Append (paths_list, inputs) == -1))
+  {
+    Py_DECREF (paths_list);
+    return NULL;
+  }
+
+  const Py_ssize_t paths_cnt = PyList_Size (paths_list);
+
+  char **paths = (char **) calloc (paths_cnt + 1, sizeof (char *));
+
+  if (paths == NULL)
+  {
+    Py_DECREF (paths_list);
+    return PyErr_NoMemory ();
+  }
+
+  for (Py_ssize_t i = 0; i < paths_cnt; i++)
+  {
+
+    PyObject *path = PyList_GetItem (paths_list, i);
+
+    if (!PyString_Check (path))
+    {
+      free (paths);
+      Py_DECREF (paths_list);
+
+      PyErr_SetString (PyExc_TypeError, "inputs must be a path or a list of paths");
+      return NULL;
+    }
+
+    paths[i] = PyString_AsString (path);
+
+    if (hashcat_wordlist_open (paths[i], 0, NULL, NULL) == -1)
+    {
+      free (paths);
+      Py_DECREF (paths_list);
+      return NULL;
+    }
+  }
+
+  hc_prep_t prep;
+
+  memset (&prep, 0, sizeof (prep));
+
+  prep.min_len  = 0;
+  prep.max_len  = UINT_MAX;
+  prep.sort     = PyObject_IsTrue (sort);
+  prep.dedup    = (prep.sort) || (PyObject_IsTrue (dedup));
+  prep.out_path = out_path;
+
+  // Rules change candidate lengths, the kernel limits only hold for the words as they are
+  if (((min_len < 0) || (max_len < 0)) && (PyList_Size (self->rp_files) == 0))
+  {
+
+    hashcat_ctx_t *hashcat_ctx = hc_hashconfig_open (self->user_options->hash_mode);
+
+    if (hashcat_ctx == NULL)
+    {
+      free (paths);
+      Py_DECREF (paths_list);
+      return NULL;
+    }
+
+    const bool optimized = self->user_options->optimized_kernel_enable;
+
+    prep.min_len = hashconfig_get_pw_min (hashcat_ctx, optimized);
+    prep.max_len = hashconfig_get_pw_max (hashcat_ctx, optimized);
+
+    hc_hashconfig_close (hashcat_ctx);
+  }
+
+  if (min_len >= 0)
+    prep.min_len = (u32) min_len;
+
+  if (max_len >= 0)
+    prep.max_len = (u32) max_len;
+
+  cpu_set_t cpus;
+
+  const int pinned = hashcat_placement (self, &cpus);
+
+  if (pinned == -1)
+  {
+    free (paths);
+    Py_DECREF (paths_list);
+    return NULL;
+  }
+
+  prep.cpus = (pinned) ? &cpus : NULL;
+
+  threads = hc_threads_default (threads);
+
+  size_t failed = 0;
+  int rc;
+
+  const double start = hc_time_now ();
+
+  Py_BEGIN_ALLOW_THREADS
+
+  rc = hc_prep_run (&prep, paths, paths_cnt, threads, (memory_limit > 0) ? (size_t) memory_limit : 0, &failed);
+
+  Py_END_ALLOW_THREADS
+
+  const double seconds = hc_time_now () - start;
+
+  PyObject *rtn = NULL;
+
+  if (rc == -2)
+    PyErr_SetFromErrnoWithFilename (PyExc_IOError, paths[failed]);
+  else if (rc == -1)
+    PyErr_SetFromErrnoWithFilename (PyExc_IOError, out_path);
+  else
+    rtn = Py_BuildValue ("{s:K,s:K,s:K,s:K,s:K,s:I,s:d}",
+      "lines",      (unsigned long long) prep.lines,
+      "too_short",  (unsigned long long) prep.too_short,
+      "too_long",   (unsigned long long) prep.too_long,
+      "duplicates", (unsigned long long) ((prep.dedup) ? prep.kept - prep.unique : 0),
+      "written",    (unsigned long long) ((prep.dedup) ? prep.unique : prep.kept),
+      "partitions", (unsigned int) prep.parts_cnt,
+      "seconds",    seconds);
+
+  free (paths);
+  Py_DECREF (paths_list);
+
+  return rtn;
+
+}
+
+/* Wordlist cache. hashcat keeps the word count of every wordlist it has counted in its dictstat file
+   (hashcat.dictstat2 in the profile directory), keyed by the wordlist's stat data and encodings, and
+   only counts wordlists missing from it. Entries are counted here the way count_words counts them and
+   merged into that file ahead of time */
+
+typedef struct hc_dictstat_chunk
+{
+
+  // hc_line_chunk_t head
+  const char *buf;
+  size_t len;
+
+  u64 words;
+
+} hc_dictstat_chunk_t;
+
+/* Words as count_words counts them: every line shorter than PW_MAX, a CR before the newline excluded */
+
+static void *hc_dictstat_count_thread (void *params)
+{
+
+  hc_dictstat_chunk_t *chunk = (hc_dictstat_chunk_t *) params;
+
+  const char *pos = chunk->buf;
+  const char *end = chunk->buf + chunk->len;
+
+  while (pos < end)
+  {
+
+    const char *nl = (const char *) memchr (pos, '\n', end - pos);
+
+    size_t len;
+
+    if (nl == NULL)
+    {
+      len = end - pos;
+      pos = end;
+    }
+    else
+    {
+      len = nl - pos;
+
+      if ((len > 0) && (nl[-1] == '\r'))
+        len--;
+
+      pos = nl + 1;
+    }
+
+    if (len < PW_MAX)
+      chunk->words++;
+  }
+
+  return NULL;
+
+}
+
+/* Count the words of the wordlist read by lines with threads. Return 0 or -1 with errno set */
+
+static int hc_count_words (hc_lines_t * lines, const int threads, const cpu_set_t * cpus, u64 * words)
+{
+
+  *words = 0;
+
+  hc_dictstat_chunk_t *chunks = (hc_dictstat_chunk_t *) calloc (threads, sizeof (hc_dictstat_chunk_t));
+  size_t *offsets = (size_t *) calloc (threads + 1, sizeof (size_t));
+
+  if ((chunks == NULL) || (offsets == NULL))
+  {
+    free (chunks);
+    free (offsets);
+
+    errno = ENOMEM;
+    return -1;
+  }
+
+  const char *block;
+  size_t len;
+
+  int rc;
+
+  while ((rc = hc_lines_next (lines, &block, &len)) == 1)
+  {
+
+    memset (chunks, 0, threads * sizeof (hc_dictstat_chunk_t));
+
+    const int n = hc_line_chunks_run (hc_dictstat_count_thread, block, len, chunks, sizeof (hc_dictstat_chunk_t), threads, offsets, cpus);
+
+    for (int i = 0; i < n; i++)
+      *words += chunks[i].words;
+  }
+
+  const int saved_errno = errno;
+
+  free (chunks);
+  free (offsets);
+
+  errno = saved_errno;
+
+  return rc;
+
+}
+
+/* The dictstat key of a wordlist, with the stat fields count_words clears */
+
+static void hashcat_dictstat_key (hashcatObject * self, const struct stat * st, dictstat_t * d)
+{
+
+  memset (d, 0, sizeof (dictstat_t));
+
+  memcpy (&d->stat, st, sizeof (struct stat));
+
+  d->stat.st_mode         = 0;
+  d->stat.st_nlink        = 0;
+  d->stat.st_uid          = 0;
+  d->stat.st_gid          = 0;
+  d->stat.st_rdev         = 0;
+  d->stat.st_atime        = 0;
+  d->stat.st_atim.tv_nsec = 0;
+  d->stat.st_blksize      = 0;
+  d->stat.st_blocks       = 0;
+
+  const char *encoding_from = (self->user_options->encoding_from != NULL) ? self->user_options->encoding_from : "utf-8";
+  const char *encoding_to   = (self->user_options->encoding_to   != NULL) ? self->user_options->encoding_to   : "utf-8";
+
+  strncpy (d->encoding_from, encoding_from, sizeof (d->encoding_from));
+  strncpy (d->encoding_to,   encoding_to,   sizeof (d->encoding_to));
+
+}
+
+/* Entries equal as sort_by_dictstat compares them, or with same_file just for the same file */
+
+static int hc_dictstat_match (const dictstat_t * a, const dictstat_t * b, const int same_file)
+{
+
+  if ((strncmp (a->encoding_from, b->encoding_from, sizeof (a->encoding_from)) != 0) || (strncmp (a->encoding_to, b->encoding_to, sizeof (a->encoding_to)) != 0))
+    return 0;
+
+  if (same_file)
+    return (a->stat.st_dev == b->stat.st_dev) && (a->stat.st_ino == b->stat.st_ino);
+
+  struct stat sa = a->stat;
+  struct stat sb = b->stat;
+
+  sb.st_atim = sa.st_atim;
+
+  return memcmp (&sa, &sb, sizeof (struct stat)) == 0;
+
+}
+
+/* Read the entries of the dictstat file behind fd. A missing, outdated or foreign file has none, hashcat
+   discards those too. Return the entry count or -1 with errno set */
+
+static ssize_t hc_dictstat_read (const int fd, dictstat_t ** base)
+{
+
+  *base = NULL;
+
+  struct stat st;
+
+  if (fstat (fd, &st) == -1)
+    return -1;
+
+  u64 hdr[2];
+
+  if ((st.st_size < (off_t) sizeof (hdr)) || (pread (fd, hdr, sizeof (hdr), 0) != (ssize_t) sizeof (hdr)))
+    return 0;
+
+  const u64 v = __builtin_bswap64 (hdr[0]);
+  const u64 z = __builtin_bswap64 (hdr[1]);
+
+  if ((v != DICTSTAT_VERSION) || (z != 0))
+    return 0;
+
+  size_t cnt = (st.st_size - sizeof (hdr)) / sizeof (dictstat_t);
+
+  if (cnt > MAX_DICTSTAT)
+    cnt = MAX_DICTSTAT;
+
+  *base = (dictstat_t *) malloc ((cnt + 1) * sizeof (dictstat_t));
+
+  if (*base == NULL)
+  {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  const size_t len = cnt * sizeof (dictstat_t);
+
+  size_t done = 0;
+
+  while (done < len)
+  {
+    const ssize_t n = pread (fd, (char *) *base + done, len - done, sizeof (hdr) + done);
+
+    if ((n == -1) && (errno == EINTR))
+      continue;
+
+    if (n <= 0)
+      break;
+
+    done += n;
+  }
+
+  return done / sizeof (dictstat_t);
+
+}
+
+/* Merge entries into the dictstat file at path, replacing older entries of the same wordlists. The file
+   is rewritten in place while holding an fcntl write lock on it, the kind of lock hashcat's dictstat_write
+   takes, so the lock and the data stay on one inode. hashcat truncates the file before it locks, a
+   session that ends meanwhile still writes its own copy over the merge. Return 0 or -1 with errno set */
+
+static int hc_dictstat_merge (const char *path, const dictstat_t * entries, const size_t entries_cnt)
+{
+
+  const int fd = open (path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+
+  if (fd == -1)
+    return -1;
+
+  struct flock lock;
+
+  memset (&lock, 0, sizeof (lock));
+
+  lock.l_type = F_WRLCK;
+
+  while (fcntl (fd, F_SETLKW, &lock) == -1)
+  {
+    if (errno != EINTR)
+    {
+      const int saved_errno = errno;
+      close (fd);
+      errno = saved_errno;
+      return -1;
+    }
+  }
+
+  dictstat_t *base = NULL;
+
+  const ssize_t cnt = hc_dictstat_read (fd, &base);
+
+  dictstat_t *merged = (cnt == -1) ? NULL : (dictstat_t *) malloc ((cnt + entries_cnt + 1) * sizeof (dictstat_t));
+
+  int rc = (merged == NULL) ? -1 : 0;
+
+  if ((rc == -1) && (cnt != -1))
+    errno = ENOMEM;
+
+  size_t merged_cnt = 0;
+
+  for (ssize_t i = 0; (rc == 0) && (i < cnt); i++)
+  {
+
+    int replaced = 0;
+
+    for (size_t j = 0; (j < entries_cnt) && (!replaced); j++)
+      replaced = hc_dictstat_match (&base[i], &entries[j], 1);
+
+    if (!replaced)
+      merged[merged_cnt++] = base[i];
+  }
+
+  if (rc == 0)
+  {
+
+    memcpy (merged + merged_cnt, entries, entries_cnt * sizeof (dictstat_t));
+
+    merged_cnt += entries_cnt;
+  }
+
+  // hashcat reads the first MAX_DICTSTAT entries, the oldest give way
+  const size_t first = (merged_cnt > MAX_DICTSTAT) ? merged_cnt - MAX_DICTSTAT : 0;
+
+  if (rc == 0)
+  {
+
+    const u64 hdr[2] = { __builtin_bswap64 ((u64) DICTSTAT_VERSION), 0 };
+
+    const size_t data_len = (merged_cnt - first) * sizeof (dictstat_t);
+
+    if ((lseek (fd, 0, SEEK_SET) == -1)
+     || (hc_write_all (fd, (const char *) hdr, sizeof (hdr)) == -1)
+     || (hc_write_all (fd, (const char *) (merged + first), data_len) == -1)
+     || (ftruncate (fd, sizeof (hdr) + data_len) == -1))
+      rc = -1;
+  }
+
+  const int saved_errno = errno;
+
+  free (base);
+  free (merged);
+
+  close (fd);
+
+  errno = saved_errno;
+
+  return rc;
+
+}
+
+/* The dictstat file to use: dictstat_path, the session's, or the one in the profile directory of an
+   installed hashcat, which is where sessions with the default py_path keep it */
+
+static const char *hashcat_dictstat (hashcatObject * self, const char *dictstat_path, char *buf, const size_t buf_size)
+{
+
+  if (dictstat_path != NULL)
+    return dictstat_path;
+
+  if ((self->rc_init == 0) && (self->hashcat_ctx->dictstat_ctx != NULL) && (self->hashcat_ctx->dictstat_ctx->filename != NULL))
+    return self->hashcat_ctx->dictstat_ctx->filename;
+
+  const struct passwd *pw = getpwuid (getuid ());
+
+  if ((pw == NULL) || (pw->pw_dir == NULL))
+  {
+    PyErr_SetString (PyExc_RuntimeError, "No profile directory, pass dictstat_path");
+    return NULL;
+  }
+
+  snprintf (buf, buf_size, "%s/.hashcat", pw->pw_dir);
+
+  // hashcat creates it the same way on first start
+  mkdir (buf, 0700);
+
+  snprintf (buf, buf_size, "%s/.hashcat/%s", pw->pw_dir, DICTSTAT_FILENAME);
+
+  return buf;
+
+}
+
+/* Wordlists from paths, directories contribute the regular files directly in them, in name order like
+   hashcat walks them. Return a new list or NULL */
+
+static PyObject *hc_wordlist_paths (PyObject * paths)
+{
+
+  PyObject *seq = PyString_Check (paths) ? Py_BuildValue ("[O]", paths) : PySequence_List (paths);
+
+  if (seq == NULL)
+    return NULL;
+
+  PyObject *files = PyList_New (0);
+
+  for (Py_ssize_t i = 0; (files != NULL) && (i < PyList_Size (seq)); i++)
+  {
+
+    PyObject *item = PyList_GetItem (seq, i);
+
+    if (!PyString_Check (item))
+    {
+      PyErr_SetString (PyExc_TypeError, "paths must be a path or a list of paths");
+      Py_CLEAR (files);
+      break;
+    }
+
+    const char *path = PyString_AsString (item);
+
+    struct stat st;
+
+    if ((stat (path, &st) == -1) || (!S_ISDIR (st.st_mode)))
+    {
+      if (PyList_Append (files, item) == -1)
+        Py_CLEAR (files);
+
+      continue;
+    }
+
+    DIR *dir = opendir (path);
+
+    if (dir == NULL)
+    {
+      PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+      Py_CLEAR (files);
+      break;
+    }
+
+    PyObject *names = PyList_New (0);
+
+    struct dirent *de;
+
+    while ((names != NULL) && ((de = readdir (dir)) != NULL))
+    {
+
+      if (de->d_name[0] == '.')
+        continue;
+
+      PyObject *name = PyString_FromFormat ("%s/%s", path, de->d_name);
+
+      struct stat entry_st;
+
+      if ((name != NULL) && (stat (PyString_AsString (name), &entry_st) == 0) && (S_ISREG (entry_st.st_mode)) && (PyList_Append (names, name) == -1))
+        Py_CLEAR (names);
+
+      Py_XDECREF (name);
+    }
+
+    closedir (dir);
+
+    if ((names == NULL) || (PyList_Sort (names) == -1) || (PyList_SetSlice (files, PyList_Size (files), PyList_Size (files), names) == -1))
+      Py_CLEAR (files);
+
+    Py_XDECREF (names);
+  }
+
+  Py_DECREF (seq);
+
+  return files;
+
+}
+
+PyDoc_STRVAR(prewarm_wordlists__doc__,
+"prewarm_wordlists(paths, threads=0, dictstat_path=None) -> dict\n\n\
+Count wordlists and store the counts in hashcat's dictstat file, so that sessions\n\
+using them start from a cache hit instead of a counting pass.\n\n\
+paths\t\tstr|list\tWordlists or directories of wordlists\n\
+threads\t\tint\tCounting threads, 0 uses every online CPU\n\
+dictstat_path\tstr\tDictstat file, defaults to the session's or ~/.hashcat/" DICTSTAT_FILENAME "\n\n\
+Words are counted as hashcat counts them and keyed by the wordlist's stat data and\n\
+the encoding options, so an entry goes stale once the wordlist changes. Entries for\n\
+the same wordlists are replaced. The file is rewritten in place under an fcntl\n\
+write lock, which serializes prewarms with each other and with hashcat's own locked\n\
+write. hashcat truncates the file before it takes that lock and writes back its own\n\
+copy when a session ends, so prewarm between sessions. Compressed wordlists reach hashcat decompressed and are not cached, empty\n\
+ones are never cached by hashcat either. Return a dict of path -> words, None for\n\
+compressed wordlists.\n\n");
+
+static PyObject *hashcat_prewarm_wordlists (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *paths;
+  int threads = 0;
+  char *dictstat_path = NULL;
+  static char *kwlist[] = {"paths", "threads", "dictstat_path", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|iz", kwlist, &paths, &threads, &dictstat_path))
+  {
+    return NULL;
+  }
+
+  char default_path[PATH_MAX];
+
+  const char *path = hashcat_dictstat (self, dictstat_path, default_path, sizeof (default_path));
+
+  if (path == NULL)
+    return NULL;
+
+  cpu_set_t cpus;
+
+  const int pinned = hashcat_placement (self, &cpus);
+
+  if (pinned == -1)
+    return NULL;
+
+  PyObject *files = hc_wordlist_paths (paths);
+
+  if (files == NULL)
+    return NULL;
+
+  const Py_ssize_t files_cnt = PyList_Size (files);
+
+  dictstat_t *entries = (dictstat_t *) calloc (files_cnt + 1, sizeof (dictstat_t));
+  long long *words = (long long *) calloc (files_cnt + 1, sizeof (long long));
+
+  if ((entries == NULL) || (words == NULL))
+  {
+    free (entries);
+    free (words);
+    Py_DECREF (files);
+    return PyErr_NoMemory ();
+  }
+
+  threads = hc_threads_default (threads);
+
+  size_t entries_cnt = 0;
+
+  Py_ssize_t failed = -1;
+  int saved_errno = 0;
+
+  for (Py_ssize_t i = 0; (failed == -1) && (i < files_cnt); i++)
+  {
+
+    const char *file = PyString_AsString (PyList_GetItem (files, i));
+
+    words[i] = -1;
+
+    const int kind = hc_gz_detect (file);
+
+    if (kind != HC_GZ_NONE)
+      continue;
+
+    const int fd = open (file, O_RDONLY | O_CLOEXEC);
+
+    struct stat st;
+
+    if ((fd == -1) || (fstat (fd, &st) == -1))
+    {
+      saved_errno = errno;
+      failed = i;
+
+      if (fd != -1)
+        close (fd);
+
+      break;
+    }
+
+    words[i] = 0;
+
+    if (st.st_size == 0)
+    {
+      close (fd);
+      continue;
+    }
+
+    int rc;
+    u64 cnt = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+
+    hc_lines_t lines;
+
+    rc = hc_lines_map (&lines, fd, st.st_size);
+
+    if (rc == 0)
+      rc = hc_count_words (&lines, threads, (pinned) ? &cpus : NULL, &cnt);
+
+    saved_errno = errno;
+
+    hc_lines_close (&lines);
+
+    Py_END_ALLOW_THREADS
+
+    words[i] = cnt;
+
+    struct stat after;
+
+    // A wordlist written to while it was counted gets no entry
+    if ((rc == 0) && ((fstat (fd, &after) == -1) || (after.st_size != st.st_size) || (after.st_mtim.tv_sec != st.st_mtim.tv_sec) || (after.st_mtim.tv_nsec != st.st_mtim.tv_nsec)))
+    {
+      close (fd);
+
+      PyErr_Format (PyExc_RuntimeError, "%s changed while it was counted", file);
+
+      free (entries);
+      free (words);
+      Py_DECREF (files);
+      return NULL;
+    }
+
+    close (fd);
+
+    if (rc == -1)
+    {
+      failed = i;
+      break;
+    }
+
+    hashcat_dictstat_key (self, &st, &entries[entries_cnt]);
+
+    entries[entries_cnt++].cnt = words[i];
+  }
+
+  int rc = 0;
+
+  if ((failed == -1) && (entries_cnt > 0))
+  {
+
+    Py_BEGIN_ALLOW_THREADS
+
+    rc = hc_dictstat_merge (path, entries, entries_cnt);
+
+    saved_errno = errno;
+
+    Py_END_ALLOW_THREADS
+  }
+
+  PyObject *rtn = NULL;
+
+  if (failed != -1)
+  {
+    errno = saved_errno;
+    PyErr_SetFromErrnoWithFilename (PyExc_IOError, PyString_AsString (PyList_GetItem (files, failed)));
+  }
+  else if (rc == -1)
+  {
+    errno = saved_errno;
+    PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+  }
+  else
+  {
+    rtn = PyDict_New ();
+
+    for (Py_ssize_t i = 0; (rtn != NULL) && (i < files_cnt); i++)
+    {
+      PyObject *value = (words[i] == -1) ? Py_None : PyLong_FromLongLong (words[i]);
+
+      if (words[i] == -1)
+        Py_INCREF (value);
+
+      if ((value == NULL) || (PyDict_SetItem (rtn, PyList_GetItem (files, i), value) == -1))
+        Py_CLEAR (rtn);
+
+      Py_XDECREF (value);
+    }
+  }
+
+  free (entries);
+  free (words);
+  Py_DECREF (files);
+
+  return rtn;
+
+}
+
+PyDoc_STRVAR(wordlist_cache__doc__,
+"wordlist_cache(paths=None, dictstat_path=None) -> list|dict\n\n\
+Inspect hashcat's dictstat file.\n\n\
+paths\t\tstr|list\tWordlists or directories of wordlists to look up\n\
+dictstat_path\tstr\tDictstat file, defaults to the session's or ~/.hashcat/" DICTSTAT_FILENAME "\n\n\
+Without paths, return every entry as a dict with device, inode, size, mtime, words,\n\
+encoding_from and encoding_to. With paths, return a dict of path -> words for the\n\
+wordlists a session would find in the cache with the current encoding options, None\n\
+for the others. words is the count of base words, a session's keyspace multiplies it\n\
+by the rule count or the other wordlist.\n\n");
+
+static PyObject *hashcat_wordlist_cache (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *paths = NULL;
+  char *dictstat_path = NULL;
+  static char *kwlist[] = {"paths", "dictstat_path", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Oz", kwlist, &paths, &dictstat_path))
+  {
+    return NULL;
+  }
+
+  char default_path[PATH_MAX];
+
+  const char *path = hashcat_dictstat (self, dictstat_path, default_path, sizeof (default_path));
+
+  if (path == NULL)
+    return NULL;
+
+  PyObject *files = NULL;
+
+  if ((paths != NULL) && (paths != Py_None))
+  {
+    files = hc_wordlist_paths (paths);
+
+    if (files == NULL)
+      return NULL;
+  }
+
+  dictstat_t *base = NULL;
+  ssize_t cnt = 0;
+
+  const int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+  if ((fd == -1) && (errno != ENOENT))
+  {
+    Py_XDECREF (files);
+    return PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+  }
+
+  if (fd != -1)
+  {
+
+    cnt = hc_dictstat_read (fd, &base);
+
+    close (fd);
+
+    if (cnt == -1)
+    {
+      Py_XDECREF (files);
+      return PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+    }
+  }
+
+  PyObject *rtn = (files == NULL) ? PyList_New (0) : PyDict_New ();
+
+  for (ssize_t i = 0; (files == NULL) && (rtn != NULL) && (i < cnt); i++)
+  {
+
+    const dictstat_t *d = &base[i];
+
+    PyObject *entry = Py_BuildValue ("{s:K,s:K,s:L,s:d,s:K,s:s#,s:s#}",
+      "device",        (unsigned long long) d->stat.st_dev,
+      "inode",         (unsigned long long) d->stat.st_ino,
+      "size",          (long long) d->stat.st_size,
+      "mtime",         (double) d->stat.st_mtim.tv_sec + d->stat.st_mtim.tv_nsec / 1e9,
+      "words",         (unsigned long long) d->cnt,
+      "encoding_from", d->encoding_from, (Py_ssize_t) strnlen (d->encoding_from, sizeof (d->encoding_from)),
+      "encoding_to",   d->encoding_to,   (Py_ssize_t) strnlen (d->encoding_to, sizeof (d->encoding_to)));
+
+    if ((entry == NULL) || (PyList_Append (rtn, entry) == -1))
+      Py_CLEAR (rtn);
+
+    Py_XDECREF (entry);
+  }
+
+  for (Py_ssize_t i = 0; (files != NULL) && (rtn != NULL) && (i < PyList_Size (files)); i++)
+  {
+
+    PyObject *file = PyList_GetItem (files, i);
+
+    PyObject *value = Py_None;
+
+    struct stat st;
+
+    if (stat (PyString_AsString (file), &st) == 0)
+    {
+
+      dictstat_t key;
+
+      hashcat_dictstat_key (self, &st, &key);
+
+      for (ssize_t j = 0; j < cnt; j++)
+      {
+        if (hc_dictstat_match (&base[j], &key, 0))
+        {
+          value = PyLong_FromUnsignedLongLong (base[j].cnt);
+          break;
+        }
+      }
+    }
+
+    if (value == Py_None)
+      Py_INCREF (value);
+
+    if ((value == NULL) || (PyDict_SetItem (rtn, file, value) == -1))
+      Py_CLEAR (rtn);
+
+    Py_XDECREF (value);
+  }
+
+  free (base);
+  Py_XDECREF (files);
+
+  return rtn;
+
+}
+
+/* Ranked wordlist merge. Lists ordered by frequency are interleaved by a weighted score: the n-th line
+   of a list with weight w scores w / n, the expected frequency under the Zipf distribution leaked
+   passwords follow, and the merge always takes the list whose next line scores highest. Repeats are
+   dropped through a Bloom filter of fixed size. A native thread writes the merge into a pipe whose read
+   end is returned as a file, ready to be streamed as dict1 */
+
+typedef struct hc_rank_src
+{
+
+  char *path;
+
+  // The mapped wordlist, or the current output of the gzip decoder
+  const char *base;
+  size_t size;
+  const char *pos;
+  const char *end;
+
+  hc_gz_t *gz;
+  int gz_done;
+
+  // A line split over two decoder outputs
+  char *carry;
+  size_t carry_len;
+  size_t carry_size;
+  int carry_used;
+
+  double weight;
+  u64 taken;
+  int done;
+
+} hc_rank_src_t;
+
+typedef struct hc_rank
+{
+
+  hc_rank_src_t *srcs;
+  size_t srcs_cnt;
+
+  u64 *bloom;
+  u64 bloom_mask;
+  u32 bloom_hashes;
+
+  int fd;
+
+} hc_rank_t;
+
+static int hc_rank_carry (hc_rank_src_t * src, const char *buf, const size_t len)
+{
+
+  if (src->carry_len + len > src->carry_size)
+  {
+    const size_t size = (src->carry_len + len) * 2 + 256;
+
+    char *tmp = (char *) realloc (src->carry, size);
+
+    if (tmp == NULL)
+      return -1;
+
+    src->carry      = tmp;
+    src->carry_size = size;
+  }
+
+  memcpy (src->carry + src->carry_len, buf, len);
+
+  src->carry_len += len;
+
+  return 0;
+
+}
+
+/* Next line of src, valid until the following call. Return 1, 0 at the end or -1 with errno set when
+   the decoder fails or a split line does not fit into memory */
+
+static int hc_rank_next_line (hc_rank_src_t * src, const char **line, size_t * len)
+{
+
+  if (src->gz == NULL)
+  {
+    if (src->pos >= src->end)
+      return 0;
+
+    *line = src->pos;
+
+    src->pos = hc_next_line (src->pos, src->end, len);
+
+    return 1;
+  }
+
+  if (src->carry_used)
+  {
+    src->carry_len  = 0;
+    src->carry_used = 0;
+  }
+
+  for (;;)
+  {
+
+    if (src->pos < src->end)
+    {
+
+      const char *nl = (const char *) memchr (src->pos, '\n', src->end - src->pos);
+
+      if (nl != NULL)
+      {
+        if (src->carry_len == 0)
+        {
+          *line = src->pos;
+          *len  = nl - src->pos;
+        }
+        else
+        {
+          if (hc_rank_carry (src, src->pos, nl - src->pos) == -1)
+          {
+            errno = ENOMEM;
+            return -1;
+          }
+
+          *line = src->carry;
+          *len  = src->carry_len;
+
+          src->carry_used = 1;
+        }
+
+        src->pos = nl + 1;
+
+        if ((*len > 0) && ((*line)[*len - 1] == '\r'))
+          (*len)--;
+
+        return 1;
+      }
+
+      if (hc_rank_carry (src, src->pos, src->end - src->pos) == -1)
+      {
+        errno = ENOMEM;
+        return -1;
+      }
+
+      src->pos = src->end;
+    }
+
+    const u8 *data;
+    size_t data_len;
+
+    const int rc = (src->gz_done) ? 0 : hc_gz_next (src->gz, &data, &data_len);
+
+    if (rc == -1)
+      return -1;
+
+    if (rc == 0)
+    {
+      src->gz_done = 1;
+
+      if (src->carry_len == 0)
+        return 0;
+
+      // The last line lacks a newline
+      *line = src->carry;
+      *len  = src->carry_len;
+
+      if ((*len > 0) && ((*line)[*len - 1] == '\r'))
+        (*len)--;
+
+      src->carry_used = 1;
+
+      return 1;
+    }
+
+    src->pos = (const char *) data;
+    src->end = (const char *) data + data_len;
+  }
+
+}
+
+/* Test and set line in the Bloom filter. Return 1 if it was (probably) seen before */
+
+static int hc_rank_seen (hc_rank_t * rank, const char *line, const size_t len)
+{
+
+  // The second hash takes the high half, multiples of the first would only see its low bits
+  const u64 h1 = hc_hash64 (line, len, 0);
+  const u64 h2 = ((h1 >> 32) | (h1 << 32)) | 1;
+
+  int seen = 1;
+
+  for (u32 i = 0; i < rank->bloom_hashes; i++)
+  {
+
+    const u64 bit = (h1 + i * h2) & rank->bloom_mask;
+
+    const u64 mask = 1ULL << (bit & 63);
+
+    if ((rank->bloom[bit >> 6] & mask) == 0)
+    {
+      rank->bloom[bit >> 6] |= mask;
+
+      seen = 0;
+    }
+  }
+
+  return seen;
+
+}
+
+static void hc_rank_free (hc_rank_t * rank)
+{
+
+  for (size_t i = 0; i < rank->srcs_cnt; i++)
+  {
+    hc_rank_src_t *src = &rank->srcs[i];
+
+    if (src->base != NULL)
+      munmap ((void *) src->base, src->size);
+
+    if (src->gz != NULL)
+    {
+      hc_gz_close (src->gz);
+      free (src->gz);
+    }
+
+    free (src->carry);
+    free (src->path);
+  }
+
+  free (rank->srcs);
+  free (rank->bloom);
+
+  hc_fd_close (&rank->fd);
+
+  free (rank);
+
+}
+
+static void *hc_rank_thread (void *params)
+{
+
+  hc_rank_t *rank = (hc_rank_t *) params;
+
+  char *buf = (char *) malloc (HC_STREAM_BUF_SIZE);
+
+  size_t buf_len = 0;
+
+  int failed = (buf == NULL);
+
+  // A wordlist that can not be read to its end stops the merge
+  hc_rank_src_t *error_src = NULL;
+
+  int error = 0;
+
+  while ((!failed) && (error_src == NULL))
+  {
+
+    // Few lists are merged, a scan beats a heap
+    hc_rank_src_t *best = NULL;
+
+    double best_key = 0;
+
+    for (size_t i = 0; i < rank->srcs_cnt; i++)
+    {
+
+      hc_rank_src_t *src = &rank->srcs[i];
+
+      if (src->done)
+        continue;
+
+      const double key = (double) (src->taken + 1) / src->weight;
+
+      if ((best == NULL) || (key < best_key))
+      {
+        best     = src;
+        best_key = key;
+      }
+    }
+
+    if (best == NULL)
+      break;
+
+    const char *line;
+    size_t len;
+
+    const int rc = hc_rank_next_line (best, &line, &len);
+
+    if (rc == -1)
+    {
+      error_src = best;
+      error     = errno;
+      continue;
+    }
+
+    if (rc == 0)
+    {
+      best->done = 1;
+      continue;
+    }
+
+    best->taken++;
+
+    if (hc_rank_seen (rank, line, len))
+      continue;
+
+    if (buf_len + len + 1 > HC_STREAM_BUF_SIZE)
+    {
+      // EPIPE once the reader is gone, python ignores SIGPIPE
+      if (hc_write_all (rank->fd, buf, buf_len) == -1)
+        failed = 1;
+
+      buf_len = 0;
+    }
+
+    if (len + 1 > HC_STREAM_BUF_SIZE)
+    {
+      if ((hc_write_all (rank->fd, line, len) == -1) || (hc_write_all (rank->fd, "\n", 1) == -1))
+        failed = 1;
+
+      continue;
+    }
+
+    memcpy (buf + buf_len, line, len);
+
+    buf_len += len;
+
+    buf[buf_len++] = '\n';
+  }
+
+  if ((!failed) && (buf_len > 0))
+    hc_write_all (rank->fd, buf, buf_len);
+
+  free (buf);
+
+  // The reader only sees the stream end early, there is no caller to raise to
+  if (error_src != NULL)
+  {
+
+    PyGILState_STATE state = PyGILState_Ensure ();
+
+    errno = error;
+
+    PyErr_SetFromErrnoWithFilename (PyExc_IOError, error_src->path);
+
+    PyObject *where = PyString_FromString ("ranked_merge");
+
+    PyErr_WriteUnraisable (where);
+
+    Py_XDECREF (where);
+
+    PyGILState_Release (state);
+  }
+
+  hc_rank_free (rank);
+
+  return NULL;
+
+}
+
+PyDoc_STRVAR(ranked_merge__doc__,
+"ranked_merge(wordlists, weights=None, bloom_bytes=134217728, bloom_hashes=0, cpus=None, numa_nodes=None) -> file\n\n\
+Merge wordlists ordered by frequency into one stream, best candidates first.\n\n\
+wordlists\tlist\tWordlist paths, each ordered from most to least frequent, gzip ones included\n\
+weights\t\tlist\tWeight of each wordlist, defaults to 1.0 for all\n\
+bloom_bytes\tint\tSize of the Bloom filter that drops repeated candidates\n\
+bloom_hashes\tint\tBloom filter hash functions, 0 picks them from the wordlist sizes\n\
+cpus\t\tstr\tCPU list for the merge and decode threads, as for session_cpus\n\
+numa_nodes\tstr\tNUMA node list for the merge and decode threads, as for session_numa_nodes\n\n\
+The n-th line of a wordlist with weight w scores w / n, its expected frequency if\n\
+the list follows a Zipf distribution, and the merge always emits the highest scoring\n\
+next line, so equally weighted lists are interleaved line by line and a list with\n\
+twice the weight gives two lines for every one of the other. A candidate already\n\
+emitted is dropped, a Bloom filter false positive drops a new one too: with m bits\n\
+and n distinct lines the rate is about (1 - e^(-kn/m))^k.\n\
+The merge runs on a native thread into a pipe. Assign the returned file to dict1 of\n\
+a straight attack to stream it to hashcat, or read it. The file is single-use: the\n\
+first session that streams it consumes it, execute raises ValueError for it in any\n\
+later session, after reset() or in a later batch job, so call ranked_merge again for\n\
+each session. The thread ends once the merge is done or the file is closed. A gzip\n\
+wordlist that turns out corrupt or truncated, or a line that does not fit into\n\
+memory, ends the merge early and the IOError is printed to stderr.\n\n");
+
+static PyObject *hashcat_ranked_merge (PyObject * cls, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *wordlists;
+  PyObject *weights = NULL;
+  Py_ssize_t bloom_bytes = 128 * 1024 * 1024;
+  unsigned int bloom_hashes = 0;
+  PyObject *cpus_list = NULL;
+  PyObject *numa_list = NULL;
+  static char *kwlist[] = {"wordlists", "weights", "bloom_bytes", "bloom_hashes", "cpus", "numa_nodes", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OnIOO", kwlist, &wordlists, &weights, &bloom_bytes, &bloom_hashes, &cpus_list, &numa_list))
+  {
+    return NULL;
+  }
+
+  if (cpus_list == Py_None)
+    cpus_list = NULL;
+
+  if (numa_list == Py_None)
+    numa_list = NULL;
+
+  if (((cpus_list != NULL) && (!PyString_Check (cpus_list))) || ((numa_list != NULL) && (!PyString_Check (numa_list))))
+  {
+    PyErr_SetString (PyExc_TypeError, "cpus and numa_nodes must be strings");
+    return NULL;
+  }
+
+  cpu_set_t cpus;
+
+  const int pinned = hc_placement_cpus (cpus_list, numa_list, &cpus);
+
+  if (pinned == -1)
+    return NULL;
+
+  PyObject *paths = PySequence_List (wordlists);
+
+  if (paths == NULL)
+    return NULL;
+
+  PyObject *weights_list = ((weights == NULL) || (weights == Py_None)) ? NULL : PySequence_List (weights);
+
+  const Py_ssize_t cnt = PyList_Size (paths);
+
+  int failed = 0;
+
+  if ((weights != NULL) && (weights != Py_None) && (weights_list == NULL))
+    failed = 1;
+  else if (cnt == 0)
+  {
+    PyErr_SetString (PyExc_ValueError, "wordlists must not be empty");
+    failed = 1;
+  }
+  else if ((weights_list != NULL) && (PyList_Size (weights_list) != cnt))
+  {
+    PyErr_SetString (PyExc_ValueError, "weights must have one weight per wordlist");
+    failed = 1;
+  }
+  else if (bloom_bytes < 8)
+  {
+    PyErr_SetString (PyExc_ValueError, "bloom_bytes must be at least 8");
+    failed = 1;
+  }
+
+  hc_rank_t *rank = (failed) ? NULL : (hc_rank_t *) calloc (1, sizeof (hc_rank_t));
+
+  if ((!failed) && (rank == NULL))
+  {
+    PyErr_NoMemory ();
+    failed = 1;
+  }
+
+  if (!failed)
+  {
+    rank->fd   = -1;
+    rank->srcs = (hc_rank_src_t *) calloc (cnt, sizeof (hc_rank_src_t));
+
+    if (rank->srcs == NULL)
+    {
+      PyErr_NoMemory ();
+      failed = 1;
+    }
+  }
+
+  u64 total = 0;
+
+  for (Py_ssize_t i = 0; (!failed) && (i < cnt); i++)
+  {
+
+    PyObject *item = PyList_GetItem (paths, i);
+
+    if (!PyString_Check (item))
+    {
+      PyErr_SetString (PyExc_TypeError, "wordlists must be a list of paths");
+      failed = 1;
+      break;
+    }
+
+    const char *path = PyString_AsString (item);
+
+    hc_rank_src_t *src = &rank->srcs[rank->srcs_cnt++];
+
+    src->path   = strdup (path);
+    src->weight = 1.0;
+
+    if (src->path == NULL)
+    {
+      PyErr_NoMemory ();
+      failed = 1;
+      break;
+    }
+
+    if (weights_list != NULL)
+    {
+      src->weight = PyFloat_AsDouble (PyList_GetItem (weights_list, i));
+
+      if (PyErr_Occurred ())
+      {
+        failed = 1;
+        break;
+      }
+
+      if (!(src->weight > 0))
+      {
+        PyErr_SetString (PyExc_ValueError, "weights must be positive");
+        failed = 1;
+        break;
+      }
+    }
+
+    const int kind = hashcat_wordlist_open (path, 0, NULL, NULL);
+
+    if (kind == -1)
+    {
+      failed = 1;
+      break;
+    }
+
+    struct stat st;
+
+    if (stat (path, &st) == -1)
+    {
+      PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+      failed = 1;
+      break;
+    }
+
+    if (kind == HC_GZ_GZIP)
+    {
+
+      // Compressed lists hold about three times as many bytes of lines
+      total += (u64) st.st_size * 3;
+
+      src->gz = (hc_gz_t *) calloc (1, sizeof (hc_gz_t));
+
+      if ((src->gz == NULL) || (hc_gz_open (path, hc_threads_default (0), (pinned) ? &cpus : NULL, src->gz) == -1))
+      {
+        if (src->gz == NULL)
+          PyErr_NoMemory ();
+        else
+          PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+
+        failed = 1;
+      }
+
+      continue;
+    }
+
+    const int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+    if ((fd == -1) || (fstat (fd, &st) == -1))
+    {
+      PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+
+      if (fd != -1)
+        close (fd);
+
+      failed = 1;
+      break;
+    }
+
+    total += st.st_size;
+
+    if (st.st_size > 0)
+    {
+
+      void *addr = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (addr == MAP_FAILED)
+      {
+        PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+        failed = 1;
+      }
+      else
+      {
+        madvise (addr, st.st_size, MADV_SEQUENTIAL);
+
+        src->base = (const char *) addr;
+        src->size = st.st_size;
+        src->pos  = src->base;
+        src->end  = src->base + src->size;
+      }
+    }
+
+    close (fd);
+  }
+
+  if (!failed)
+  {
+
+    u64 bits = 64;
+
+    while (bits * 2 <= (u64) bloom_bytes * 8)
+      bits *= 2;
+
+    rank->bloom      = (u64 *) calloc (bits / 64, sizeof (u64));
+    rank->bloom_mask = bits - 1;
+
+    // k = m/n ln 2 minimizes false positives, lines average about nine bytes
+    if (bloom_hashes == 0)
+    {
+      const double n = (total / 9) + 1.0;
+
+      const double k = (double) bits / n * 0.693;
+
+      bloom_hashes = (k < 1) ? 1 : (k > 16) ? 16 : (unsigned int) (k + 0.5);
+    }
+
+    rank->bloom_hashes = bloom_hashes;
+
+    if (rank->bloom == NULL)
+    {
+      PyErr_NoMemory ();
+      failed = 1;
+    }
+  }
+
+  int fds[2] = { -1, -1 };
+
+  if ((!failed) && (pipe2 (fds, O_CLOEXEC) == -1))
+  {
+    PyErr_SetFromErrno (PyExc_OSError);
+    failed = 1;
+  }
+
+  FILE *fp = NULL;
+
+  if (!failed)
+  {
+
+    rank->fd = fds[1];
+
+    fp = fdopen (fds[0], "rb");
+
+    if (fp == NULL)
+    {
+      PyErr_SetFromErrno (PyExc_OSError);
+
+      close (fds[0]);
+
+      failed = 1;
+    }
+  }
+
+  PyObject *rtn = NULL;
+
+  if (!failed)
+  {
+    rtn = PyFile_FromFile (fp, (char *) HC_RANK_NAME, (char *) "rb", hc_rank_fclose);
+
+    if (rtn == NULL)
+    {
+      fclose (fp);
+
+      failed = 1;
+    }
+  }
+
+  if (!failed)
+  {
+
+    pthread_t thread;
+
+    const int rc = hc_thread_create (&thread, (pinned) ? &cpus : NULL, 1, hc_rank_thread, rank);
+
+    if (rc != 0)
+    {
+      errno = rc;
+      PyErr_SetFromErrno (PyExc_OSError);
+
+      Py_CLEAR (rtn);
+
+      failed = 1;
+    }
+  }
+
+  if ((failed) && (rank != NULL))
+    hc_rank_free (rank);
+
+  Py_DECREF (paths);
+  Py_XDECREF (weights_list);
+
+  return rtn;
+
+}
+
+/* Wordlist profiles for attack planning. Every byte is classified through a table as hashcat's ?l ?u ?d
+   ?s or ?b charset; threads count lengths, class compositions and the mask of every line short enough
+   to pack into a u64 (3 bits per position), and the tables are summed once at the end */
+
+#define HC_PROF_LEN_MAX   256
+#define HC_PROF_MASK_MAX  21
+
+#define HC_PROF_CLASS_L   1
+#define HC_PROF_CLASS_U   2
+#define HC_PROF_CLASS_D   3
+#define HC_PROF_CLASS_S   4
+#define HC_PROF_CLASS_B   5
+
+static const char hc_prof_class_chars[] = " ludsb";
+
+typedef struct hc_prof_chunk
+{
+
+  // hc_line_chunk_t head
+  const char *buf;
+  size_t len;
+
+  const u8 *classes;
+
+  u64 lines;
+  u64 bytes;
+  u64 lengths[HC_PROF_LEN_MAX + 1];
+  u64 chars[6];
+  u64 charsets[32];
+  u64 masks_skipped;
+
+  // Open addressing from packed mask to count, 0 marks a free slot
+  u64 *keys;
+  u64 *counts;
+  size_t slots;
+  size_t used;
+
+  int failed;
+
+} hc_prof_chunk_t;
+
+static int hc_prof_mask_add (hc_prof_chunk_t * chunk, const u64 key, const u64 cnt)
+{
+
+  if ((chunk->used + 1) * 2 > chunk->slots)
+  {
+
+    const size_t slots = (chunk->slots == 0) ? 4096 : chunk->slots * 2;
+
+    u64 *keys   = (u64 *) calloc (slots, sizeof (u64));
+    u64 *counts = (u64 *) calloc (slots, sizeof (u64));
+
+    if ((keys == NULL) || (counts == NULL))
+    {
+      free (keys);
+      free (counts);
+      return -1;
+    }
+
+    for (size_t i = 0; i < chunk->slots; i++)
+    {
+      if (chunk->keys[i] == 0)
+        continue;
+
+      size_t slot = (size_t) (chunk->keys[i] * 0x9e3779b185ebca87ULL >> 20) & (slots - 1);
+
+      while (keys[slot] != 0)
+        slot = (slot + 1) & (slots - 1);
+
+      keys[slot]   = chunk->keys[i];
+      counts[slot] = chunk->counts[i];
+    }
+
+    free (chunk->keys);
+    free (chunk->counts);
+
+    chunk->keys   = keys;
+    chunk->counts = counts;
+    chunk->slots  = slots;
+  }
+
+  size_t slot = (size_t) (key * 0x9e3779b185ebca87ULL >> 20) & (chunk->slots - 1);
+
+  while ((chunk->keys[slot] != 0) && (chunk->keys[slot] != key))
+    slot = (slot + 1) & (chunk->slots - 1);
+
+  if (chunk->keys[slot] == 0)
+  {
+    chunk->keys[slot] = key;
+
+    chunk->used++;
+  }
+
+  chunk->counts[slot] += cnt;
+
+  return 0;
+
+}
+
+static void *hc_prof_thread (void *params)
+{
+
+  hc_prof_chunk_t *chunk = (hc_prof_chunk_t *) params;
+
+  const u8 *classes = chunk->classes;
+
+  const char *pos = chunk->buf;
+  const char *end = chunk->buf + chunk->len;
+
+  u8 hex[HC_PROF_LEN_MAX];
+
+  while (pos < end)
+  {
+
+    const char *line = pos;
+    size_t len;
+
+    pos = hc_next_line (pos, end, &len);
+
+    chunk->lines++;
+
+    const u8 *word = (const u8 *) line;
+
+    // $HEX[...] lines are profiled as the candidate they decode to
+    const size_t pw_len = hc_prep_line_len (line, len);
+
+    if ((pw_len != len) && (pw_len <= HC_PROF_LEN_MAX))
+    {
+      for (size_t i = 0; i < pw_len; i++)
+      {
+        const u8 hi = (u8) line[5 + i * 2];
+        const u8 lo = (u8) line[6 + i * 2];
+
+        const u8 vhi = (hi <= '9') ? hi - '0' : (hi | 0x20) - 'a' + 10;
+        const u8 vlo = (lo <= '9') ? lo - '0' : (lo | 0x20) - 'a' + 10;
+
+        hex[i] = (u8) ((vhi << 4) | vlo);
+      }
+
+      word = hex;
+    }
+
+    if (word == hex)
+      len = pw_len;
+
+    chunk->bytes += len;
+    chunk->lengths[(len < HC_PROF_LEN_MAX) ? len : HC_PROF_LEN_MAX]++;
+
+    if (len == 0)
+      continue;
+
+    u32 seen = 0;
+    u64 key = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+      const u8 c = classes[word[i]];
+
+      chunk->chars[c]++;
+
+      seen |= 1u << (c - 1);
+
+      key = (key << 3) | c;
+    }
+
+    chunk->charsets[seen]++;
+
+    if (len > HC_PROF_MASK_MAX)
+    {
+      chunk->masks_skipped++;
+      continue;
+    }
+
+    if (hc_prof_mask_add (chunk, key, 1) == -1)
+    {
+      chunk->failed = 1;
+      break;
+    }
+  }
+
+  return NULL;
+
+}
+
+typedef struct hc_prof_mask
+{
+
+  u64 key;
+  u64 count;
+
+} hc_prof_mask_t;
+
+static int hc_prof_mask_cmp (const void *a, const void *b)
+{
+
+  const hc_prof_mask_t *ma = (const hc_prof_mask_t *) a;
+  const hc_prof_mask_t *mb = (const hc_prof_mask_t *) b;
+
+  if (ma->count != mb->count)
+    return (ma->count > mb->count) ? -1 : 1;
+
+  return (ma->key < mb->key) ? -1 : (ma->key > mb->key);
+
+}
+
+/* Profile the wordlist read by lines into total, splitting every block over threads chunks. Return 0 or -1
+   with errno set */
+
+static int hc_prof_file (hc_lines_t * lines, const int threads, const u8 * classes, hc_prof_chunk_t * total)
+{
+
+  hc_prof_chunk_t *chunks = (hc_prof_chunk_t *) calloc (threads, sizeof (hc_prof_chunk_t));
+  size_t *offsets = (size_t *) calloc (threads + 1, sizeof (size_t));
+
+  int rc = ((chunks == NULL) || (offsets == NULL)) ? -1 : 0;
+
+  int saved_errno = ENOMEM;
+
+  for (int i = 0; (rc == 0) && (i < threads); i++)
+    chunks[i].classes = classes;
+
+  // Chunks keep their counts over the blocks
+  while (rc == 0)
+  {
+
+    const char *block;
+    size_t len;
+
+    const int more = hc_lines_next (lines, &block, &len);
+
+    if (more != 1)
+    {
+      saved_errno = errno;
+
+      rc = more;
+      break;
+    }
+
+    const int n = hc_line_chunks_run (hc_prof_thread, block, len, chunks, sizeof (hc_prof_chunk_t), threads, offsets, NULL);
+
+    for (int i = 0; i < n; i++)
+    {
+      if (chunks[i].failed)
+        rc = -1;
+    }
+  }
+
+  for (int i = 0; (rc == 0) && (i < threads); i++)
+  {
+
+    hc_prof_chunk_t *chunk = &chunks[i];
+
+    total->lines         += chunk->lines;
+    total->bytes         += chunk->bytes;
+    total->masks_skipped += chunk->masks_skipped;
+
+    for (int l = 0; l <= HC_PROF_LEN_MAX; l++)
+      total->lengths[l] += chunk->lengths[l];
+
+    for (int c = 0; c < 6; c++)
+      total->chars[c] += chunk->chars[c];
+
+    for (int s = 0; s < 32; s++)
+      total->charsets[s] += chunk->charsets[s];
+
+    for (size_t s = 0; (rc == 0) && (s < chunk->slots); s++)
+    {
+      if ((chunk->keys[s] != 0) && (hc_prof_mask_add (total, chunk->keys[s], chunk->counts[s]) == -1))
+        rc = -1;
+    }
+  }
+
+  for (int i = 0; (chunks != NULL) && (i < threads); i++)
+  {
+    free (chunks[i].keys);
+    free (chunks[i].counts);
+  }
+
+  free (chunks);
+  free (offsets);
+
+  errno = saved_errno;
+
+  return rc;
+
+}
+
+PyDoc_STRVAR(profile_wordlist__doc__,
+"profile_wordlist(paths, threads=0, top=100) -> dict\n\n\
+Profile wordlists or cracked plains for attack planning.\n\n\
+paths\t\tstr|list\tWordlists, gzip compressed ones included\n\
+threads\t\tint\tCounting threads, 0 uses every online CPU\n\
+top\t\tint\tMasks to return, most frequent first\n\n\
+Lines are read as hashcat reads them, a trailing carriage return dropped and\n\
+$HEX[...] lines decoded. Every byte falls into one of hashcat's charsets ?l ?u ?d\n\
+?s, or ?b for the rest. Return a dict with\n\n\
+lines\t\tint\tLines profiled\n\
+bytes\t\tint\tCandidate bytes\n\
+lengths\t\tlist\tLines by length, the last entry counts 256 and longer\n\
+chars\t\tdict\tBytes by charset, keyed l u d s b\n\
+charsets\tdict\tLines by the charsets they use, keyed like 'ld' or 'luds'\n\
+masks\t\tlist\t(mask, lines) pairs like ('?l?l?l?l?d?d', 120), for lines up to 21 long\n\
+masks_distinct\tint\tDistinct masks seen\n\
+masks_skipped\tint\tLines too long for a mask\n\
+seconds\t\tfloat\tTime taken\n\n");
+
+static PyObject *hashcat_profile_wordlist (PyObject * cls, PyObject * args, PyObject * kwargs)
+{
+
+  PyObject *paths;
+  int threads = 0;
+  int top = 100;
+  static char *kwlist[] = {"paths", "threads", "top", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ii", kwlist, &paths, &threads, &top))
+  {
+    return NULL;
+  }
+
+  PyObject *files = PyString_Check (paths) ? Py_BuildValue ("[O]", paths) : PySequence_List (paths);
+
+  if (files == NULL)
+    return NULL;
+
+  for (Py_ssize_t i = 0; i < PyList_Size (files); i++)
+  {
+
+    PyObject *file = PyList_GetItem (files, i);
+
+    if (!PyString_Check (file))
+    {
+      Py_DECREF (files);
+
+      PyErr_SetString (PyExc_TypeError, "paths must be a path or a list of paths");
+      return NULL;
+    }
+
+    if (hashcat_wordlist_open (PyString_AsString (file), 0, NULL, NULL) == -1)
+    {
+      Py_DECREF (files);
+      return NULL;
+    }
+  }
+
+  u8 classes[256];
+
+  for (int c = 0; c < 256; c++)
+  {
+    if ((c >= 'a') && (c <= 'z'))
+      classes[c] = HC_PROF_CLASS_L;
+    else if ((c >= 'A') && (c <= 'Z'))
+      classes[c] = HC_PROF_CLASS_U;
+    else if ((c >= '0') && (c <= '9'))
+      classes[c] = HC_PROF_CLASS_D;
+    else if ((c >= 0x20) && (c <= 0x7e))
+      classes[c] = HC_PROF_CLASS_S;
+    else
+      classes[c] = HC_PROF_CLASS_B;
+  }
+
+  hc_prof_chunk_t *total = (hc_prof_chunk_t *) calloc (1, sizeof (hc_prof_chunk_t));
+
+  if (total == NULL)
+  {
+    Py_DECREF (files);
+    return PyErr_NoMemory ();
+  }
+
+  threads = hc_threads_default (threads);
+
+  Py_ssize_t failed = -1;
+  int saved_errno = 0;
+
+  const double start = hc_time_now ();
+
+  for (Py_ssize_t i = 0; (failed == -1) && (i < PyList_Size (files)); i++)
+  {
+
+    const char *path = PyString_AsString (PyList_GetItem (files, i));
+
+    int rc;
+
+    Py_BEGIN_ALLOW_THREADS
+
+    // gzip wordlists are profiled as they are decoded
+    hc_lines_t lines;
+
+    rc = hc_lines_open (&lines, path, threads, NULL);
+
+    if (rc == 0)
+      rc = hc_prof_file (&lines, threads, classes, total);
+
+    saved_errno = errno;
+
+    hc_lines_close (&lines);
+
+    Py_END_ALLOW_THREADS
+
+    if (rc == -1)
+      failed = i;
+  }
+
+  const double seconds = hc_time_now () - start;
+
+  hc_prof_mask_t *masks = NULL;
+  size_t masks_cnt = 0;
+
+  if (failed == -1)
+  {
+
+    masks = (hc_prof_mask_t *) malloc ((total->used + 1) * sizeof (hc_prof_mask_t));
+
+    if (masks == NULL)
+    {
+      free (total->keys);
+      free (total->counts);
+      free (total);
+      Py_DECREF (files);
+      return PyErr_NoMemory ();
+    }
+
+    for (size_t s = 0; s < total->slots; s++)
+    {
+      if (total->keys[s] == 0)
+        continue;
+
+      masks[masks_cnt].key   = total->keys[s];
+      masks[masks_cnt].count = total->counts[s];
+
+      masks_cnt++;
+    }
+
+    qsort (masks, masks_cnt, sizeof (hc_prof_mask_t), hc_prof_mask_cmp);
+  }
+
+  PyObject *rtn = NULL;
+
+  if (failed != -1)
+  {
+    errno = saved_errno;
+    PyErr_SetFromErrnoWithFilename (PyExc_IOError, PyString_AsString (PyList_GetItem (files, failed)));
+  }
+  else
+  {
+
+    PyObject *lengths  = PyList_New (0);
+    PyObject *chars    = PyDict_New ();
+    PyObject *charsets = PyDict_New ();
+    PyObject *mask_list = PyList_New (0);
+
+    int ok = (lengths != NULL) && (chars != NULL) && (charsets != NULL) && (mask_list != NULL);
+
+    // Lengths up to the longest line seen
+    int last = HC_PROF_LEN_MAX;
+
+    while ((last > 0) && (total->lengths[last] == 0))
+      last--;
+
+    for (int l = 0; (ok) && (l <= last); l++)
+    {
+      PyObject *cnt = PyLong_FromUnsignedLongLong (total->lengths[l]);
+
+      ok = (cnt != NULL) && (PyList_Append (lengths, cnt) == 0);
+
+      Py_XDECREF (cnt);
+    }
+
+    for (int c = HC_PROF_CLASS_L; (ok) && (c <= HC_PROF_CLASS_B); c++)
+    {
+      const char name[2] = { hc_prof_class_chars[c], 0 };
+
+      PyObject *cnt = PyLong_FromUnsignedLongLong (total->chars[c]);
+
+      ok = (cnt != NULL) && (PyDict_SetItemString (chars, name, cnt) == 0);
+
+      Py_XDECREF (cnt);
+    }
+
+    for (int s = 1; (ok) && (s < 32); s++)
+    {
+
+      if (total->charsets[s] == 0)
+        continue;
+
+      char name[6];
+      int name_len = 0;
+
+      for (int c = HC_PROF_CLASS_L; c <= HC_PROF_CLASS_B; c++)
+      {
+        if (s & (1 << (c - 1)))
+          name[name_len++] = hc_prof_class_chars[c];
+      }
+
+      name[name_len] = 0;
+
+      PyObject *cnt = PyLong_FromUnsignedLongLong (total->charsets[s]);
+
+      ok = (cnt != NULL) && (PyDict_SetItemString (charsets, name, cnt) == 0);
+
+      Py_XDECREF (cnt);
+    }
+
+    for (size_t m = 0; (ok) && (m < masks_cnt) && ((int) m < top); m++)
+    {
+
+      char mask[HC_PROF_MASK_MAX * 2 + 1];
+      int mask_len = 0;
+
+      // The key holds 3 bits per position, the first position highest
+      int positions = 0;
+
+      for (u64 key = masks[m].key; key != 0; key >>= 3)
+        positions++;
+
+      for (int p = positions - 1; p >= 0; p--)
+      {
+        mask[mask_len++] = '?';
+        mask[mask_len++] = hc_prof_class_chars[(masks[m].key >> (p * 3)) & 7];
+      }
+
+      PyObject *pair = Py_BuildValue ("(s#K)", mask, (Py_ssize_t) mask_len, (unsigned long long) masks[m].count);
+
+      ok = (pair != NULL) && (PyList_Append (mask_list, pair) == 0);
+
+      Py_XDECREF (pair);
+    }
+
+    if (ok)
+      rtn = Py_BuildValue ("{s:K,s:K,s:O,s:O,s:O,s:O,s:K,s:K,s:d}",
+        "lines",          (unsigned long long) total->lines,
+        "bytes",          (unsigned long long) total->bytes,
+        "lengths",        lengths,
+        "chars",          chars,
+        "charsets",       charsets,
+        "masks",          mask_list,
+        "masks_distinct", (unsigned long long) masks_cnt,
+        "masks_skipped",  (unsigned long long) total->masks_skipped,
+        "seconds",        seconds);
+
+    Py_XDECREF (lengths);
+    Py_XDECREF (chars);
+    Py_XDECREF (charsets);
+    Py_XDECREF (mask_list);
+  }
+
+  free (masks);
+  free (total->keys);
+  free (total->counts);
+  free (total);
+  Py_DECREF (files);
+
+  return rtn;
+
+}
+
+/* Combinator work units. hashcat iterates the larger of the two wordlists (the base, dict2 when it has
+   more words, with the lists swapped internally) and runs every base word against the whole other
+   list on the device, skip and limit count base words. Units are equal runs of base words, or runs in
+   proportion to the given speeds, so every unit holds the same share of candidates */
+
+/* Words of a combinator wordlist as hashcat counts them, from the dictstat file when it has a current
+   entry. Return 0, or -1 with a python error set */
+
+static int hashcat_dict_words (hashcatObject * self, PyObject * dict, const int dict_fd, const int threads, const cpu_set_t * cpus, u64 * words, int * cached)
 {
 
-  int rtn;
+  *words  = 0;
+  *cached = 0;
+
+  hc_lines_t lines;
+
+  memset (&lines, 0, sizeof (lines));
+
+  int kind = HC_GZ_NONE;
+
+  const char *path = NULL;
+
+  if (dict_fd != -1)
+  {
+
+    struct stat st;
+
+    if ((fstat (dict_fd, &st) == -1) || (hc_lines_map (&lines, dict_fd, st.st_size) == -1))
+    {
+      PyErr_SetFromErrnoWithFilename (PyExc_IOError, "<buffer>");
+
+      hc_lines_close (&lines);
+      return -1;
+    }
+  }
+  else if (PyString_Check (dict))
+  {
+
+    path = PyString_AsString (dict);
+
+    // gzip wordlists are counted as decoded, hashcat gets them in a memfd with no cache entry
+    kind = hashcat_wordlist_open (path, threads, cpus, &lines);
+
+    if (kind == -1)
+      return -1;
+  }
+  else
+  {
+    PyErr_SetString (PyExc_TypeError, "Combinator wordlists must be paths or buffers");
+    return -1;
+  }
+
+  if ((path != NULL) && (kind == HC_GZ_NONE))
+  {
+
+    char default_path[PATH_MAX];
+
+    const char *dictstat_path = hashcat_dictstat (self, NULL, default_path, sizeof (default_path));
+
+    const int dictstat_fd = (dictstat_path == NULL) ? -1 : open (dictstat_path, O_RDONLY | O_CLOEXEC);
+
+    // The cache is an optimization, a missing or unreadable one means counting
+    PyErr_Clear ();
+
+    dictstat_t *base = NULL;
+
+    const ssize_t cnt = (dictstat_fd == -1) ? 0 : hc_dictstat_read (dictstat_fd, &base);
+
+    dictstat_t key;
+
+    hashcat_dictstat_key (self, &lines.st, &key);
+
+    for (ssize_t i = 0; (i < cnt) && (!*cached); i++)
+    {
+      if (hc_dictstat_match (&base[i], &key, 0))
+      {
+        *words  = base[i].cnt;
+        *cached = 1;
+      }
+    }
+
+    free (base);
+
+    if (dictstat_fd != -1)
+      close (dictstat_fd);
+  }
+
+  int rc = 0;
+
+  if (!*cached)
+  {
+
+    Py_BEGIN_ALLOW_THREADS
+
+    rc = hc_count_words (&lines, threads, cpus, words);
+
+    Py_END_ALLOW_THREADS
+
+    if (rc == -1)
+      PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) ((path != NULL) ? path : "<buffer>"));
+  }
+
+  hc_lines_close (&lines);
+
+  return rc;
 
-  rtn = hashcat_session_pause (self->hashcat_ctx);
-  return Py_BuildValue ("i", rtn);
 }
 
-PyDoc_STRVAR(hashcat_session_resume__doc__,
-"hashcat_session_resume -> int\n\n\
-Resume hashcat cracking session.\n\n\
-Return 0 on success, -1 on error");
+PyDoc_STRVAR(combinator_units__doc__,
+"combinator_units(units, dict1=None, dict2=None, threads=0) -> dict\n\n\
+Split a combinator attack (attack_mode 1) into balanced skip/limit work units.\n\n\
+units\t\tint|list\tNumber of equal units, or the relative speed of every unit\n\
+dict1\t\tstr|buffer\tLeft wordlist, defaults to dict1\n\
+dict2\t\tstr|buffer\tRight wordlist, defaults to dict2\n\
+threads\t\tint\tCounting threads, 0 uses every online CPU\n\n\
+Words are counted as hashcat counts them, taken from the dictstat file when it has a\n\
+current entry. hashcat iterates the list with more words (the base, dict1 on a tie)\n\
+and skip and limit count its words, so units are runs of base words with the same\n\
+number of candidates each, or a number proportional to their speed. Run each unit\n\
+with the same dict1 and dict2 and the unit's skip and limit. Units get at least one\n\
+base word, with fewer base words than units the surplus units are left out.\n\n\
+Return a dict with words1, words2, base (1 or 2), keyspace (base words, what\n\
+--keyspace reports), candidates (words1 * words2), cached (per wordlist, whether the\n\
+count came from the dictstat file) and units, a list of dicts with skip, limit and\n\
+candidates.\n\n");
+
+static PyObject *hashcat_combinator_units (hashcatObject * self, PyObject * args, PyObject * kwargs)
+{
 
-static PyObject *hashcat_hashcat_session_resume (hashcatObject * self, PyObject * noargs)
+  PyObject *units;
+  PyObject *dict1 = NULL;
+  PyObject *dict2 = NULL;
+  int threads = 0;
+  static char *kwlist[] = {"units", "dict1", "dict2", "threads", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOi", kwlist, &units, &dict1, &dict2, &threads))
+  {
+    return NULL;
+  }
+
+  // Relative speeds, one per unit
+  PyObject *speeds = NULL;
+
+  if (PyInt_Check (units) || PyLong_Check (units))
+  {
+
+    const long cnt = PyInt_AsLong (units);
+
+    if ((cnt < 1) || (cnt > 1000000))
+    {
+      if (!PyErr_Occurred ())
+        PyErr_SetString (PyExc_ValueError, "units must be between 1 and 1000000");
+
+      return NULL;
+    }
+
+    speeds = PyList_New (0);
+
+    for (long i = 0; (speeds != NULL) && (i < cnt); i++)
+    {
+      PyObject *one = PyFloat_FromDouble (1.0);
+
+      if ((one == NULL) || (PyList_Append (speeds, one) == -1))
+        Py_CLEAR (speeds);
+
+      Py_XDECREF (one);
+    }
+  }
+  else
+  {
+    speeds = PySequence_List (units);
+  }
+
+  if (speeds == NULL)
+    return NULL;
+
+  const Py_ssize_t units_cnt = PyList_Size (speeds);
+
+  double *cumulative = (double *) calloc (units_cnt + 1, sizeof (double));
+
+  if (cumulative == NULL)
+  {
+    Py_DECREF (speeds);
+    return PyErr_NoMemory ();
+  }
+
+  int failed = (units_cnt == 0);
+
+  if (failed)
+    PyErr_SetString (PyExc_ValueError, "units must not be empty");
+
+  for (Py_ssize_t i = 0; (!failed) && (i < units_cnt); i++)
+  {
+
+    const double speed = PyFloat_AsDouble (PyList_GetItem (speeds, i));
+
+    if (PyErr_Occurred ())
+    {
+      failed = 1;
+      break;
+    }
+
+    if (!(speed > 0))
+    {
+      PyErr_SetString (PyExc_ValueError, "Unit speeds must be positive");
+      failed = 1;
+      break;
+    }
+
+    cumulative[i + 1] = cumulative[i] + speed;
+  }
+
+  Py_DECREF (speeds);
+
+  if ((dict1 == NULL) || (dict1 == Py_None))
+    dict1 = self->dict1;
+
+  if ((dict2 == NULL) || (dict2 == Py_None))
+    dict2 = self->dict2;
+
+  if ((!failed) && ((dict1 == NULL) || (dict2 == NULL)))
+  {
+    PyErr_SetString (PyExc_ValueError, "A combinator attack needs dict1 and dict2");
+    failed = 1;
+  }
+
+  threads = hc_threads_default (threads);
+
+  cpu_set_t cpus;
+
+  const int pinned = (failed) ? 0 : hashcat_placement (self, &cpus);
+
+  if (pinned == -1)
+    failed = 1;
+
+  u64 words[2] = { 0, 0 };
+  int cached[2] = { 0, 0 };
+
+  PyObject *dicts[2] = { dict1, dict2 };
+
+  for (int i = 0; (!failed) && (i < 2); i++)
+  {
+
+    // The wordlists as set may be buffers held in memfds, other values are taken as given
+    const int fd = (dicts[i] == self->dict1) ? self->dict1_fd : (dicts[i] == self->dict2) ? self->dict2_fd : -1;
+
+    int memfd = -1;
+
+    if ((fd == -1) && (!PyString_Check (dicts[i])))
+    {
+
+      if ((dicts[i] == self->dict1) || (dicts[i] == self->dict2))
+      {
+        PyErr_SetString (PyExc_ValueError, "Streamed wordlists can not be counted, pass the words as a buffer");
+        failed = 1;
+        break;
+      }
+
+      memfd = hc_memfd_from_object ("pyhashcat-combinator", dicts[i]);
+
+      if (memfd == -1)
+      {
+        failed = 1;
+        break;
+      }
+    }
+
+    if (hashcat_dict_words (self, dicts[i], (memfd != -1) ? memfd : fd, threads, (pinned == 1) ? &cpus : NULL, &words[i], &cached[i]) == -1)
+      failed = 1;
+
+    hc_fd_close (&memfd);
+  }
+
+  PyObject *rtn = NULL;
+
+  if (!failed)
+  {
+
+    const int base = (words[0] >= words[1]) ? 1 : 2;
+
+    const u64 base_words  = (base == 1) ? words[0] : words[1];
+    const u64 combs_words = (base == 1) ? words[1] : words[0];
+
+    PyObject *unit_list = PyList_New (0);
+
+    u64 skip = 0;
+
+    for (Py_ssize_t i = 0; (unit_list != NULL) && (i < units_cnt); i++)
+    {
+
+      u64 limit = (i == units_cnt - 1) ? base_words : (u64) ((double) base_words * (cumulative[i + 1] / cumulative[units_cnt]));
+
+      if (limit > base_words)
+        limit = base_words;
+
+      // A limit of 0 means no limit to hashcat, empty units are left out
+      if (limit <= skip)
+        continue;
+
+      PyObject *unit = Py_BuildValue ("{s:K,s:K,s:K}",
+        "skip",       (unsigned long long) skip,
+        "limit",      (unsigned long long) limit,
+        "candidates", (unsigned long long) ((limit - skip) * combs_words));
+
+      if ((unit == NULL) || (PyList_Append (unit_list, unit) == -1))
+        Py_CLEAR (unit_list);
+
+      Py_XDECREF (unit);
+
+      skip = limit;
+    }
+
+    if (unit_list != NULL)
+      rtn = Py_BuildValue ("{s:K,s:K,s:i,s:K,s:K,s:O,s:(OO)}",
+        "words1",     (unsigned long long) words[0],
+        "words2",     (unsigned long long) words[1],
+        "base",       base,
+        "keyspace",   (unsigned long long) base_words,
+        "candidates", (unsigned long long) (words[0] * words[1]),
+        "units",      unit_list,
+        "cached",     cached[0] ? Py_True : Py_False, cached[1] ? Py_True : Py_False);
+
+    Py_XDECREF (unit_list);
+  }
+
+  free (cumulative);
+
+  return rtn;
+
+}
+
+/* Ordered wordlists */
+
+static int hashcat_wordlists_assign (hashcatObject * self, PyObject * files);
+
+PyDoc_STRVAR(set_wordlists__doc__,
+"set_wordlists(paths, key=None, reverse=False) -> list\n\n\
+Set the wordlists of a straight attack in a chosen order, see wordlists.\n\n\
+paths\t\tstr|list\tWordlists and directories of wordlists\n\
+key\t\tstr|callable\tNone keeps the given order, \"name\", \"size\" or \"mtime\", or a function of the path\n\
+reverse\t\tbool\tDescending order, wordlists with equal keys keep their given order\n\n\
+Return the wordlists in the order hashcat will run them.\n\n");
+
+static PyObject *hashcat_set_wordlists (hashcatObject * self, PyObject * args, PyObject * kwargs)
 {
 
-  int rtn;
+  PyObject *paths;
+  PyObject *key = Py_None;
+  int reverse = 0;
+  static char *kwlist[] = {"paths", "key", "reverse", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Oi", kwlist, &paths, &key, &reverse))
+  {
+    return NULL;
+  }
+
+  const char *key_name = PyString_Check (key) ? PyString_AsString (key) : NULL;
+
+  if ((key_name != NULL) && (strcmp (key_name, "name") != 0) && (strcmp (key_name, "size") != 0) && (strcmp (key_name, "mtime") != 0))
+  {
+    PyErr_Format (PyExc_ValueError, "Unknown key %s, use name, size, mtime or a function", key_name);
+    return NULL;
+  }
+
+  if ((key != Py_None) && (key_name == NULL) && (!PyCallable_Check (key)))
+  {
+    PyErr_SetString (PyExc_TypeError, "key must be a string or a function");
+    return NULL;
+  }
+
+  PyObject *files = hc_wordlist_paths (paths);
+
+  if (files == NULL)
+    return NULL;
+
+  const Py_ssize_t files_cnt = PyList_Size (files);
+
+  int failed = 0;
+
+  if (key != Py_None)
+  {
+
+    // Decorated with the position, which keeps the sort stable either way
+    PyObject *decorated = PyList_New (files_cnt);
+
+    failed = (decorated == NULL);
+
+    for (Py_ssize_t i = 0; (!failed) && (i < files_cnt); i++)
+    {
+
+      PyObject *path = PyList_GET_ITEM (files, i);
+
+      PyObject *value = NULL;
+
+      struct stat st;
+
+      if (key_name == NULL)
+      {
+        value = PyObject_CallFunctionObjArgs (key, path, NULL);
+      }
+      else if (strcmp (key_name, "name") == 0)
+      {
+        Py_INCREF (path);
+        value = path;
+      }
+      else if (stat (PyString_AS_STRING (path), &st) == -1)
+      {
+        PyErr_SetFromErrnoWithFilename (PyExc_IOError, PyString_AS_STRING (path));
+      }
+      else if (strcmp (key_name, "size") == 0)
+      {
+        value = PyLong_FromLongLong ((long long) st.st_size);
+      }
+      else
+      {
+        value = PyFloat_FromDouble ((double) st.st_mtim.tv_sec + (double) st.st_mtim.tv_nsec / 1e9);
+      }
 
-  rtn = hashcat_session_resume (self->hashcat_ctx);
-  return Py_BuildValue ("i", rtn);
-}
+      PyObject *item = (value == NULL) ? NULL : Py_BuildValue ("(NnO)", value, reverse ? -i : i, path);
 
-PyDoc_STRVAR(hashcat_session_bypass__doc__,
-"hashcat_session_bypass -> int\n\n\
-Bypass current attack and go to next. Only applicable when using multiple wordlists or masks\n\n\
-Return 0 on success, -1 on error");
+      if (item == NULL)
+      {
+        failed = 1;
+        break;
+      }
 
-static PyObject *hashcat_hashcat_session_bypass (hashcatObject * self, PyObject * noargs)
-{
+      PyList_SET_ITEM (decorated, i, item);
+    }
 
-  int rtn;
+    if ((!failed) && (PyList_Sort (decorated) == -1))
+      failed = 1;
 
-  rtn = hashcat_session_bypass (self->hashcat_ctx);
-  return Py_BuildValue ("i", rtn);
-}
+    if ((!failed) && (reverse))
+      PyList_Reverse (decorated);
 
-PyDoc_STRVAR(hashcat_session_checkpoint__doc__,
-"hashcat_session_checkpoint -> int\n\n\
-Stop at next restore point. This feature is disabled when restore_disabled is specified, and will return error\n\n\
-Return 0 on success, -1 on error");
+    for (Py_ssize_t i = 0; (!failed) && (i < files_cnt); i++)
+    {
 
-static PyObject *hashcat_hashcat_session_checkpoint (hashcatObject * self, PyObject * noargs)
-{
+      PyObject *path = PyTuple_GET_ITEM (PyList_GET_ITEM (decorated, i), 2);
 
-  int rtn;
+      Py_INCREF (path);
+      PyList_SetItem (files, i, path);
+    }
 
-  rtn = hashcat_session_checkpoint (self->hashcat_ctx);
-  return Py_BuildValue ("i", rtn);
-}
+    Py_XDECREF (decorated);
+  }
 
-PyDoc_STRVAR(hashcat_session_quit__doc__,
-"hashcat_session_quit -> int\n\n\
-Quit hashcat session.\n\n\
-Return 0 on success");
+  if ((!failed) && (hashcat_wordlists_assign (self, files) == -1))
+    failed = 1;
 
-static PyObject *hashcat_hashcat_session_quit (hashcatObject * self, PyObject * noargs)
-{
+  if (failed)
+  {
+    Py_DECREF (files);
+    return NULL;
+  }
 
-  int rtn;
+  return files;
 
-  rtn = hashcat_session_quit (self->hashcat_ctx);
-  return Py_BuildValue ("i", rtn);
 }
 
 PyDoc_STRVAR(status_get_device_info_cnt__doc__,
@@ -1774,7 +14676,13 @@ static PyObject *hashcat_status_get_runtime_msec_dev (hashcatObject * self, PyOb
 
 
 PyDoc_STRVAR(hash__doc__,
-"hash\tstr\thash|hashfile|hccapfile\n\n");
+"hash\tstr|list|buffer\thash|hashfile|hccapfile|hashlist\n\n\
+DETAILS:\n\
+A string is a single hash or a path, as on the command line. A list or tuple of\n\
+strings, a string containing newlines, or any buffer object (bytearray, memoryview,\n\
+mmap) is an in-memory hashlist. Its content is copied once into an anonymous memory\n\
+file when assigned and handed to hashcat without an on-disk copy.\n\
+\n");
 
 static PyObject *hashcat_gethash (hashcatObject * self)
 {
@@ -1785,6 +14693,7 @@ static PyObject *hashcat_gethash (hashcatObject * self)
     return Py_None;
   }
 
+  Py_INCREF (self->hash);
   return self->hash;
 
 }
@@ -1800,13 +14709,32 @@ static int hashcat_sethash (hashcatObject * self, PyObject * value, void *closur
     return -1;
   }
 
-  if (!PyString_Check (value))
+  int fd = -1;
+
+  // A plain string is a hash or a path, hashes and paths never contain newlines
+  if (PyString_Check (value) && (memchr (PyString_AS_STRING (value), '\n', PyString_GET_SIZE (value)) == NULL))
+  {
+    fd = -1;
+  }
+  else if (PyString_Check (value) || PyList_Check (value) || PyTuple_Check (value) || PyObject_CheckBuffer (value) || PyObject_CheckReadBuffer (value))
+  {
+
+    fd = hc_memfd_from_object ("pyhashcat-hashlist", value);
+
+    if (fd == -1)
+      return -1;
+  }
+  else
   {
 
-    PyErr_SetString (PyExc_TypeError, "The hash attribute value must be a string");
+    PyErr_SetString (PyExc_TypeError, "The hash attribute value must be a string, a list of strings or a buffer");
     return -1;
   }
 
+  hc_fd_close (&self->hash_fd);
+
+  self->hash_fd = fd;
+
   Py_XDECREF (self->hash);
   Py_INCREF (value);            // Increment the value or garbage collection will eat it
   self->hash = value;
@@ -1815,8 +14743,38 @@ static int hashcat_sethash (hashcatObject * self, PyObject * value, void *closur
 
 }
 
+/* Wordlists held in memory. On python 2 a str is always a path, raw wordlist data comes as
+   bytearray, memoryview, buffer or mmap */
+
+static int hc_dict_is_buffer (PyObject * value)
+{
+
+  if (PyString_Check (value) || PyUnicode_Check (value))
+    return 0;
+
+  return PyObject_CheckBuffer (value) || PyObject_CheckReadBuffer (value);
+
+}
+
 PyDoc_STRVAR(dict1__doc__,
-"dict1\tstr\tdictionary|directory\n\n");
+"dict1\tstr|buffer|iterable|file\tdictionary|directory, an in-memory wordlist or candidates streamed to a straight attack\n\n\
+A buffer object (bytearray, memoryview, buffer, mmap) is copied once into a sealed\n\
+anonymous memory file and handed to hashcat as its /proc/self/fd path, so dictstat\n\
+and the wordlist code work as with a file, without the data touching the filesystem.\n\
+An iterable of strings or an object with a read() method is fed to hashcat's stdin\n\
+mode from a background thread while the session runs, candidates are never written\n\
+to disk. Iterables get a newline after each candidate that lacks one, read() data is\n\
+passed as is. Only one session per process can stream at a time.\n\
+gzip compressed wordlists (dict1 and dict2) are decompressed by native threads, BGZF\n\
+files from bgzip block-parallel, ahead of hashcat reading them. Straight attacks\n\
+stream dict1 like an iterable: the session runs in stdin mode, so there is no\n\
+keyspace, progress is not relative to a total and has no ETA, skip, limit and\n\
+keyspace raise ValueError, restoring the session does not resume the wordlist and\n\
+only one such session per process can run at a time. Combinator and hybrid attacks\n\
+read their wordlists more than once, so they cannot be streamed: each gzip wordlist\n\
+is decompressed into an anonymous memory file that takes its decompressed size in\n\
+RAM for the session. execute raises ValueError for one that decompresses to more\n\
+than 1 GiB. Decompress large wordlists to disk first where either matters.\n\n");
 
 static PyObject *hashcat_getdict1 (hashcatObject * self)
 {
@@ -1827,6 +14785,7 @@ static PyObject *hashcat_getdict1 (hashcatObject * self)
     return Py_None;
   }
 
+  Py_INCREF (self->dict1);
   return self->dict1;
 
 }
@@ -1842,13 +14801,29 @@ static int hashcat_setdict1 (hashcatObject * self, PyObject * value, void *closu
     return -1;
   }
 
-  if (!PyString_Check (value))
+  int fd = -1;
+
+  if (hc_dict_is_buffer (value))
+  {
+
+    fd = hc_memfd_from_object ("pyhashcat-dict1", value);
+
+    if (fd == -1)
+      return -1;
+  }
+  else if (PyUnicode_Check (value) || ((!PyString_Check (value)) && (!PyObject_HasAttrString (value, "read")) && (Py_TYPE (value)->tp_iter == NULL) && (!PySequence_Check (value))))
   {
 
-    PyErr_SetString (PyExc_TypeError, "The dict1 attribute value must be a string");
+    PyErr_SetString (PyExc_TypeError, "The dict1 attribute value must be a string, a buffer, an iterable or a file-like object");
     return -1;
   }
 
+  hc_fd_close (&self->dict1_fd);
+
+  self->dict1_fd = fd;
+
+  Py_CLEAR (self->wordlists);
+
   Py_XDECREF (self->dict1);
   Py_INCREF (value);            // Increment the value or garbage collection will eat it
   self->dict1 = value;
@@ -1858,7 +14833,7 @@ static int hashcat_setdict1 (hashcatObject * self, PyObject * value, void *closu
 }
 
 PyDoc_STRVAR(dict2__doc__,
-"dict2\tstr\tdictionary\n\n");
+"dict2\tstr|buffer\tdictionary, or an in-memory wordlist as for dict1\n\n");
 
 static PyObject *hashcat_getdict2 (hashcatObject * self)
 {
@@ -1869,6 +14844,7 @@ static PyObject *hashcat_getdict2 (hashcatObject * self)
     return Py_None;
   }
 
+  Py_INCREF (self->dict2);
   return self->dict2;
 
 }
@@ -1884,13 +14860,27 @@ static int hashcat_setdict2 (hashcatObject * self, PyObject * value, void *closu
     return -1;
   }
 
-  if (!PyString_Check (value))
+  int fd = -1;
+
+  if (hc_dict_is_buffer (value))
+  {
+
+    fd = hc_memfd_from_object ("pyhashcat-dict2", value);
+
+    if (fd == -1)
+      return -1;
+  }
+  else if (!PyString_Check (value))
   {
 
-    PyErr_SetString (PyExc_TypeError, "The dict2 attribute value must be a string");
+    PyErr_SetString (PyExc_TypeError, "The dict2 attribute value must be a string or a buffer");
     return -1;
   }
 
+  hc_fd_close (&self->dict2_fd);
+
+  self->dict2_fd = fd;
+
   Py_XDECREF (self->dict2);
   Py_INCREF (value);            // Increment the value or garbage collection will eat it
   self->dict2 = value;
@@ -1899,6 +14889,141 @@ static int hashcat_setdict2 (hashcatObject * self, PyObject * value, void *closu
 
 }
 
+/* Take files, a list of wordlist paths, as the wordlists of a straight attack in place of dict1.
+   Return 0 or -1 with a python error set */
+
+static int hashcat_wordlists_assign (hashcatObject * self, PyObject * files)
+{
+
+  const Py_ssize_t files_cnt = PyList_Size (files);
+
+  if (files_cnt == 0)
+  {
+    PyErr_SetString (PyExc_ValueError, "No wordlists found");
+    return -1;
+  }
+
+  for (Py_ssize_t i = 0; i < files_cnt; i++)
+  {
+
+    const char *path = PyString_AsString (PyList_GetItem (files, i));
+
+    struct stat st;
+
+    if (stat (path, &st) == -1)
+    {
+      PyErr_SetFromErrnoWithFilename (PyExc_IOError, (char *) path);
+      return -1;
+    }
+
+    // hashcat reads these directly, nothing in between decompresses them
+    if (hc_gz_detect (path) != HC_GZ_NONE)
+    {
+      PyErr_Format (PyExc_ValueError, "%s is compressed, set it as dict1 instead", path);
+      return -1;
+    }
+  }
+
+  PyObject *wordlists = PyList_AsTuple (files);
+
+  if (wordlists == NULL)
+    return -1;
+
+  Py_CLEAR (self->dict1);
+
+  hc_fd_close (&self->dict1_fd);
+
+  Py_XDECREF (self->wordlists);
+  self->wordlists = wordlists;
+
+  return 0;
+
+}
+
+PyDoc_STRVAR(wordlists__doc__,
+"wordlists\tlist\tordered wordlists of a straight attack, in place of dict1\n\n\
+hashcat works through them in the given order, directories contribute their files\n\
+in name order. Setting wordlists clears dict1 and setting dict1 clears wordlists.\n\
+While the session runs, wordlist_prefetch wordlists after the current one are read\n\
+into the page cache ahead of hashcat, see set_wordlists for other orders.\n\n");
+
+static PyObject *hashcat_getwordlists (hashcatObject * self)
+{
+
+  if (self->wordlists == NULL)
+  {
+    Py_INCREF (Py_None);
+    return Py_None;
+  }
+
+  return PySequence_List (self->wordlists);
+
+}
+
+
+static int hashcat_setwordlists (hashcatObject * self, PyObject * value, void *closure)
+{
+
+  if (value == NULL)
+  {
+
+    PyErr_SetString (PyExc_TypeError, "Cannot delete wordlists attribute");
+    return -1;
+  }
+
+  if (value == Py_None)
+  {
+    Py_CLEAR (self->wordlists);
+    return 0;
+  }
+
+  PyObject *files = hc_wordlist_paths (value);
+
+  if (files == NULL)
+    return -1;
+
+  const int rc = hashcat_wordlists_assign (self, files);
+
+  Py_DECREF (files);
+
+  return rc;
+
+}
+
+PyDoc_STRVAR(wordlist_prefetch__doc__,
+"wordlist_prefetch\tint\twordlists read ahead into the page cache during a session, 0 disables (default 1)\n\n");
+
+static PyObject *hashcat_getwordlist_prefetch (hashcatObject * self)
+{
+
+  return Py_BuildValue ("i", self->wordlist_prefetch);
+
+}
+
+
+static int hashcat_setwordlist_prefetch (hashcatObject * self, PyObject * value, void *closure)
+{
+
+  if (value == NULL)
+  {
+
+    PyErr_SetString (PyExc_TypeError, "Cannot delete wordlist_prefetch attribute");
+    return -1;
+  }
+
+  if ((!PyInt_Check (value)) || (PyInt_AsLong (value) < 0))
+  {
+
+    PyErr_SetString (PyExc_TypeError, "The wordlist_prefetch attribute value must be a non-negative int");
+    return -1;
+  }
+
+  self->wordlist_prefetch = PyInt_AsLong (value);
+
+  return 0;
+
+}
+
 PyDoc_STRVAR(mask__doc__,
 "mask\tstr\tmask|directory\n\n");
 
@@ -1911,6 +15036,7 @@ static PyObject *hashcat_getmask (hashcatObject * self)
     return Py_None;
   }
 
+  Py_INCREF (self->mask);
   return self->mask;
 
 }
@@ -3970,6 +17096,9 @@ PyDoc_STRVAR(potfile_disable__doc__,
 static PyObject *hashcat_getpotfile_disable (hashcatObject * self)
 {
 
+  if (self->potfile_disable_saved != -1)
+    return PyBool_FromLong (self->potfile_disable_saved);
+
   return PyBool_FromLong (self->user_options->potfile_disable);
 
 }
@@ -3992,7 +17121,14 @@ static int hashcat_setpotfile_disable (hashcatObject * self, PyObject * value, v
     return -1;
   }
 
-  if (PyObject_IsTrue (value))
+  // Kept aside while the potfile sink holds it on
+  if (self->potfile_disable_saved != -1)
+  {
+
+    self->potfile_disable_saved = PyObject_IsTrue (value);
+
+  }
+  else if (PyObject_IsTrue (value))
   {
 
     Py_INCREF (value);
@@ -4789,6 +17925,138 @@ static int hashcat_setsession (hashcatObject * self, PyObject * value, void *clo
 
 }
 
+PyDoc_STRVAR(session_cpus__doc__,
+"session_cpus\tstr\tPin the session thread to a CPU list, ex: 0-3,8\n\n\
+DETAILS:\n\
+Applied when hashcat_session_execute creates the session thread, and to the host-side\n\
+helper threads of this object: gzip decoders, the dict1 stream feeder, the wordlist\n\
+prefetch and the worker threads of load_user_map, prepare_wordlist, prewarm_wordlists\n\
+and combinator_units. Combined with session_numa_nodes if both are set. cpu_affinity\n\
+still controls libhashcat's own threads.\n\n");
+
+// getter - session_cpus
+static PyObject *hashcat_getsession_cpus (hashcatObject * self)
+{
+
+  if (self->session_cpus == NULL)
+  {
+    Py_INCREF (Py_None);
+    return Py_None;
+  }
+
+  Py_INCREF (self->session_cpus);
+  return self->session_cpus;
+
+}
+
+// setter - session_cpus
+static int hashcat_setsession_cpus (hashcatObject * self, PyObject * value, void *closure)
+{
+
+  if (value == NULL)
+  {
+
+    PyErr_SetString (PyExc_TypeError, "Cannot delete session_cpus attribute");
+    return -1;
+  }
+
+  if (value == Py_None)
+  {
+
+    Py_CLEAR (self->session_cpus);
+    return 0;
+  }
+
+  if (!PyString_Check (value))
+  {
+
+    PyErr_SetString (PyExc_TypeError, "The session_cpus attribute value must be a string");
+    return -1;
+  }
+
+  cpu_set_t set;
+
+  CPU_ZERO (&set);
+
+  if (hc_cpulist_parse (PyString_AsString (value), &set) == -1)
+  {
+
+    PyErr_Format (PyExc_ValueError, "Invalid CPU list: %s", PyString_AsString (value));
+    return -1;
+  }
+
+  Py_XDECREF (self->session_cpus);
+  Py_INCREF (value);
+  self->session_cpus = value;
+
+  return 0;
+
+}
+
+PyDoc_STRVAR(session_numa_nodes__doc__,
+"session_numa_nodes\tstr\tPin the session thread to the CPUs of NUMA nodes, ex: 0 or 0-1\n\n\
+DETAILS:\n\
+Node CPUs are read from /sys/devices/system/node whenever threads are placed.\n\n");
+
+// getter - session_numa_nodes
+static PyObject *hashcat_getsession_numa_nodes (hashcatObject * self)
+{
+
+  if (self->session_numa_nodes == NULL)
+  {
+    Py_INCREF (Py_None);
+    return Py_None;
+  }
+
+  Py_INCREF (self->session_numa_nodes);
+  return self->session_numa_nodes;
+
+}
+
+// setter - session_numa_nodes
+static int hashcat_setsession_numa_nodes (hashcatObject * self, PyObject * value, void *closure)
+{
+
+  if (value == NULL)
+  {
+
+    PyErr_SetString (PyExc_TypeError, "Cannot delete session_numa_nodes attribute");
+    return -1;
+  }
+
+  if (value == Py_None)
+  {
+
+    Py_CLEAR (self->session_numa_nodes);
+    return 0;
+  }
+
+  if (!PyString_Check (value))
+  {
+
+    PyErr_SetString (PyExc_TypeError, "The session_numa_nodes attribute value must be a string");
+    return -1;
+  }
+
+  cpu_set_t set;
+
+  CPU_ZERO (&set);
+
+  if (hc_cpulist_parse (PyString_AsString (value), &set) == -1)
+  {
+
+    PyErr_Format (PyExc_ValueError, "Invalid NUMA node list: %s", PyString_AsString (value));
+    return -1;
+  }
+
+  Py_XDECREF (self->session_numa_nodes);
+  Py_INCREF (value);
+  self->session_numa_nodes = value;
+
+  return 0;
+
+}
+
 PyDoc_STRVAR(show__doc__,
 "show\tbool\tCompare hashlist with potfile; Show cracked hashes\n\n");
 
@@ -5199,13 +18467,43 @@ static int hashcat_setworkload_profile (hashcatObject * self, PyObject * value,
 static PyMethodDef hashcat_methods[] = {
   
   {"event_connect", (PyCFunction) hashcat_event_connect, METH_VARARGS|METH_KEYWORDS, event_connect__doc__},
-  {"reset", (PyCFunction) hashcat_reset, METH_NOARGS, reset__doc__},
+  {"reset", (PyCFunction) hashcat_reset, METH_VARARGS|METH_KEYWORDS, reset__doc__},
+  {"close", (PyCFunction) hashcat_close, METH_NOARGS, close__doc__},
+  {"__enter__", (PyCFunction) hashcat_enter, METH_NOARGS, enter__doc__},
+  {"__exit__", (PyCFunction) hashcat_exit, METH_VARARGS, exit__doc__},
   {"hashcat_session_execute", (PyCFunction) hashcat_hashcat_session_execute, METH_VARARGS|METH_KEYWORDS, hashcat_session_execute__doc__},
+  {"hashcat_session_execute_batch", (PyCFunction) hashcat_hashcat_session_execute_batch, METH_VARARGS|METH_KEYWORDS, hashcat_session_execute_batch__doc__},
   {"hashcat_session_pause", (PyCFunction) hashcat_hashcat_session_pause, METH_NOARGS, hashcat_session_pause__doc__},
   {"hashcat_session_resume", (PyCFunction) hashcat_hashcat_session_resume, METH_NOARGS, hashcat_session_resume__doc__},
   {"hashcat_session_bypass", (PyCFunction) hashcat_hashcat_session_bypass, METH_NOARGS, hashcat_session_bypass__doc__},
   {"hashcat_session_checkpoint", (PyCFunction) hashcat_hashcat_session_checkpoint, METH_NOARGS, hashcat_session_checkpoint__doc__},
   {"hashcat_session_quit", (PyCFunction) hashcat_hashcat_session_quit, METH_NOARGS, hashcat_session_quit__doc__},
+  {"hashcat_session_cancel", (PyCFunction) hashcat_hashcat_session_cancel, METH_VARARGS|METH_KEYWORDS, hashcat_session_cancel__doc__},
+  {"status_get_cancel_latency", (PyCFunction) hashcat_status_get_cancel_latency, METH_NOARGS, status_get_cancel_latency__doc__},
+  {"validate_hashes", (PyCFunction) hashcat_validate_hashes, METH_VARARGS|METH_KEYWORDS|METH_STATIC, validate_hashes__doc__},
+  {"presort_hashes", (PyCFunction) hashcat_presort_hashes, METH_VARARGS|METH_KEYWORDS|METH_STATIC, presort_hashes__doc__},
+  {"partition_hashes", (PyCFunction) hashcat_partition_hashes, METH_VARARGS|METH_KEYWORDS|METH_STATIC, partition_hashes__doc__},
+  {"salt_stats", (PyCFunction) hashcat_salt_stats, METH_VARARGS|METH_KEYWORDS|METH_STATIC, salt_stats__doc__},
+  {"salt_cohorts", (PyCFunction) hashcat_salt_cohorts, METH_VARARGS|METH_KEYWORDS|METH_STATIC, salt_cohorts__doc__},
+  {"index_wordlist", (PyCFunction) hashcat_index_wordlist, METH_VARARGS|METH_KEYWORDS|METH_STATIC, index_wordlist__doc__},
+  {"wordlist_index_info", (PyCFunction) hashcat_wordlist_index_info, METH_VARARGS|METH_KEYWORDS|METH_STATIC, wordlist_index_info__doc__},
+  {"ranked_merge", (PyCFunction) hashcat_ranked_merge, METH_VARARGS|METH_KEYWORDS|METH_STATIC, ranked_merge__doc__},
+  {"profile_wordlist", (PyCFunction) hashcat_profile_wordlist, METH_VARARGS|METH_KEYWORDS|METH_STATIC, profile_wordlist__doc__},
+  {"potfile_lookup", (PyCFunction) hashcat_potfile_lookup, METH_VARARGS|METH_KEYWORDS, potfile_lookup__doc__},
+  {"filter_uncracked", (PyCFunction) hashcat_filter_uncracked, METH_VARARGS|METH_KEYWORDS, filter_uncracked__doc__},
+  {"compact_potfile", (PyCFunction) hashcat_compact_potfile, METH_VARARGS|METH_KEYWORDS, compact_potfile__doc__},
+  {"potfile_sink_open", (PyCFunction) hashcat_potfile_sink_open, METH_VARARGS|METH_KEYWORDS, potfile_sink_open__doc__},
+  {"potfile_sink_flush", (PyCFunction) hashcat_potfile_sink_flush, METH_VARARGS|METH_KEYWORDS, potfile_sink_flush__doc__},
+  {"potfile_sink_close", (PyCFunction) hashcat_potfile_sink_close, METH_NOARGS, potfile_sink_close__doc__},
+  {"load_user_map", (PyCFunction) hashcat_load_user_map, METH_VARARGS|METH_KEYWORDS, load_user_map__doc__},
+  {"cracked_users", (PyCFunction) hashcat_cracked_users, METH_VARARGS|METH_KEYWORDS, cracked_users__doc__},
+  {"user_map_info", (PyCFunction) hashcat_user_map_info, METH_NOARGS, user_map_info__doc__},
+  {"clear_user_map", (PyCFunction) hashcat_clear_user_map, METH_NOARGS, clear_user_map__doc__},
+  {"prepare_wordlist", (PyCFunction) hashcat_prepare_wordlist, METH_VARARGS|METH_KEYWORDS, prepare_wordlist__doc__},
+  {"prewarm_wordlists", (PyCFunction) hashcat_prewarm_wordlists, METH_VARARGS|METH_KEYWORDS, prewarm_wordlists__doc__},
+  {"wordlist_cache", (PyCFunction) hashcat_wordlist_cache, METH_VARARGS|METH_KEYWORDS, wordlist_cache__doc__},
+  {"combinator_units", (PyCFunction) hashcat_combinator_units, METH_VARARGS|METH_KEYWORDS, combinator_units__doc__},
+  {"set_wordlists", (PyCFunction) hashcat_set_wordlists, METH_VARARGS|METH_KEYWORDS, set_wordlists__doc__},
   {"status_get_device_info_cnt", (PyCFunction) hashcat_status_get_device_info_cnt, METH_NOARGS, status_get_device_info_cnt__doc__},
   {"status_get_device_info_active", (PyCFunction) hashcat_status_get_device_info_active, METH_NOARGS, status_get_device_info_active__doc__},
   {"status_get_skipped_dev", (PyCFunction) hashcat_status_get_skipped_dev, METH_VARARGS, status_get_skipped_dev__doc__},
@@ -5279,6 +18577,7 @@ static PyMethodDef hashcat_methods[] = {
 
 static PyGetSetDef hashcat_getseters[] = {
 
+  {"closed", (getter) hashcat_getclosed, NULL, closed__doc__, NULL},
   {"hash", (getter) hashcat_gethash, (setter) hashcat_sethash, hash__doc__, NULL},
   {"dict1", (getter) hashcat_getdict1, (setter) hashcat_setdict1, dict1__doc__, NULL},
   {"dict2", (getter) hashcat_getdict2, (setter) hashcat_setdict2, dict2__doc__, NULL},
@@ -5349,6 +18648,8 @@ static PyGetSetDef hashcat_getseters[] = {
   {"segment_size", (getter) hashcat_getsegment_size, (setter) hashcat_setsegment_size, segment_size__doc__, NULL},
   {"separator", (getter) hashcat_getseparator, (setter) hashcat_setseparator, separator__doc__, NULL},
   {"session", (getter) hashcat_getsession, (setter) hashcat_setsession, session__doc__, NULL},
+  {"session_cpus", (getter) hashcat_getsession_cpus, (setter) hashcat_setsession_cpus, session_cpus__doc__, NULL},
+  {"session_numa_nodes", (getter) hashcat_getsession_numa_nodes, (setter) hashcat_setsession_numa_nodes, session_numa_nodes__doc__, NULL},
   {"show", (getter) hashcat_getshow, (setter) hashcat_setshow, show__doc__, NULL},
   {"skip", (getter) hashcat_getskip, (setter) hashcat_setskip, skip__doc__, NULL},
   {"speed_only", (getter) hashcat_getspeed_only, (setter) hashcat_setspeed_only, speed_only__doc__, NULL},
@@ -5358,6 +18659,8 @@ static PyGetSetDef hashcat_getseters[] = {
   {"username", (getter) hashcat_getusername, (setter) hashcat_setusername, username__doc__, NULL},
   {"veracrypt_keyfiles", (getter) hashcat_getveracrypt_keyfiles, (setter) hashcat_setveracrypt_keyfiles, veracrypt_keyfiles__doc__, NULL},
   {"veracrypt_pim", (getter) hashcat_getveracrypt_pim, (setter) hashcat_setveracrypt_pim, veracrypt_pim__doc__, NULL},
+  {"wordlist_prefetch", (getter) hashcat_getwordlist_prefetch, (setter) hashcat_setwordlist_prefetch, wordlist_prefetch__doc__, NULL},
+  {"wordlists", (getter) hashcat_getwordlists, (setter) hashcat_setwordlists, wordlists__doc__, NULL},
   {"workload_profile", (getter) hashcat_getworkload_profile, (setter) hashcat_setworkload_profile, workload_profile__doc__, NULL},
   {NULL}
 
@@ -5388,8 +18691,8 @@ static PyTypeObject hashcat_Type = {
   0,                            /* tp_hash */
   0,                            /* tp_call */
   0,                            /* tp_str */
-  0,                            /* tp_getattro */
-  0,                            /* tp_setattro */
+  (getattrofunc) hashcat_getattro, /* tp_getattro */
+  (setattrofunc) hashcat_setattro, /* tp_setattro */
   0,                            /* tp_as_buffer */
   Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /* tp_flags */
   "Python bindings for hashcat",  /* tp_doc */
@@ -0,0 +1,67 @@
+#!/usr/bin/env python
+
+import sys
+from time import sleep, time
+from pyhashcat import Hashcat
+
+# Compare a full reset (new context) against the incremental reset that
+# reuses the context allocation, with a short session run between resets
+
+ITERATIONS = 20
+if len(sys.argv) > 1:
+    ITERATIONS = int(sys.argv[1])
+
+finished = False
+
+def finished_callback(sender):
+    global finished
+    finished = True
+
+def configure_job(hc):
+    hc.hash = "8743b52063cd84097a65d1633f5c74f5"
+    hc.mask = "?l?l?l?l"
+
+def configure(hc):
+    configure_job(hc)
+    hc.attack_mode = 3
+    hc.hash_mode = 0
+    hc.workload_profile = 2
+    hc.potfile_disable = True
+    hc.quiet = True
+
+def run(hc):
+    global finished
+    finished = False
+    if hc.hashcat_session_execute() != 0:
+        raise RuntimeError("session did not start")
+    while not finished:
+        sleep(0.001)
+
+def cycle(keep):
+    hc = Hashcat()
+    hc.event_connect(callback=finished_callback, signal="EVENT_OUTERLOOP_FINISHED")
+    configure(hc)
+    start = time()
+    for i in range(ITERATIONS):
+        run(hc)
+        hc.reset(keep_options=keep, keep_backend=keep)
+        # hash and mask are job-scoped, a full reset drops the options too
+        if keep:
+            configure_job(hc)
+        else:
+            configure(hc)
+    elapsed = time() - start
+    hc.close()
+    return elapsed
+
+print "-------------------------------"
+print "-- pyhashcat Reset Benchmark --"
+print "-------------------------------"
+
+full = cycle(False)
+incremental = cycle(True)
+
+print "[+] Iterations.......: ", ITERATIONS
+print "[+] Full reset.......: ", "%.2f" % (full / ITERATIONS * 1e3), "ms/job"
+print "[+] Incremental reset: ", "%.2f" % (incremental / ITERATIONS * 1e3), "ms/job"
+print "[+] Speedup..........: ", "%.1fx" % (full / incremental)
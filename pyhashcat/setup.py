@@ -10,7 +10,7 @@ from distutils.core import setup, Extension
 pyhashcat_module = Extension('pyhashcat',
 							include_dirs = ['hashcat/include', 'hashcat/deps/OpenCL-Headers', 'hashcat/OpenCL','hashcat'],
 							library_dirs = ['/usr/local/lib'],
-							libraries = ['hashcat'],
+							libraries = ['hashcat', 'z'],
 							sources = ['pyhashcat.c'],
 							extra_compile_args=['-std=c99']
 							)
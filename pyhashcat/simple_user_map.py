@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+
+import sys
+import hashlib
+import threading
+from pyhashcat import Hashcat
+
+# Accounts sharing a password share a digest, the map has to hand every one of them back
+accounts = [
+	("alice", "abc"),
+	("bob", "abc"),
+	("carol", "xyz"),
+	("dave", "q:z"),
+	("erin", "Zzzzzz"),
+]
+
+finished = threading.Event()
+
+def finished_callback(sender):
+	finished.set()
+
+print "-------------------------------"
+print "---- pyhashcat User Map Test --"
+print "-------------------------------"
+
+hc = Hashcat()
+hc.event_connect(callback=finished_callback, signal="EVENT_CRACKER_FINISHED")
+
+hc.hash = ["%s:%s" % (user, hashlib.md5(plain).hexdigest()) for user, plain in accounts]
+hc.username = True
+hc.mask = "?a?a?a"
+hc.quiet = True
+hc.potfile_disable = True
+hc.attack_mode = 3
+hc.hash_mode = 0
+
+print "[+] Loaded user map (accounts, digests, invalid):", hc.load_user_map()
+
+print "[+] Running hashcat"
+if hc.hashcat_session_execute() < 0:
+	print "STATUS: ", hc.status_get_status_string()
+	sys.exit(1)
+
+while not finished.wait(1):
+	pass
+
+rows = sorted(hc.cracked_users())
+
+for user, ahash, plain in rows:
+	print user, ahash, " --> ", plain
+
+expected = sorted((user, hashlib.md5(plain).hexdigest(), plain) for user, plain in accounts if len(plain) == 3)
+
+if rows != expected:
+	print "[-] Unexpected rows, wanted", expected
+	sys.exit(1)
+
+print "[+] Every account in reach of the mask matched:", hc.user_map_info()